@@ -2,6 +2,11 @@
 // Copyright (c) 2023 Paul Scherrer Institute. All rights reserved.
 /////////////////////////////////////////////////////////////////////
 
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include <blosc2.h>
 #include <zmq.h>
 #include <fmt/core.h>
@@ -11,16 +16,20 @@
 #include "std_buffer/image_metadata.pb.h"
 #include "utils/utils.hpp"
 
+#include "compression_controller.hpp"
+#include "compression_pipeline.hpp"
+#include "quantiser.hpp"
+
 namespace {
 
 class compression
 {
 public:
-  compression(std::size_t threads, std::size_t bit_depth, std::size_t clevel)
+  compression(std::size_t threads, std::size_t element_size, std::size_t clevel)
   {
     blosc2_cparams compression_params = BLOSC2_CPARAMS_DEFAULTS;
     compression_params.nthreads = static_cast<int16_t>(threads);
-    compression_params.typesize = static_cast<int32_t>(bit_depth / 8);
+    compression_params.typesize = static_cast<int32_t>(element_size);
     compression_params.compcode = BLOSC_LZ4;
     compression_params.clevel = clevel;
     compression_params.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_BITSHUFFLE;
@@ -37,8 +46,16 @@ private:
 };
 
 constexpr auto zmq_io_threads = 1;
-
-std::tuple<utils::DetectorConfig, std::size_t, std::size_t> read_arguments(int argc, char* argv[])
+// level of the adaptive ladder storing images uncompressed
+constexpr std::size_t no_compression = 0;
+
+std::tuple<utils::DetectorConfig,
+           std::size_t,
+           std::size_t,
+           std::size_t,
+           bool,
+           std::optional<compress::Quantiser>>
+read_arguments(int argc, char* argv[])
 {
   auto program = utils::create_parser("std_data_compress_blosc2");
   program->add_argument("-t", "--threads")
@@ -60,18 +77,52 @@ std::tuple<utils::DetectorConfig, std::size_t, std::size_t> read_arguments(int a
           return value;
       })
       .default_value(5ul);
+  program->add_argument("-p", "--pipeline")
+      .help("number of images compressed concurrently by single threaded workers, 0 compresses "
+            "one image at a time with all threads")
+      .scan<'u', std::size_t>()
+      .default_value(0ul);
+  program->add_argument("-a", "--adaptive")
+      .help("lower the level down to storing images uncompressed while the pipeline falls behind")
+      .flag();
+  program->add_argument("-q", "--quantisation")
+      .help("lossy quantisation of float32 images before compression: none, rounding or anscombe")
+      .default_value(std::string("none"));
+  program->add_argument("--quantisation_step")
+      .help("quantisation step in photons (rounding) or in Poisson standard deviations (anscombe)")
+      .scan<'g', float>()
+      .default_value(0.5f);
 
   program = utils::parse_arguments(std::move(program), argc, argv);
 
-  return {utils::read_config_from_json_file(program->get("detector_json_filename")),
-          program->get<std::size_t>("--threads"), program->get<std::size_t>("--level")};
+  auto config = utils::read_config_from_json_file(program->get("detector_json_filename"));
+  auto quantiser = compress::Quantiser::from_config(
+      program->get("--quantisation"), program->get<float>("--quantisation_step"), config);
+  return {std::move(config),
+          program->get<std::size_t>("--threads"),
+          program->get<std::size_t>("--level"),
+          program->get<std::size_t>("--pipeline"),
+          program->get<bool>("--adaptive"),
+          std::move(quantiser)};
+}
+
+// compression levels from the strongest - adaptive mode may fall back to level 1 and no compression
+std::vector<std::size_t> compression_levels(std::size_t level, bool adaptive)
+{
+  std::vector<std::size_t> levels{level};
+  if (adaptive) {
+    if (level > 1) levels.push_back(1);
+    levels.push_back(no_compression);
+  }
+  return levels;
 }
 
 } // namespace
 
 int main(int argc, char* argv[])
 {
-  const auto [config, threads, level] = read_arguments(argc, argv);
+  const auto [config, threads, level, pipeline_depth, adaptive, quantiser] =
+      read_arguments(argc, argv);
   [[maybe_unused]] utils::log::logger l{"std_data_compress_blosc2", config.log_level};
   auto converted_bytes = utils::converted_image_n_bytes(config);
 
@@ -80,11 +131,13 @@ int main(int argc, char* argv[])
 
   const auto source_name = fmt::format("{}-image", config.detector_name);
   const auto sink_name = fmt::format("{}-blosc2", config.detector_name);
+  // blosc2 stores images that do not compress with its overhead instead of failing on them
+  const auto slot_n_bytes = converted_bytes + BLOSC2_MAX_OVERHEAD;
 
   auto receiver =
       cb::Communicator{{source_name, converted_bytes, utils::slots_number(config)},
                        {source_name, ctx, cb::CONN_TYPE_CONNECT, ZMQ_SUB}};
-  auto sender = cb::Communicator{{sink_name, converted_bytes, utils::slots_number(config)},
+  auto sender = cb::Communicator{{sink_name, slot_n_bytes, utils::slots_number(config)},
                                  {sink_name, ctx, cb::CONN_TYPE_BIND, ZMQ_PUB}};
 
   utils::stats::CompressionStatsCollector stats(config.detector_name,
@@ -92,31 +145,93 @@ int main(int argc, char* argv[])
 
   char buffer[512];
   std_daq_protocol::ImageMetadata meta;
-  compression compress(threads, config.bit_depth, level);
+  const auto element_size =
+      utils::get_bytes_from_metadata_dtype(utils::get_metadata_dtype(config));
+
+  // quantised copy is compressed - the image in the receiver buffer stays untouched
+  auto image_data = [&](uint64_t image_id) -> const char* {
+    const auto* data = receiver.get_data(image_id);
+    return quantiser ? quantiser->quantise(data, converted_bytes) : data;
+  };
+
+  auto send_compressed = [&](std_daq_protocol::ImageMetadata& image_meta,
+                             int compressed_size,
+                             std_daq_protocol::ImageMetadataCompression compression) {
+    if (compressed_size > 0) {
+      image_meta.set_size(compressed_size);
+      image_meta.set_compression(compression);
+      if (quantiser) quantiser->describe(image_meta);
+
+      std::string meta_buffer_send;
+      image_meta.SerializeToString(&meta_buffer_send);
+
+      sender.send(image_meta.image_id(), {meta_buffer_send.c_str(), meta_buffer_send.size()},
+                  nullptr);
+    }
+    stats.process(compressed_size);
+  };
+
+  if (pipeline_depth == 0) {
+    if (adaptive) throw std::invalid_argument("Adaptive compression needs pipeline mode");
+    compression compress(threads, element_size, level);
+    while (true) {
+      if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
+        meta.ParseFromArray(buffer, n_bytes);
+        if (meta.status() == std_daq_protocol::good_image)
+          send_compressed(meta, blosc2_compress_ctx(compress.ctx(), image_data(meta.image_id()),
+                                                    converted_bytes,
+                                                    sender.get_data(meta.image_id()),
+                                                    slot_n_bytes),
+                          std_daq_protocol::blosc2);
+      }
+      stats.print_stats();
+    }
+  }
+
+  // every worker owns single threaded context per level - small images do not scale within one
+  // image
+  const auto n_workers = std::min(threads, pipeline_depth);
+  const auto levels = compression_levels(level, adaptive);
+  std::vector<std::vector<std::unique_ptr<compression>>> contexts(n_workers);
+  for (auto& worker_contexts : contexts)
+    for (auto l : levels)
+      worker_contexts.push_back(
+          l == no_compression ? nullptr : std::make_unique<compression>(1, element_size, l));
+
+  std::optional<compress::CompressionController> controller;
+  if (adaptive)
+    controller.emplace(levels.size(), compress::CompressionController::pipeline_thresholds(
+                                          pipeline_depth, n_workers));
+
+  using job = compress::CompressionPipeline::job;
+  compress::CompressionPipeline pipeline(
+      n_workers, pipeline_depth,
+      [&](std::size_t worker_id, job& image) {
+        const auto id = image.meta.image_id();
+        image.level = controller ? controller->level() : 0;
+        if (levels[image.level] == no_compression) {
+          std::memcpy(sender.get_data(id), image_data(id), converted_bytes);
+          return static_cast<int>(converted_bytes);
+        }
+        return blosc2_compress_ctx(contexts[worker_id][image.level]->ctx(), image_data(id),
+                                   converted_bytes, sender.get_data(id), slot_n_bytes);
+      },
+      [&](job& image) {
+        stats.process_timing(image.started - image.submitted, image.finished - image.started);
+        if (controller && image.compressed_size > 0)
+          controller->update(image.level, image.backlog,
+                             image.compressed_size / static_cast<double>(converted_bytes));
+        send_compressed(image.meta, image.compressed_size,
+                        levels[image.level] == no_compression ? std_daq_protocol::none
+                                                              : std_daq_protocol::blosc2);
+        stats.print_stats();
+      });
 
   while (true) {
     if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
       meta.ParseFromArray(buffer, n_bytes);
-      if (meta.status() == std_daq_protocol::good_image) {
-
-        auto compressed_size =
-            blosc2_compress_ctx(compress.ctx(), receiver.get_data(meta.image_id()), converted_bytes,
-                                sender.get_data(meta.image_id()), converted_bytes);
-
-        if (compressed_size > 0) {
-          meta.set_size(compressed_size);
-          meta.set_compression(std_daq_protocol::blosc2);
-
-          std::string meta_buffer_send;
-          meta.SerializeToString(&meta_buffer_send);
-
-          sender.send(meta.image_id(), {meta_buffer_send.c_str(), meta_buffer_send.size()},
-                      nullptr);
-        }
-        stats.process(compressed_size);
-      }
+      if (meta.status() == std_daq_protocol::good_image) pipeline.submit(meta);
     }
-    stats.print_stats();
   }
   return 0;
 }
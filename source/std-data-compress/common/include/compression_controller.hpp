@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace compress {
+
+// Chooses one of n_levels compression settings ordered from the strongest (0) to the cheapest.
+// Steps down when images wait for workers or the data does not compress, steps back up once the
+// backlog stays low. Only images compressed with the current level are taken into account so a
+// change is judged on its own effect, and stepping up needs hold_images calm images in a row.
+class CompressionController
+{
+public:
+  struct thresholds
+  {
+    // images waiting for a worker that trigger stepping down
+    std::size_t high_backlog;
+    // images waiting for a worker still considered calm
+    std::size_t low_backlog;
+    // calm images needed to step up and images averaged for the ratio
+    std::size_t hold_images;
+    // compressed to raw size above which compression is not worth its time
+    double max_ratio;
+  };
+
+  CompressionController(std::size_t n_levels, thresholds t);
+
+  // backlog limits from the images a pipeline can hold beyond the ones being compressed
+  static thresholds pipeline_thresholds(std::size_t depth, std::size_t n_workers);
+
+  // level for the next image - safe to call from any thread
+  [[nodiscard]] std::size_t level() const;
+
+  // called in order for every compressed image - not concurrently
+  void update(std::size_t image_level, std::size_t backlog, double ratio);
+
+private:
+  void change_level(std::size_t new_level);
+
+  const std::size_t n_levels;
+  const thresholds limits;
+  std::atomic<std::size_t> current_level = 0;
+  std::size_t calm_images = 0;
+  std::size_t ratio_images = 0;
+  double ratio_sum = 0.0;
+};
+
+} // namespace compress
@@ -0,0 +1,90 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "std_buffer/image_metadata.pb.h"
+
+namespace compress {
+
+// Up to `depth` images are in flight at once - the receiving thread submits them, every worker
+// compresses one image at a time and finished images are published strictly in the order of
+// submission by the worker completing the oldest one. Workers are pinned to the cpus the process
+// is allowed to run on, one cpu per worker.
+class CompressionPipeline
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct job
+  {
+    std_daq_protocol::ImageMetadata meta;
+    // result of the compression - not published by the caller when not positive
+    int compressed_size = 0;
+    // images waiting for a worker when this one was taken
+    std::size_t backlog = 0;
+    // compression setting chosen by the compress function
+    std::size_t level = 0;
+    clock::time_point submitted;
+    clock::time_point started;
+    clock::time_point finished;
+  };
+
+  // compresses the image of the job on worker with given id and returns compressed size
+  using compress_function = std::function<int(std::size_t worker_id, job&)>;
+  // called for every submitted image in order, never concurrently
+  using publish_function = std::function<void(job&)>;
+
+  CompressionPipeline(std::size_t n_workers,
+                      std::size_t depth,
+                      compress_function compress,
+                      publish_function publish,
+                      bool pin_workers = true);
+  ~CompressionPipeline();
+
+  // blocks while `depth` images are in flight
+  void submit(const std_daq_protocol::ImageMetadata& meta);
+  // blocks until all submitted images are published
+  void drain();
+
+private:
+  enum class slot_state : uint8_t
+  {
+    free,
+    queued,
+    compressing,
+    done
+  };
+
+  struct slot
+  {
+    job work;
+    slot_state state = slot_state::free;
+  };
+
+  void run(std::size_t worker_id, int cpu, std::stop_token stop);
+  void publish_ready(std::unique_lock<std::mutex>& lock);
+
+  compress_function compress;
+  publish_function publish;
+  std::vector<slot> slots;
+  std::mutex mutex;
+  std::condition_variable_any work_available;
+  std::condition_variable space_available;
+  uint64_t next_submitted = 0;
+  uint64_t next_taken = 0;
+  uint64_t next_published = 0;
+  bool publishing = false;
+  std::vector<std::jthread> workers;
+};
+
+} // namespace compress
@@ -0,0 +1,46 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "std_buffer/image_metadata.pb.h"
+#include "utils/detector_config.hpp"
+
+namespace compress {
+
+// Lossy quantisation of float32 images in units of photon energy. Mantissa noise below the
+// chosen step is removed so bitshuffle finds constant bit planes, while values keep their type
+// and units - readers need no decoding. Largest error for value of n photons is step / 2 photons
+// for rounding and step / 2 * sqrt(|n| + 3/8) + step^2 / 16 photons for anscombe.
+class Quantiser
+{
+public:
+  using mode = std_daq_protocol::ImageQuantisation::Mode;
+
+  Quantiser(mode m, float step, float photon_energy_kev);
+
+  static mode to_mode(std::string_view name);
+  // quantiser for float32 images of the detector, none when name is "none"
+  static std::optional<Quantiser> from_config(std::string_view name,
+                                              float step,
+                                              const utils::DetectorConfig& config);
+
+  void quantise(const float* image, float* output, std::size_t n_pixels) const;
+  // quantised copy of the image in per thread buffer - valid until the next call of the thread
+  const char* quantise(const char* image, std::size_t n_bytes) const;
+
+  [[nodiscard]] float max_error_photons(float photons) const;
+  void describe(std_daq_protocol::ImageMetadata& meta) const;
+
+private:
+  const mode quantisation_mode;
+  const float step;
+  const float photon_energy_kev;
+};
+
+} // namespace compress
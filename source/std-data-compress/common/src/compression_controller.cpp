@@ -0,0 +1,91 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "compression_controller.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+namespace compress {
+namespace {
+// one second of images at kHz rates
+constexpr std::size_t hold_images = 1000;
+constexpr double max_ratio = 0.95;
+} // namespace
+
+CompressionController::CompressionController(std::size_t n_levels, thresholds t)
+    : n_levels(n_levels)
+    , limits(t)
+{
+  if (n_levels == 0) throw std::invalid_argument("Controller needs at least one level");
+  if (limits.low_backlog >= limits.high_backlog || limits.hold_images == 0)
+    throw std::invalid_argument(
+        fmt::format("Invalid controller thresholds: low={}, high={}, hold={}", limits.low_backlog,
+                    limits.high_backlog, limits.hold_images));
+}
+
+CompressionController::thresholds CompressionController::pipeline_thresholds(
+    std::size_t depth, std::size_t n_workers)
+{
+  if (depth <= n_workers)
+    throw std::invalid_argument(fmt::format(
+        "Adaptive compression needs pipeline depth={} larger than workers={}", depth, n_workers));
+  const auto queue = depth - n_workers;
+  return {std::max<std::size_t>(queue / 2, 1), 0, hold_images, max_ratio};
+}
+
+std::size_t CompressionController::level() const
+{
+  return current_level.load(std::memory_order_relaxed);
+}
+
+void CompressionController::update(std::size_t image_level, std::size_t backlog, double ratio)
+{
+  const auto current = level();
+  if (image_level != current) return;
+
+  const bool can_step_down = current + 1 < n_levels;
+  if (backlog >= limits.high_backlog) {
+    if (can_step_down) {
+      spdlog::info("Stepping compression down to level={} with backlog={}", current + 1, backlog);
+      change_level(current + 1);
+    }
+    return;
+  }
+
+  calm_images = backlog <= limits.low_backlog ? calm_images + 1 : 0;
+  if (can_step_down) {
+    ratio_sum += ratio;
+    if (++ratio_images >= limits.hold_images) {
+      if (const auto mean = ratio_sum / static_cast<double>(ratio_images);
+          mean >= limits.max_ratio)
+      {
+        spdlog::info("Stepping compression down to level={} with ratio={:.3f}", current + 1,
+                     mean);
+        change_level(current + 1);
+        return;
+      }
+      ratio_images = 0;
+      ratio_sum = 0.0;
+    }
+  }
+
+  if (current > 0 && calm_images >= limits.hold_images) {
+    spdlog::info("Stepping compression up to level={}", current - 1);
+    change_level(current - 1);
+  }
+}
+
+void CompressionController::change_level(std::size_t new_level)
+{
+  current_level.store(new_level, std::memory_order_relaxed);
+  calm_images = 0;
+  ratio_images = 0;
+  ratio_sum = 0.0;
+}
+
+} // namespace compress
@@ -0,0 +1,130 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "compression_pipeline.hpp"
+
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+namespace compress {
+namespace {
+
+std::vector<int> allowed_cpus()
+{
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (auto cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  return cpus;
+}
+
+void pin_current_thread(int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    spdlog::warn("Compression worker could not be pinned to cpu {}", cpu);
+}
+
+} // namespace
+
+CompressionPipeline::CompressionPipeline(std::size_t n_workers,
+                                         std::size_t depth,
+                                         compress_function compress_image,
+                                         publish_function publish_image,
+                                         bool pin_workers)
+    : compress(std::move(compress_image))
+    , publish(std::move(publish_image))
+    , slots(depth)
+{
+  if (n_workers == 0 || depth == 0)
+    throw std::invalid_argument(
+        fmt::format("Pipeline needs workers and depth - got {} and {}", n_workers, depth));
+
+  const auto cpus = pin_workers ? allowed_cpus() : std::vector<int>{};
+  if (pin_workers && cpus.size() < n_workers)
+    spdlog::warn("{} compression workers share {} cpus", n_workers, cpus.size());
+
+  workers.reserve(n_workers);
+  for (auto i = 0u; i < n_workers; i++) {
+    const auto cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    workers.emplace_back([this, i, cpu](std::stop_token stop) { run(i, cpu, stop); });
+  }
+}
+
+CompressionPipeline::~CompressionPipeline()
+{
+  for (auto& worker : workers)
+    worker.request_stop();
+}
+
+void CompressionPipeline::submit(const std_daq_protocol::ImageMetadata& meta)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  space_available.wait(lock, [this] { return next_submitted - next_published < slots.size(); });
+  auto& s = slots[next_submitted % slots.size()];
+  s.work.meta = meta;
+  s.work.compressed_size = 0;
+  s.work.level = 0;
+  s.work.submitted = clock::now();
+  s.state = slot_state::queued;
+  next_submitted++;
+  lock.unlock();
+  work_available.notify_one();
+}
+
+void CompressionPipeline::drain()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  space_available.wait(lock, [this] { return next_published == next_submitted; });
+}
+
+void CompressionPipeline::run(std::size_t worker_id, int cpu, std::stop_token stop)
+{
+  if (cpu >= 0) pin_current_thread(cpu);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (work_available.wait(lock, stop, [this] { return next_taken < next_submitted; })) {
+    // slot stays owned by this worker until marked done - submit never reuses it before publish
+    auto& s = slots[next_taken++ % slots.size()];
+    s.state = slot_state::compressing;
+    s.work.backlog = next_submitted - next_taken;
+    lock.unlock();
+
+    s.work.started = clock::now();
+    s.work.compressed_size = compress(worker_id, s.work);
+    s.work.finished = clock::now();
+
+    lock.lock();
+    s.state = slot_state::done;
+    if (!publishing) publish_ready(lock);
+  }
+}
+
+// publishes consecutive finished images starting from the oldest one in flight - lock is released
+// while publishing so other workers keep taking images, the flag keeps the order
+void CompressionPipeline::publish_ready(std::unique_lock<std::mutex>& lock)
+{
+  publishing = true;
+  while (next_published < next_submitted) {
+    auto& s = slots[next_published % slots.size()];
+    if (s.state != slot_state::done) break;
+    lock.unlock();
+    publish(s.work);
+    lock.lock();
+    s.state = slot_state::free;
+    next_published++;
+    space_available.notify_all();
+  }
+  publishing = false;
+}
+
+} // namespace compress
@@ -0,0 +1,184 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "quantiser.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "utils/get_metadata_dtype.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace compress {
+namespace {
+
+// Anscombe transform shifted to 0 for 0 photons and mirrored for negative values, which pedestal
+// noise produces around 0
+const float anscombe_offset = std::sqrt(3.f / 8.f);
+
+struct parameters
+{
+  float to_units;
+  float from_units;
+  float step;
+  float inverse_step;
+};
+
+void round_scalar(const float* image, float* output, std::size_t n, const parameters& p)
+{
+  for (auto i = 0u; i < n; i++)
+    output[i] = std::nearbyint(image[i] * p.to_units) * p.from_units;
+}
+
+void anscombe_scalar(const float* image, float* output, std::size_t n, const parameters& p)
+{
+  for (auto i = 0u; i < n; i++) {
+    const auto photons = image[i] * p.to_units;
+    const auto a = 2.f * (std::sqrt(std::fabs(photons) + 3.f / 8.f) - anscombe_offset);
+    const auto q = std::nearbyint(a * p.inverse_step) * p.step;
+    // (q / 2 + offset)^2 - 3/8 without cancellation, so 0 stays exactly 0
+    output[i] = std::copysign(q * (q * 0.25f + anscombe_offset), photons) * p.from_units;
+  }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) void round_avx2(const float* image,
+                                                float* output,
+                                                std::size_t n,
+                                                const parameters& p)
+{
+  const auto to_units = _mm256_set1_ps(p.to_units);
+  const auto from_units = _mm256_set1_ps(p.from_units);
+  auto i = 0ul;
+  for (; i + 8 <= n; i += 8) {
+    const auto units = _mm256_mul_ps(_mm256_loadu_ps(image + i), to_units);
+    const auto rounded = _mm256_round_ps(units, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm256_storeu_ps(output + i, _mm256_mul_ps(rounded, from_units));
+  }
+  round_scalar(image + i, output + i, n - i, p);
+}
+
+__attribute__((target("avx2"))) void anscombe_avx2(const float* image,
+                                                   float* output,
+                                                   std::size_t n,
+                                                   const parameters& p)
+{
+  const auto to_units = _mm256_set1_ps(p.to_units);
+  const auto from_units = _mm256_set1_ps(p.from_units);
+  const auto step = _mm256_set1_ps(p.step);
+  const auto inverse_step = _mm256_set1_ps(p.inverse_step);
+  const auto offset = _mm256_set1_ps(anscombe_offset);
+  const auto three_eighths = _mm256_set1_ps(3.f / 8.f);
+  const auto two = _mm256_set1_ps(2.f);
+  const auto quarter = _mm256_set1_ps(0.25f);
+  const auto sign_mask = _mm256_set1_ps(-0.f);
+
+  auto i = 0ul;
+  for (; i + 8 <= n; i += 8) {
+    const auto photons = _mm256_mul_ps(_mm256_loadu_ps(image + i), to_units);
+    const auto magnitude = _mm256_andnot_ps(sign_mask, photons);
+    const auto a = _mm256_mul_ps(
+        two, _mm256_sub_ps(_mm256_sqrt_ps(_mm256_add_ps(magnitude, three_eighths)), offset));
+    const auto q = _mm256_mul_ps(
+        _mm256_round_ps(_mm256_mul_ps(a, inverse_step),
+                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+        step);
+    const auto value = _mm256_mul_ps(q, _mm256_add_ps(_mm256_mul_ps(q, quarter), offset));
+    const auto signed_value =
+        _mm256_or_ps(_mm256_andnot_ps(sign_mask, value), _mm256_and_ps(sign_mask, photons));
+    _mm256_storeu_ps(output + i, _mm256_mul_ps(signed_value, from_units));
+  }
+  anscombe_scalar(image + i, output + i, n - i, p);
+}
+#endif
+
+bool has_avx2()
+{
+#if defined(__x86_64__)
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+Quantiser::Quantiser(mode m, float step, float photon_energy_kev)
+    : quantisation_mode(m)
+    , step(step)
+    , photon_energy_kev(photon_energy_kev)
+{
+  if (!(step > 0.f))
+    throw std::invalid_argument(fmt::format("Quantisation step must be positive - got {}", step));
+  if (!(photon_energy_kev > 0.f))
+    throw std::invalid_argument(
+        "Quantisation requires positive value of \"photon_energy_kev\" in configuration");
+}
+
+Quantiser::mode Quantiser::to_mode(std::string_view name)
+{
+  if (name == "rounding") return std_daq_protocol::ImageQuantisation::rounding;
+  if (name == "anscombe") return std_daq_protocol::ImageQuantisation::anscombe;
+  throw std::invalid_argument(fmt::format("Unsupported quantisation: {}", name));
+}
+
+std::optional<Quantiser> Quantiser::from_config(std::string_view name,
+                                                float step,
+                                                const utils::DetectorConfig& config)
+{
+  if (name == "none") return std::nullopt;
+  if (utils::get_metadata_dtype(config) != std_daq_protocol::ImageMetadataDtype::float32)
+    throw std::invalid_argument("Quantisation is supported only for float32 converted images");
+  return Quantiser(to_mode(name), step, config.converted_output.photon_energy_kev);
+}
+
+void Quantiser::quantise(const float* image, float* output, std::size_t n_pixels) const
+{
+  if (quantisation_mode == std_daq_protocol::ImageQuantisation::rounding) {
+    // values are rounded to multiples of step photons
+    const auto unit = step * photon_energy_kev;
+    const parameters p{1.f / unit, unit, step, 1.f / step};
+#if defined(__x86_64__)
+    if (has_avx2()) return round_avx2(image, output, n_pixels, p);
+#endif
+    return round_scalar(image, output, n_pixels, p);
+  }
+
+  const parameters p{1.f / photon_energy_kev, photon_energy_kev, step, 1.f / step};
+#if defined(__x86_64__)
+  if (has_avx2()) return anscombe_avx2(image, output, n_pixels, p);
+#endif
+  anscombe_scalar(image, output, n_pixels, p);
+}
+
+const char* Quantiser::quantise(const char* image, std::size_t n_bytes) const
+{
+  thread_local std::vector<float> quantised;
+  quantised.resize(n_bytes / sizeof(float));
+  quantise(reinterpret_cast<const float*>(image), quantised.data(), quantised.size());
+  return reinterpret_cast<const char*>(quantised.data());
+}
+
+float Quantiser::max_error_photons(float photons) const
+{
+  if (quantisation_mode == std_daq_protocol::ImageQuantisation::rounding) return step / 2.f;
+  return step / 2.f * std::sqrt(std::fabs(photons) + 3.f / 8.f) + step * step / 16.f;
+}
+
+void Quantiser::describe(std_daq_protocol::ImageMetadata& meta) const
+{
+  auto* quantisation = meta.mutable_quantisation();
+  quantisation->set_mode(quantisation_mode);
+  quantisation->set_step(step);
+  quantisation->set_photon_energy_kev(photon_energy_kev);
+}
+
+} // namespace compress
@@ -0,0 +1,427 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+// Throughput and ratio of the codecs used by std_data_compress services on detector frames.
+// Frames are read from <config>.raw next to the detector json file when present (raw images of
+// the configured geometry and dtype), otherwise they are generated for the detector type. Results
+// are printed as table, --benchmark_format=json or --benchmark_out=<file> gives JSON.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <omp.h>
+#include <blosc2.h>
+#include <fmt/core.h>
+#include <argparse/argparse.hpp>
+#include <benchmark/benchmark.h>
+#include <bitshuffle/bitshuffle.h>
+
+#include "utils/detector_config.hpp"
+#include "utils/get_metadata_dtype.hpp"
+#include "utils/image_size_calc.hpp"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+struct frames_set
+{
+  std::string name;
+  std::size_t element_size;
+  std::size_t image_n_bytes;
+  std::vector<std::vector<char>> frames;
+};
+
+struct codec_setup
+{
+  std::string codec;
+  int level;
+  std::size_t block_size;
+  int threads;
+
+  bool operator==(const codec_setup&) const = default;
+};
+
+// representative detector of every family - the rest of testing/test_files differs only in size
+const std::vector<std::string> default_configs = {"jungfrau_detector.json", "gf_tomcat.json",
+                                                  "eiger_detector_1M.json", "pco_detector.json"};
+// used for synthetic jungfrau frames when configuration does not define the photon energy
+constexpr float default_photon_energy_kev = 12.4f;
+
+template <typename T> void store(std::vector<char>& frame, const std::vector<float>& values)
+{
+  frame.resize(values.size() * sizeof(T));
+  auto* pixels = reinterpret_cast<T*>(frame.data());
+  for (auto i = 0u; i < values.size(); i++)
+    if constexpr (std::is_integral_v<T>)
+      pixels[i] = static_cast<T>(std::clamp(std::round(values[i]), 0.f,
+                                            static_cast<float>(std::numeric_limits<T>::max())));
+    else
+      pixels[i] = static_cast<T>(values[i]);
+}
+
+std::vector<char> to_frame(const std::vector<float>& values,
+                           std_daq_protocol::ImageMetadataDtype dtype)
+{
+  std::vector<char> frame;
+  switch (dtype) {
+  case std_daq_protocol::ImageMetadataDtype::uint8: store<uint8_t>(frame, values); break;
+  case std_daq_protocol::ImageMetadataDtype::uint16: store<uint16_t>(frame, values); break;
+  case std_daq_protocol::ImageMetadataDtype::uint32: store<uint32_t>(frame, values); break;
+  case std_daq_protocol::ImageMetadataDtype::float16: store<_Float16>(frame, values); break;
+  default: store<float>(frame, values);
+  }
+  return frame;
+}
+
+// values of single frame in the units the detector delivers after conversion - the frames of one
+// set share the background, only the noise changes
+class FrameGenerator
+{
+public:
+  explicit FrameGenerator(const utils::DetectorConfig& config)
+      : config(config)
+      , n_pixels(static_cast<std::size_t>(config.image_pixel_height) * config.image_pixel_width)
+      , background(n_pixels)
+  {
+    std::uniform_real_distribution<float> texture(0.f, 1.f);
+    for (auto& pixel : background)
+      pixel = texture(gen);
+  }
+
+  std::vector<float> next()
+  {
+    if (config.detector_type == "jungfrau-converted") return jungfrau();
+    if (config.detector_type == "eiger") return eiger();
+    // gigafrost and pco - tomography projections in counts
+    return projection();
+  }
+
+private:
+  // pedestal subtracted energy - readout noise around 0 with sparse photons and Bragg peaks
+  std::vector<float> jungfrau()
+  {
+    const auto energy = config.converted_output.photon_energy_kev > 0.f
+                            ? config.converted_output.photon_energy_kev
+                            : default_photon_energy_kev;
+    std::normal_distribution<float> noise(0.f, 0.15f);
+    std::poisson_distribution<int> photons(0.02);
+    std::vector<float> values(n_pixels);
+    for (auto i = 0u; i < n_pixels; i++)
+      values[i] = (static_cast<float>(photons(gen)) + noise(gen)) * energy;
+    add_peaks(values, 1000.f * energy);
+    if (config.converted_output.type == utils::converted_output_config::uint16)
+      for (auto& value : values)
+        value = std::max(value / energy, 0.f);
+    return values;
+  }
+
+  // photon counts - mostly empty pixels
+  std::vector<float> eiger()
+  {
+    std::vector<float> values(n_pixels);
+    for (auto i = 0u; i < n_pixels; i++) {
+      std::poisson_distribution<int> counts(0.05 + background[i] * 0.1);
+      values[i] = static_cast<float>(counts(gen));
+    }
+    const auto max_count = config.bit_depth >= 8 ? 1000.f : 15.f;
+    add_peaks(values, max_count);
+    return values;
+  }
+
+  // flat field texture behind sample absorbing half of the beam, dark offset and shot noise
+  std::vector<float> projection()
+  {
+    const auto width = static_cast<std::size_t>(config.image_pixel_width);
+    const auto max_count = config.bit_depth >= 16 ? 12000.f : 3000.f;
+    std::normal_distribution<float> noise(0.f, 1.f);
+    std::vector<float> values(n_pixels);
+    for (auto i = 0u; i < n_pixels; i++) {
+      const auto absorption = i % width < width / 3 + frame_index ? 0.5f : 1.f;
+      const auto signal = (0.2f + 0.8f * background[i]) * max_count * absorption;
+      values[i] = 100.f + signal + std::sqrt(signal) * noise(gen);
+    }
+    frame_index++;
+    return values;
+  }
+
+  void add_peaks(std::vector<float>& values, float intensity)
+  {
+    std::uniform_int_distribution<std::size_t> position(0, n_pixels - 1);
+    for (auto p = 0u; p < n_pixels / 10000; p++)
+      values[position(gen)] += intensity;
+  }
+
+  const utils::DetectorConfig& config;
+  const std::size_t n_pixels;
+  std::mt19937 gen{42};
+  std::vector<float> background;
+  std::size_t frame_index = 0;
+};
+
+frames_set load_frames(const fs::path& config_file, std::size_t n_frames)
+{
+  const auto config = utils::read_config_from_json_file(config_file.string());
+  frames_set set{config.detector_name,
+                 utils::get_bytes_from_metadata_dtype(utils::get_metadata_dtype(config)),
+                 utils::converted_image_n_bytes(config),
+                 {}};
+
+  if (auto raw_file = fs::path(config_file).replace_extension(".raw"); fs::exists(raw_file)) {
+    std::ifstream input(raw_file, std::ios::binary);
+    for (auto i = 0u; i < n_frames; i++) {
+      std::vector<char> frame(set.image_n_bytes);
+      if (!input.read(frame.data(), static_cast<std::streamsize>(frame.size()))) break;
+      set.frames.push_back(std::move(frame));
+    }
+    if (set.frames.empty())
+      throw std::runtime_error(fmt::format("{} holds no complete image", raw_file.string()));
+    return set;
+  }
+
+  FrameGenerator generator(config);
+  for (auto i = 0u; i < n_frames; i++)
+    set.frames.push_back(to_frame(generator.next(), utils::get_metadata_dtype(config)));
+  set.name += "(synthetic)";
+  return set;
+}
+
+class Codec
+{
+public:
+  virtual ~Codec() = default;
+  virtual std::size_t max_compressed_n_bytes() const = 0;
+  virtual int64_t compress(const char* image, char* output) = 0;
+  virtual int64_t decompress(const char* compressed, char* image) = 0;
+};
+
+class BitshuffleLz4 : public Codec
+{
+public:
+  BitshuffleLz4(const frames_set& set, const codec_setup& setup)
+      : n_elements(set.image_n_bytes / set.element_size)
+      , element_size(set.element_size)
+      , block_n_elements(setup.block_size / set.element_size)
+  {
+    omp_set_num_threads(setup.threads);
+  }
+
+  std::size_t max_compressed_n_bytes() const override
+  {
+    return bshuf_compress_lz4_bound(n_elements, element_size, block_n_elements);
+  }
+  int64_t compress(const char* image, char* output) override
+  {
+    return bshuf_compress_lz4(image, output, n_elements, element_size, block_n_elements);
+  }
+  int64_t decompress(const char* compressed, char* image) override
+  {
+    return bshuf_decompress_lz4(compressed, image, n_elements, element_size, block_n_elements);
+  }
+
+private:
+  const std::size_t n_elements;
+  const std::size_t element_size;
+  const std::size_t block_n_elements;
+};
+
+class Blosc2 : public Codec
+{
+public:
+  Blosc2(const frames_set& set, const codec_setup& setup, int compcode)
+      : image_n_bytes(set.image_n_bytes)
+  {
+    blosc2_cparams compression_params = BLOSC2_CPARAMS_DEFAULTS;
+    compression_params.nthreads = static_cast<int16_t>(setup.threads);
+    compression_params.typesize = static_cast<int32_t>(set.element_size);
+    compression_params.compcode = static_cast<uint8_t>(compcode);
+    compression_params.clevel = static_cast<uint8_t>(setup.level);
+    compression_params.blocksize = static_cast<int32_t>(setup.block_size);
+    compression_params.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_BITSHUFFLE;
+    compression_ctx = blosc2_create_cctx(compression_params);
+
+    blosc2_dparams decompression_params = BLOSC2_DPARAMS_DEFAULTS;
+    decompression_params.nthreads = static_cast<int16_t>(setup.threads);
+    decompression_ctx = blosc2_create_dctx(decompression_params);
+  }
+  ~Blosc2() override
+  {
+    if (compression_ctx != nullptr) blosc2_free_ctx(compression_ctx);
+    if (decompression_ctx != nullptr) blosc2_free_ctx(decompression_ctx);
+  }
+
+  std::size_t max_compressed_n_bytes() const override
+  {
+    return image_n_bytes + BLOSC2_MAX_OVERHEAD;
+  }
+  int64_t compress(const char* image, char* output) override
+  {
+    return blosc2_compress_ctx(compression_ctx, image, static_cast<int32_t>(image_n_bytes),
+                               output, static_cast<int32_t>(max_compressed_n_bytes()));
+  }
+  int64_t decompress(const char* compressed, char* image) override
+  {
+    return blosc2_decompress_ctx(decompression_ctx, compressed,
+                                 static_cast<int32_t>(max_compressed_n_bytes()), image,
+                                 static_cast<int32_t>(image_n_bytes));
+  }
+
+private:
+  const std::size_t image_n_bytes;
+  blosc2_context* compression_ctx = nullptr;
+  blosc2_context* decompression_ctx = nullptr;
+};
+
+std::unique_ptr<Codec> create_codec(const frames_set& set, const codec_setup& setup)
+{
+  if (setup.codec == "h5bitshuffle_lz4") return std::make_unique<BitshuffleLz4>(set, setup);
+  if (setup.codec == "blosc2_lz4") return std::make_unique<Blosc2>(set, setup, BLOSC_LZ4);
+  if (setup.codec == "blosc2_zstd") return std::make_unique<Blosc2>(set, setup, BLOSC_ZSTD);
+  throw std::invalid_argument(fmt::format("Unsupported codec: {}", setup.codec));
+}
+
+// GB_in and GB_out are rates of raw and compressed data in GB/s, ratio is compressed over raw size
+// as in the compression statistics
+void Compress(benchmark::State& state, const frames_set& set, const codec_setup& setup)
+{
+  auto codec = create_codec(set, setup);
+  std::vector<char> output(codec->max_compressed_n_bytes());
+  std::vector<char> decompressed(set.image_n_bytes);
+
+  for (const auto& frame : set.frames)
+    if (const auto size = codec->compress(frame.data(), output.data());
+        size <= 0 || codec->decompress(output.data(), decompressed.data()) <= 0 ||
+        std::memcmp(frame.data(), decompressed.data(), frame.size()) != 0)
+    {
+      state.SkipWithError("compression does not round trip");
+      return;
+    }
+
+  std::size_t raw_bytes = 0;
+  std::size_t compressed_bytes = 0;
+  for (auto _ : state)
+    for (const auto& frame : set.frames) {
+      compressed_bytes += codec->compress(frame.data(), output.data());
+      raw_bytes += frame.size();
+    }
+
+  state.counters["GB_in"] = benchmark::Counter(raw_bytes / 1e9, benchmark::Counter::kIsRate);
+  state.counters["GB_out"] =
+      benchmark::Counter(compressed_bytes / 1e9, benchmark::Counter::kIsRate);
+  state.counters["ratio"] = static_cast<double>(compressed_bytes) / static_cast<double>(raw_bytes);
+}
+
+std::vector<fs::path> config_files(const std::vector<std::string>& paths)
+{
+  std::vector<fs::path> files;
+  if (paths.empty())
+    for (const auto& name : default_configs)
+      files.push_back(fs::path(STD_DAQ_TEST_FILES_DIR) / name);
+  for (const fs::path path : paths)
+    if (fs::is_directory(path)) {
+      for (const auto& entry : fs::directory_iterator(path))
+        if (entry.path().extension() == ".json") files.push_back(entry.path());
+    }
+    else
+      files.push_back(path);
+  std::ranges::sort(files);
+  return files;
+}
+
+std::vector<codec_setup> sweep(const argparse::ArgumentParser& program)
+{
+  std::vector<codec_setup> setups;
+  for (const auto& codec : program.get<std::vector<std::string>>("--codecs"))
+    for (auto level : program.get<std::vector<int>>("--levels"))
+      for (auto block_size : program.get<std::vector<std::size_t>>("--block_sizes"))
+        for (auto threads : program.get<std::vector<int>>("--threads")) {
+          // bitshuffle lz4 has no levels - it is measured once
+          const codec_setup setup{codec, codec == "h5bitshuffle_lz4" ? 0 : level, block_size,
+                                  threads};
+          if (std::ranges::find(setups, setup) == setups.end()) setups.push_back(setup);
+        }
+  return setups;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // counters are shown as table columns unless stated otherwise
+  std::vector<char*> args(argv, argv + argc);
+  std::string tabular = "--benchmark_counters_tabular=true";
+  if (std::none_of(argv, argv + argc, [](std::string_view arg) {
+        return arg.starts_with("--benchmark_counters_tabular");
+      }))
+    args.insert(args.begin() + 1, tabular.data());
+  auto n_args = static_cast<int>(args.size());
+  benchmark::Initialize(&n_args, args.data());
+
+  argparse::ArgumentParser program("std_data_compress_common_bench");
+  program.add_argument("detector_json_files")
+      .help("detector json files or directories with them - defaults to one detector of every "
+            "family from testing/test_files")
+      .nargs(argparse::nargs_pattern::any)
+      .default_value(std::vector<std::string>{});
+  program.add_argument("-c", "--codecs")
+      .help("codecs: h5bitshuffle_lz4, blosc2_lz4, blosc2_zstd (needs c-blosc2 built with zstd)")
+      .nargs(argparse::nargs_pattern::at_least_one)
+      .default_value(std::vector<std::string>{"h5bitshuffle_lz4", "blosc2_lz4"});
+  program.add_argument("-l", "--levels")
+      .help("compression levels of blosc2 codecs")
+      .nargs(argparse::nargs_pattern::at_least_one)
+      .scan<'i', int>()
+      .default_value(std::vector<int>{1, 5, 9});
+  program.add_argument("-b", "--block_sizes")
+      .help("block sizes in bytes, 0 lets the codec choose")
+      .nargs(argparse::nargs_pattern::at_least_one)
+      .scan<'u', std::size_t>()
+      .default_value(std::vector<std::size_t>{0, 65536});
+  program.add_argument("-t", "--threads")
+      .help("numbers of threads compressing single image")
+      .nargs(argparse::nargs_pattern::at_least_one)
+      .scan<'i', int>()
+      .default_value(std::vector<int>{1, 4});
+  program.add_argument("-n", "--n_frames")
+      .help("number of frames compressed in one iteration")
+      .scan<'u', std::size_t>()
+      .default_value(8ul);
+
+  try {
+    program.parse_args(n_args, args.data());
+  }
+  catch (const std::runtime_error& err) {
+    std::cerr << err.what() << std::endl << program;
+    return 1;
+  }
+
+  const auto files = config_files(program.get<std::vector<std::string>>("detector_json_files"));
+  std::vector<frames_set> sets;
+  for (const auto& file : files)
+    sets.push_back(load_frames(file, program.get<std::size_t>("--n_frames")));
+
+  for (const auto& set : sets)
+    for (const auto& setup : sweep(program))
+      benchmark::RegisterBenchmark(fmt::format("{}/{}/level:{}/block:{}/threads:{}", set.name,
+                                               setup.codec, setup.level, setup.block_size,
+                                               setup.threads)
+                                       .c_str(),
+                                   Compress, std::cref(set), setup)
+          ->UseRealTime()
+          ->Unit(benchmark::kMillisecond);
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "compression_controller.hpp"
+
+#include <gtest/gtest.h>
+
+using compress::CompressionController;
+
+namespace {
+constexpr CompressionController::thresholds limits{4, 1, 10, 0.9};
+constexpr double good_ratio = 0.5;
+
+void update_n(CompressionController& controller,
+              std::size_t n,
+              std::size_t backlog,
+              double ratio = good_ratio)
+{
+  for (auto i = 0u; i < n; i++)
+    controller.update(controller.level(), backlog, ratio);
+}
+} // namespace
+
+TEST(CompressionController, ShouldStepDownWhenBacklogIsHigh)
+{
+  CompressionController controller(3, limits);
+  EXPECT_EQ(0u, controller.level());
+  controller.update(0, 4, good_ratio);
+  EXPECT_EQ(1u, controller.level());
+  controller.update(1, 5, good_ratio);
+  EXPECT_EQ(2u, controller.level());
+  controller.update(2, 6, good_ratio);
+  EXPECT_EQ(2u, controller.level());
+}
+
+TEST(CompressionController, ShouldIgnoreImagesCompressedWithPreviousLevel)
+{
+  CompressionController controller(3, limits);
+  controller.update(0, 4, good_ratio);
+  // images taken before the change still report high backlog
+  for (auto i = 0; i < 5; i++)
+    controller.update(0, 4, good_ratio);
+  EXPECT_EQ(1u, controller.level());
+}
+
+TEST(CompressionController, ShouldStepUpOnlyAfterHoldImagesWithLowBacklog)
+{
+  CompressionController controller(3, limits);
+  controller.update(0, 4, good_ratio);
+  ASSERT_EQ(1u, controller.level());
+
+  update_n(controller, 9, 1);
+  EXPECT_EQ(1u, controller.level());
+  // backlog between the limits restarts counting
+  update_n(controller, 1, 2);
+  update_n(controller, 9, 0);
+  EXPECT_EQ(1u, controller.level());
+  update_n(controller, 1, 0);
+  EXPECT_EQ(0u, controller.level());
+}
+
+TEST(CompressionController, ShouldStepDownWhenDataDoesNotCompress)
+{
+  CompressionController controller(2, limits);
+  update_n(controller, 9, 0, 0.99);
+  EXPECT_EQ(0u, controller.level());
+  update_n(controller, 1, 0, 0.99);
+  EXPECT_EQ(1u, controller.level());
+  // calm pipeline makes the controller retry compression later
+  update_n(controller, 10, 0, 1.0);
+  EXPECT_EQ(0u, controller.level());
+}
+
+TEST(CompressionController, ShouldKeepLevelWithAverageRatioBelowLimit)
+{
+  CompressionController controller(2, limits);
+  for (auto i = 0; i < 5; i++) {
+    controller.update(0, 0, 0.99);
+    controller.update(0, 0, 0.7);
+  }
+  EXPECT_EQ(0u, controller.level());
+}
+
+TEST(CompressionController, ShouldDeriveThresholdsFromPipeline)
+{
+  const auto t = CompressionController::pipeline_thresholds(16, 4);
+  EXPECT_EQ(6u, t.high_backlog);
+  EXPECT_EQ(0u, t.low_backlog);
+  EXPECT_THROW(CompressionController::pipeline_thresholds(4, 4), std::invalid_argument);
+  EXPECT_THROW(CompressionController(0, limits), std::invalid_argument);
+  EXPECT_THROW(CompressionController(2, {1, 1, 10, 0.9}), std::invalid_argument);
+}
@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "compression_pipeline.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <semaphore>
+#include <set>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using compress::CompressionPipeline;
+
+namespace {
+std_daq_protocol::ImageMetadata image(uint64_t id)
+{
+  std_daq_protocol::ImageMetadata meta;
+  meta.set_image_id(id);
+  return meta;
+}
+} // namespace
+
+TEST(CompressionPipeline, ShouldPublishImagesInOrderOfSubmission)
+{
+  std::vector<uint64_t> published;
+  {
+    CompressionPipeline pipeline(
+        4, 8,
+        [](std::size_t, const CompressionPipeline::job& j) {
+          // later images finish first
+          std::this_thread::sleep_for(std::chrono::microseconds(100 * (8 - j.meta.image_id() % 8)));
+          return static_cast<int>(j.meta.image_id());
+        },
+        [&](const CompressionPipeline::job& j) {
+          EXPECT_EQ(static_cast<int>(j.meta.image_id()), j.compressed_size);
+          published.push_back(j.meta.image_id());
+        },
+        false);
+    for (auto i = 0u; i < 100; i++)
+      pipeline.submit(image(i));
+    pipeline.drain();
+  }
+  ASSERT_EQ(100u, published.size());
+  for (auto i = 0u; i < 100; i++)
+    EXPECT_EQ(i, published[i]);
+}
+
+TEST(CompressionPipeline, ShouldCompressImagesConcurrentlyUpToDepth)
+{
+  std::atomic<int> in_flight = 0;
+  std::atomic<int> max_in_flight = 0;
+  std::mutex mutex;
+  std::set<std::size_t> workers;
+
+  CompressionPipeline pipeline(
+      4, 2,
+      [&](std::size_t worker_id, const CompressionPipeline::job&) {
+        const auto current = ++in_flight;
+        for (auto seen = max_in_flight.load(); current > seen;)
+          max_in_flight.compare_exchange_weak(seen, current);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          workers.insert(worker_id);
+        }
+        std::this_thread::sleep_for(2ms);
+        in_flight--;
+        return 1;
+      },
+      [](const CompressionPipeline::job&) {}, false);
+  for (auto i = 0u; i < 50; i++)
+    pipeline.submit(image(i));
+  pipeline.drain();
+
+  EXPECT_EQ(2, max_in_flight.load());
+  EXPECT_GE(workers.size(), 2u);
+}
+
+TEST(CompressionPipeline, ShouldRecordQueueWaitAndCompressTime)
+{
+  std::vector<CompressionPipeline::job> published;
+  CompressionPipeline pipeline(
+      1, 4,
+      [](std::size_t, const CompressionPipeline::job&) {
+        std::this_thread::sleep_for(5ms);
+        return 1;
+      },
+      [&](const CompressionPipeline::job& j) { published.push_back(j); }, false);
+  for (auto i = 0u; i < 3; i++)
+    pipeline.submit(image(i));
+  pipeline.drain();
+
+  ASSERT_EQ(3u, published.size());
+  for (const auto& j : published) {
+    EXPECT_LE(j.submitted, j.started);
+    EXPECT_GE(j.finished - j.started, 5ms);
+  }
+  // single worker - the last image waited for the two before it
+  EXPECT_GE(published[2].started - published[2].submitted, 10ms);
+}
+
+TEST(CompressionPipeline, ShouldRejectEmptyPipeline)
+{
+  auto compress = [](std::size_t, const CompressionPipeline::job&) { return 0; };
+  auto publish = [](const CompressionPipeline::job&) {};
+  EXPECT_THROW(CompressionPipeline(0, 4, compress, publish), std::invalid_argument);
+  EXPECT_THROW(CompressionPipeline(4, 0, compress, publish), std::invalid_argument);
+}
+
+TEST(CompressionPipeline, ShouldReportImagesWaitingForWorker)
+{
+  std::vector<std::size_t> backlogs;
+  std::binary_semaphore release{0};
+  CompressionPipeline pipeline(
+      1, 4,
+      [&](std::size_t, const CompressionPipeline::job& j) {
+        if (j.meta.image_id() == 0) release.acquire();
+        return 1;
+      },
+      [&](const CompressionPipeline::job& j) { backlogs.push_back(j.backlog); }, false);
+  for (auto i = 0u; i < 4; i++)
+    pipeline.submit(image(i));
+  release.release();
+  pipeline.drain();
+
+  // the first image was taken before the others were submitted
+  ASSERT_EQ(4u, backlogs.size());
+  EXPECT_EQ((std::vector<std::size_t>{2, 1, 0}),
+            std::vector<std::size_t>(backlogs.begin() + 1, backlogs.end()));
+}
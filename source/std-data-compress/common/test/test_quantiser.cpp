@@ -0,0 +1,161 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "quantiser.hpp"
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using compress::Quantiser;
+using std_daq_protocol::ImageQuantisation;
+
+namespace {
+constexpr float energy_kev = 12.4f;
+
+// odd number of pixels exercises the scalar tail of the vectorised kernels
+std::vector<float> random_image(std::size_t n_pixels = 1027)
+{
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> photons(-2.f, 2000.f);
+  std::vector<float> image(n_pixels);
+  for (auto& v : image)
+    v = photons(gen) * energy_kev;
+  image[0] = 0.f;
+  image[1] = -0.4f * energy_kev;
+  return image;
+}
+
+utils::DetectorConfig create_config(std::string type, utils::converted_output_config output)
+{
+  return {"JF",
+          std::move(type),
+          2,
+          32,
+          1024,
+          1024,
+          0,
+          "debug",
+          std::chrono::seconds(30),
+          8,
+          false,
+          16777216,
+          false,
+          50,
+          0,
+          1000,
+          std::chrono::seconds(30),
+          false,
+          {},
+          {},
+          output};
+}
+
+std::vector<float> quantise(const Quantiser& quantiser, const std::vector<float>& image)
+{
+  std::vector<float> output(image.size());
+  quantiser.quantise(image.data(), output.data(), image.size());
+  return output;
+}
+
+void expect_within_bounds(const Quantiser& quantiser, const std::vector<float>& image)
+{
+  const auto output = quantise(quantiser, image);
+  for (auto i = 0u; i < image.size(); i++) {
+    const auto photons = image[i] / energy_kev;
+    // relative float32 rounding of the transform on top of the quantisation bound
+    const auto tolerance = 1e-5f * (std::fabs(photons) + 1.f);
+    EXPECT_LE(std::fabs(output[i] / energy_kev - photons),
+              quantiser.max_error_photons(photons) + tolerance)
+        << "pixel " << i << " value " << image[i];
+  }
+}
+} // namespace
+
+TEST(Quantiser, RoundingShouldStayWithinHalfStep)
+{
+  Quantiser quantiser(ImageQuantisation::rounding, 0.5f, energy_kev);
+  expect_within_bounds(quantiser, random_image());
+  EXPECT_FLOAT_EQ(0.25f, quantiser.max_error_photons(1000.f));
+}
+
+TEST(Quantiser, AnscombeShouldStayWithinNoiseScaledBound)
+{
+  Quantiser quantiser(ImageQuantisation::anscombe, 0.5f, energy_kev);
+  expect_within_bounds(quantiser, random_image());
+  EXPECT_GT(quantiser.max_error_photons(1000.f), quantiser.max_error_photons(1.f));
+}
+
+TEST(Quantiser, ShouldKeepZeroAndSign)
+{
+  for (auto m : {ImageQuantisation::rounding, ImageQuantisation::anscombe}) {
+    Quantiser quantiser(m, 0.5f, energy_kev);
+    const auto output = quantise(quantiser, random_image());
+    EXPECT_EQ(0.f, output[0]);
+    EXPECT_LE(output[1], 0.f);
+  }
+}
+
+TEST(Quantiser, ShouldBeIdempotent)
+{
+  for (auto m : {ImageQuantisation::rounding, ImageQuantisation::anscombe}) {
+    Quantiser quantiser(m, 0.5f, energy_kev);
+    const auto once = quantise(quantiser, random_image());
+    const auto twice = quantise(quantiser, once);
+    for (auto i = 0u; i < once.size(); i++)
+      EXPECT_NEAR(once[i], twice[i], 1e-5f * (std::fabs(once[i]) + 1.f)) << "pixel " << i;
+  }
+}
+
+TEST(Quantiser, ShouldQuantiseRawBytesIntoSeparateBuffer)
+{
+  Quantiser quantiser(ImageQuantisation::rounding, 1.f, energy_kev);
+  const auto image = random_image(16);
+  const auto expected = quantise(quantiser, image);
+  const auto* raw = reinterpret_cast<const char*>(image.data());
+  const auto* output =
+      reinterpret_cast<const float*>(quantiser.quantise(raw, image.size() * sizeof(float)));
+  EXPECT_NE(image.data(), output);
+  for (auto i = 0u; i < image.size(); i++)
+    EXPECT_EQ(expected[i], output[i]);
+}
+
+TEST(Quantiser, ShouldDescribeQuantisationInMetadata)
+{
+  Quantiser quantiser(ImageQuantisation::anscombe, 0.25f, energy_kev);
+  std_daq_protocol::ImageMetadata meta;
+  quantiser.describe(meta);
+  ASSERT_TRUE(meta.has_quantisation());
+  EXPECT_EQ(ImageQuantisation::anscombe, meta.quantisation().mode());
+  EXPECT_FLOAT_EQ(0.25f, meta.quantisation().step());
+  EXPECT_FLOAT_EQ(energy_kev, meta.quantisation().photon_energy_kev());
+}
+
+TEST(Quantiser, ShouldRejectInvalidParameters)
+{
+  EXPECT_THROW(Quantiser(ImageQuantisation::rounding, 0.f, energy_kev), std::invalid_argument);
+  EXPECT_THROW(Quantiser(ImageQuantisation::rounding, 0.5f, 0.f), std::invalid_argument);
+  EXPECT_THROW(Quantiser::to_mode("sqrt"), std::invalid_argument);
+  EXPECT_EQ(ImageQuantisation::anscombe, Quantiser::to_mode("anscombe"));
+}
+
+TEST(Quantiser, ShouldBeCreatedOnlyForFloatConvertedImages)
+{
+  using output = utils::converted_output_config;
+  const auto converted = create_config("jungfrau-converted", {output::float32, energy_kev});
+  EXPECT_FALSE(Quantiser::from_config("none", 0.5f, converted).has_value());
+  EXPECT_TRUE(Quantiser::from_config("rounding", 0.5f, converted).has_value());
+  EXPECT_THROW(Quantiser::from_config("rounding", 0.5f,
+                                      create_config("jungfrau-converted", {output::float32, 0.f})),
+               std::invalid_argument);
+  EXPECT_THROW(Quantiser::from_config("anscombe", 0.5f,
+                                      create_config("jungfrau-converted", {output::uint16, 8.f})),
+               std::invalid_argument);
+  EXPECT_THROW(Quantiser::from_config("rounding", 0.5f,
+                                      create_config("jungfrau-raw", {output::float32, 8.f})),
+               std::invalid_argument);
+}
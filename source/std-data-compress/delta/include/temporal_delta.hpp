@@ -0,0 +1,105 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace compress::delta {
+
+// Chunk layout - big endian as the HDF5 bitshuffle filter header it extends:
+//   [0, 8)   image size in bytes
+//   [8, 12)  bitshuffle block size in bytes
+//   [12, 20) image id
+//   [20, 28) id of the reference image - own id for keyframes
+//   [28, ..) bitshuffle lz4 of the image for keyframes, of the zig-zag residual otherwise
+constexpr std::size_t header_n_bytes = 28;
+// filter id of HDF5 datasets storing chunks of this codec as they are - the id is from the range
+// reserved for private use, no HDF5 filter decodes it, readers take chunks with H5Dread_chunk
+constexpr unsigned h5_filter_id = 32768;
+
+struct chunk_header
+{
+  uint64_t image_n_bytes;
+  uint32_t block_size;
+  uint64_t image_id;
+  uint64_t reference_id;
+
+  [[nodiscard]] bool is_keyframe() const { return image_id == reference_id; }
+};
+
+void write_header(const chunk_header& header, char* chunk);
+[[nodiscard]] chunk_header read_header(const char* chunk);
+
+[[nodiscard]] std::size_t max_compressed_n_bytes(std::size_t image_n_bytes,
+                                                 std::size_t element_size);
+
+// residual = zig-zag(image - reference) in wrap around arithmetic of unsigned elements of 1, 2 or
+// 4 bytes - exact for any values, floats are processed as their bit patterns
+void encode_residual(const char* image,
+                     const char* reference,
+                     char* residual,
+                     std::size_t n_bytes,
+                     std::size_t element_size);
+void decode_residual(const char* residual,
+                     const char* reference,
+                     char* image,
+                     std::size_t n_bytes,
+                     std::size_t element_size);
+
+// Compresses images as residuals against the keyframe of their interval - every image with id
+// divisible by keyframe_interval. Images whose keyframe was not seen (yet) are compressed as
+// keyframes themselves, so any image decodes with at most one other image. Safe to call from
+// multiple threads, the last two keyframes are kept.
+//
+// Keyframe not newer than the one it replaces, or image encoded twice against the same keyframe,
+// starts a restarted acquisition - all kept keyframes are dropped.
+class Encoder
+{
+public:
+  Encoder(std::size_t element_size, uint64_t keyframe_interval, int block_size = 0);
+
+  // returns number of bytes written to output or negative bitshuffle error
+  int64_t compress(uint64_t image_id, const char* image, std::size_t n_bytes, char* output);
+
+private:
+  struct keyframe
+  {
+    bool claimed = false;
+    uint64_t image_id = 0;
+    // null while the keyframe is being copied
+    std::shared_ptr<const std::vector<char>> data;
+    // images of the interval already encoded against the keyframe
+    std::vector<bool> encoded;
+  };
+
+  std::shared_ptr<const std::vector<char>> reference_for(uint64_t image_id,
+                                                         uint64_t keyframe_id,
+                                                         const char* image,
+                                                         std::size_t n_bytes);
+
+  const std::size_t element_size;
+  const uint64_t keyframe_interval;
+  const int block_size;
+  std::mutex mutex;
+  std::array<keyframe, 2> keyframes;
+};
+
+// Re-encodes residual chunk as keyframe - reference_chunk is the keyframe chunk it was encoded
+// against. Returns number of bytes written to output or negative bitshuffle error.
+int64_t rebase_to_keyframe(const char* chunk,
+                           const char* reference_chunk,
+                           std::size_t element_size,
+                           char* output);
+
+// Decompresses chunk into image - reference is the decoded image with id read_header().reference_id
+// and may be null for keyframes. Returns image size or negative bitshuffle error.
+int64_t decompress(const char* chunk, std::size_t element_size, char* image, const char* reference);
+
+} // namespace compress::delta
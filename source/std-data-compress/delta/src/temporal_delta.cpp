@@ -0,0 +1,326 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "temporal_delta.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <endian.h>
+#include <fmt/core.h>
+#include <bitshuffle/bitshuffle.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace compress::delta {
+namespace {
+
+template <typename T>
+void encode_scalar(const T* image, const T* reference, T* residual, std::size_t n_elements)
+{
+  using signed_type = std::make_signed_t<T>;
+  constexpr auto sign_shift = sizeof(T) * 8 - 1;
+  for (auto i = 0u; i < n_elements; i++) {
+    const auto d = static_cast<signed_type>(static_cast<T>(image[i] - reference[i]));
+    residual[i] = static_cast<T>(static_cast<T>(static_cast<T>(d) << 1) ^
+                                 static_cast<T>(d >> sign_shift));
+  }
+}
+
+template <typename T>
+void decode_scalar(const T* residual, const T* reference, T* image, std::size_t n_elements)
+{
+  for (auto i = 0u; i < n_elements; i++) {
+    const T z = residual[i];
+    const auto d = static_cast<T>((z >> 1) ^ static_cast<T>(-(z & 1)));
+    image[i] = static_cast<T>(reference[i] + d);
+  }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) __m256i load(const void* data)
+{
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+
+__attribute__((target("avx2"))) void store(void* data, __m256i value)
+{
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), value);
+}
+
+__attribute__((target("avx2"))) void encode_avx2(const uint16_t* image,
+                                                 const uint16_t* reference,
+                                                 uint16_t* residual,
+                                                 std::size_t n_elements)
+{
+  auto i = 0ul;
+  for (; i + 16 <= n_elements; i += 16) {
+    const auto d = _mm256_sub_epi16(load(image + i), load(reference + i));
+    store(residual + i, _mm256_xor_si256(_mm256_slli_epi16(d, 1), _mm256_srai_epi16(d, 15)));
+  }
+  encode_scalar(image + i, reference + i, residual + i, n_elements - i);
+}
+
+__attribute__((target("avx2"))) void encode_avx2(const uint32_t* image,
+                                                 const uint32_t* reference,
+                                                 uint32_t* residual,
+                                                 std::size_t n_elements)
+{
+  auto i = 0ul;
+  for (; i + 8 <= n_elements; i += 8) {
+    const auto d = _mm256_sub_epi32(load(image + i), load(reference + i));
+    store(residual + i, _mm256_xor_si256(_mm256_slli_epi32(d, 1), _mm256_srai_epi32(d, 31)));
+  }
+  encode_scalar(image + i, reference + i, residual + i, n_elements - i);
+}
+
+__attribute__((target("avx2"))) void decode_avx2(const uint16_t* residual,
+                                                 const uint16_t* reference,
+                                                 uint16_t* image,
+                                                 std::size_t n_elements)
+{
+  const auto one = _mm256_set1_epi16(1);
+  const auto zero = _mm256_setzero_si256();
+  auto i = 0ul;
+  for (; i + 16 <= n_elements; i += 16) {
+    const auto z = load(residual + i);
+    const auto d = _mm256_xor_si256(_mm256_srli_epi16(z, 1),
+                                    _mm256_sub_epi16(zero, _mm256_and_si256(z, one)));
+    store(image + i, _mm256_add_epi16(load(reference + i), d));
+  }
+  decode_scalar(residual + i, reference + i, image + i, n_elements - i);
+}
+
+__attribute__((target("avx2"))) void decode_avx2(const uint32_t* residual,
+                                                 const uint32_t* reference,
+                                                 uint32_t* image,
+                                                 std::size_t n_elements)
+{
+  const auto one = _mm256_set1_epi32(1);
+  const auto zero = _mm256_setzero_si256();
+  auto i = 0ul;
+  for (; i + 8 <= n_elements; i += 8) {
+    const auto z = load(residual + i);
+    const auto d = _mm256_xor_si256(_mm256_srli_epi32(z, 1),
+                                    _mm256_sub_epi32(zero, _mm256_and_si256(z, one)));
+    store(image + i, _mm256_add_epi32(load(reference + i), d));
+  }
+  decode_scalar(residual + i, reference + i, image + i, n_elements - i);
+}
+#endif
+
+bool has_avx2()
+{
+#if defined(__x86_64__)
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+template <typename T>
+void encode(const char* image, const char* reference, char* residual, std::size_t n_bytes)
+{
+  const auto* in = reinterpret_cast<const T*>(image);
+  const auto* ref = reinterpret_cast<const T*>(reference);
+  auto* out = reinterpret_cast<T*>(residual);
+#if defined(__x86_64__)
+  if constexpr (sizeof(T) > 1)
+    if (has_avx2()) return encode_avx2(in, ref, out, n_bytes / sizeof(T));
+#endif
+  encode_scalar(in, ref, out, n_bytes / sizeof(T));
+}
+
+template <typename T>
+void decode(const char* residual, const char* reference, char* image, std::size_t n_bytes)
+{
+  const auto* in = reinterpret_cast<const T*>(residual);
+  const auto* ref = reinterpret_cast<const T*>(reference);
+  auto* out = reinterpret_cast<T*>(image);
+#if defined(__x86_64__)
+  if constexpr (sizeof(T) > 1)
+    if (has_avx2()) return decode_avx2(in, ref, out, n_bytes / sizeof(T));
+#endif
+  decode_scalar(in, ref, out, n_bytes / sizeof(T));
+}
+
+void check_element_size(std::size_t element_size)
+{
+  if (element_size != 1 && element_size != 2 && element_size != 4)
+    throw std::invalid_argument(
+        fmt::format("Temporal delta supports 1, 2 or 4 byte elements - got {}", element_size));
+}
+
+} // namespace
+
+void write_header(const chunk_header& header, char* chunk)
+{
+  const auto image_n_bytes = htobe64(header.image_n_bytes);
+  const auto block_size = htobe32(header.block_size);
+  const auto image_id = htobe64(header.image_id);
+  const auto reference_id = htobe64(header.reference_id);
+  std::memcpy(chunk + 0, &image_n_bytes, 8);
+  std::memcpy(chunk + 8, &block_size, 4);
+  std::memcpy(chunk + 12, &image_id, 8);
+  std::memcpy(chunk + 20, &reference_id, 8);
+}
+
+chunk_header read_header(const char* chunk)
+{
+  chunk_header header{};
+  std::memcpy(&header.image_n_bytes, chunk + 0, 8);
+  std::memcpy(&header.block_size, chunk + 8, 4);
+  std::memcpy(&header.image_id, chunk + 12, 8);
+  std::memcpy(&header.reference_id, chunk + 20, 8);
+  return {be64toh(header.image_n_bytes), be32toh(header.block_size), be64toh(header.image_id),
+          be64toh(header.reference_id)};
+}
+
+std::size_t max_compressed_n_bytes(std::size_t image_n_bytes, std::size_t element_size)
+{
+  return header_n_bytes + bshuf_compress_lz4_bound(image_n_bytes / element_size, element_size, 0);
+}
+
+void encode_residual(const char* image,
+                     const char* reference,
+                     char* residual,
+                     std::size_t n_bytes,
+                     std::size_t element_size)
+{
+  check_element_size(element_size);
+  if (element_size == 1) encode<uint8_t>(image, reference, residual, n_bytes);
+  if (element_size == 2) encode<uint16_t>(image, reference, residual, n_bytes);
+  if (element_size == 4) encode<uint32_t>(image, reference, residual, n_bytes);
+}
+
+void decode_residual(const char* residual,
+                     const char* reference,
+                     char* image,
+                     std::size_t n_bytes,
+                     std::size_t element_size)
+{
+  check_element_size(element_size);
+  if (element_size == 1) decode<uint8_t>(residual, reference, image, n_bytes);
+  if (element_size == 2) decode<uint16_t>(residual, reference, image, n_bytes);
+  if (element_size == 4) decode<uint32_t>(residual, reference, image, n_bytes);
+}
+
+Encoder::Encoder(std::size_t element_size, uint64_t keyframe_interval, int block_size)
+    : element_size(element_size)
+    , keyframe_interval(keyframe_interval)
+    , block_size(block_size)
+{
+  check_element_size(element_size);
+  if (keyframe_interval == 0) throw std::invalid_argument("Keyframe interval must be positive");
+}
+
+int64_t Encoder::compress(uint64_t image_id, const char* image, std::size_t n_bytes, char* output)
+{
+  const auto keyframe_id = image_id - image_id % keyframe_interval;
+  const auto reference = reference_for(image_id, keyframe_id, image, n_bytes);
+
+  const char* source = image;
+  if (reference) {
+    thread_local std::vector<char> residual;
+    residual.resize(n_bytes);
+    encode_residual(image, reference->data(), residual.data(), n_bytes, element_size);
+    source = residual.data();
+  }
+
+  write_header({n_bytes, static_cast<uint32_t>(block_size), image_id,
+                reference ? keyframe_id : image_id},
+               output);
+  const auto size = bshuf_compress_lz4(source, output + header_n_bytes, n_bytes / element_size,
+                                       element_size, block_size / element_size);
+  return size < 0 ? size : size + static_cast<int64_t>(header_n_bytes);
+}
+
+// keyframes are copied - the ring buffer slot is reused while images referencing it are in flight.
+// The slot is claimed before the copy, images of the interval never see the previous keyframe.
+std::shared_ptr<const std::vector<char>> Encoder::reference_for(uint64_t image_id,
+                                                                uint64_t keyframe_id,
+                                                                const char* image,
+                                                                std::size_t n_bytes)
+{
+  auto& slot = keyframes[(keyframe_id / keyframe_interval) % keyframes.size()];
+  std::unique_lock<std::mutex> lock(mutex);
+  if (image_id == keyframe_id) {
+    if (slot.claimed && keyframe_id <= slot.image_id) keyframes.fill({});
+    slot = {true, image_id, nullptr, std::vector<bool>(keyframe_interval)};
+    lock.unlock();
+    auto data = std::make_shared<const std::vector<char>>(image, image + n_bytes);
+    lock.lock();
+    if (slot.claimed && slot.image_id == image_id && !slot.data) slot.data = std::move(data);
+    return nullptr;
+  }
+
+  if (!slot.data || slot.image_id != keyframe_id || slot.data->size() != n_bytes) return nullptr;
+  if (slot.encoded[image_id - keyframe_id]) {
+    keyframes.fill({});
+    return nullptr;
+  }
+  slot.encoded[image_id - keyframe_id] = true;
+  return slot.data;
+}
+
+int64_t decompress(const char* chunk, std::size_t element_size, char* image, const char* reference)
+{
+  check_element_size(element_size);
+  const auto header = read_header(chunk);
+  const auto n_elements = header.image_n_bytes / element_size;
+  const auto block_elements = header.block_size / element_size;
+  const auto* payload = chunk + header_n_bytes;
+
+  if (header.is_keyframe()) {
+    const auto consumed = bshuf_decompress_lz4(payload, image, n_elements, element_size,
+                                               block_elements);
+    return consumed < 0 ? consumed : static_cast<int64_t>(header.image_n_bytes);
+  }
+
+  if (reference == nullptr)
+    throw std::invalid_argument(fmt::format("Image {} needs reference image {}", header.image_id,
+                                            header.reference_id));
+  thread_local std::vector<char> residual;
+  residual.resize(header.image_n_bytes);
+  const auto consumed = bshuf_decompress_lz4(payload, residual.data(), n_elements, element_size,
+                                             block_elements);
+  if (consumed < 0) return consumed;
+  decode_residual(residual.data(), reference, image, header.image_n_bytes, element_size);
+  return static_cast<int64_t>(header.image_n_bytes);
+}
+
+int64_t rebase_to_keyframe(const char* chunk,
+                           const char* reference_chunk,
+                           std::size_t element_size,
+                           char* output)
+{
+  const auto header = read_header(chunk);
+  const auto reference = read_header(reference_chunk);
+  if (!reference.is_keyframe() || reference.image_id != header.reference_id ||
+      reference.image_n_bytes != header.image_n_bytes)
+    throw std::invalid_argument(fmt::format("Image {} is not the keyframe of image {}",
+                                            reference.image_id, header.image_id));
+
+  thread_local std::vector<char> keyframe, image;
+  keyframe.resize(header.image_n_bytes);
+  image.resize(header.image_n_bytes);
+  if (const auto size = decompress(reference_chunk, element_size, keyframe.data(), nullptr);
+      size < 0)
+    return size;
+  if (const auto size = decompress(chunk, element_size, image.data(), keyframe.data()); size < 0)
+    return size;
+
+  write_header({header.image_n_bytes, header.block_size, header.image_id, header.image_id},
+               output);
+  const auto size = bshuf_compress_lz4(image.data(), output + header_n_bytes,
+                                       header.image_n_bytes / element_size, element_size,
+                                       header.block_size / element_size);
+  return size < 0 ? size : size + static_cast<int64_t>(header_n_bytes);
+}
+
+} // namespace compress::delta
@@ -0,0 +1,171 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "temporal_delta.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <omp.h>
+#include <blosc2.h>
+#include <benchmark/benchmark.h>
+#include <bitshuffle/bitshuffle.h>
+
+namespace {
+
+namespace delta = compress::delta;
+
+constexpr std::size_t n_frames = 16;
+constexpr std::size_t element_size = sizeof(uint16_t);
+
+// tomography projection series - textured static background, shot noise and a sample edge moving
+// by one pixel per frame
+std::vector<std::vector<char>> projections(std::size_t height, std::size_t width)
+{
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> texture(2000, 12000);
+  std::vector<uint16_t> background(height * width);
+  for (auto& pixel : background)
+    pixel = static_cast<uint16_t>(texture(gen));
+
+  std::vector<std::vector<char>> frames;
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  for (auto f = 0u; f < n_frames; f++) {
+    std::vector<uint16_t> frame(height * width);
+    for (auto y = 0u; y < height; y++)
+      for (auto x = 0u; x < width; x++) {
+        const auto absorption = x < width / 3 + f ? 0.5f : 1.0f;
+        const auto value = static_cast<float>(background[y * width + x]) * absorption;
+        frame[y * width + x] = static_cast<uint16_t>(value + std::sqrt(value) * noise(gen));
+      }
+    frames.emplace_back(reinterpret_cast<const char*>(frame.data()),
+                        reinterpret_cast<const char*>(frame.data() + frame.size()));
+  }
+  return frames;
+}
+
+void report(benchmark::State& state, std::size_t raw_bytes, std::size_t compressed_bytes)
+{
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw_bytes));
+  state.counters["ratio"] =
+      static_cast<double>(compressed_bytes) / static_cast<double>(raw_bytes);
+}
+
+// current std_data_compress_h5bitshuffle_lz4 codec
+void Codec_h5bitshuffle_lz4(benchmark::State& state)
+{
+  omp_set_num_threads(1);
+  const auto frames = projections(state.range(0), state.range(1));
+  const auto n_bytes = frames.front().size();
+  std::vector<char> output(delta::max_compressed_n_bytes(n_bytes, element_size));
+
+  std::size_t compressed = 0;
+  for (auto _ : state) {
+    compressed = 0;
+    for (const auto& frame : frames)
+      compressed += bshuf_compress_lz4(frame.data(), output.data(), n_bytes / element_size,
+                                       element_size, 0);
+  }
+  report(state, n_bytes * n_frames, compressed);
+}
+
+// current std_data_compress_blosc2 codec with its default level
+void Codec_blosc2(benchmark::State& state)
+{
+  const auto frames = projections(state.range(0), state.range(1));
+  const auto n_bytes = frames.front().size();
+  std::vector<char> output(n_bytes + BLOSC2_MAX_OVERHEAD);
+
+  blosc2_cparams params = BLOSC2_CPARAMS_DEFAULTS;
+  params.nthreads = 1;
+  params.typesize = element_size;
+  params.compcode = BLOSC_LZ4;
+  params.clevel = 5;
+  params.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_BITSHUFFLE;
+  auto* ctx = blosc2_create_cctx(params);
+
+  std::size_t compressed = 0;
+  for (auto _ : state) {
+    compressed = 0;
+    for (const auto& frame : frames) {
+      const auto size = blosc2_compress_ctx(ctx, frame.data(), static_cast<int32_t>(n_bytes),
+                                            output.data(), static_cast<int32_t>(output.size()));
+      if (size <= 0) {
+        state.SkipWithError("blosc2 compression failed");
+        break;
+      }
+      compressed += size;
+    }
+  }
+  blosc2_free_ctx(ctx);
+  report(state, n_bytes * n_frames, compressed);
+}
+
+void Codec_temporal_delta(benchmark::State& state)
+{
+  omp_set_num_threads(1);
+  const auto frames = projections(state.range(0), state.range(1));
+  const auto n_bytes = frames.front().size();
+  std::vector<char> output(delta::max_compressed_n_bytes(n_bytes, element_size));
+  delta::Encoder encoder(element_size, static_cast<uint64_t>(state.range(2)));
+
+  std::size_t compressed = 0;
+  uint64_t image_id = 0;
+  for (auto _ : state) {
+    compressed = 0;
+    for (const auto& frame : frames)
+      compressed += encoder.compress(image_id++, frame.data(), n_bytes, output.data());
+  }
+  report(state, n_bytes * n_frames, compressed);
+}
+
+void Decode_temporal_delta(benchmark::State& state)
+{
+  omp_set_num_threads(1);
+  const auto frames = projections(state.range(0), state.range(1));
+  const auto n_bytes = frames.front().size();
+  delta::Encoder encoder(element_size, n_frames);
+  std::vector<std::vector<char>> chunks;
+  for (auto i = 0u; i < n_frames; i++) {
+    chunks.emplace_back(delta::max_compressed_n_bytes(n_bytes, element_size));
+    encoder.compress(i, frames[i].data(), n_bytes, chunks.back().data());
+  }
+
+  std::vector<char> keyframe(n_bytes);
+  std::vector<char> image(n_bytes);
+  for (auto _ : state) {
+    delta::decompress(chunks.front().data(), element_size, keyframe.data(), nullptr);
+    for (auto i = 1u; i < n_frames; i++)
+      delta::decompress(chunks[i].data(), element_size, image.data(), keyframe.data());
+    benchmark::DoNotOptimize(image.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * n_bytes * n_frames));
+}
+
+} // namespace
+
+// GigaFRoST geometry of testing/test_files/gf_tomcat.json and PCO.edge sensor
+BENCHMARK(Codec_h5bitshuffle_lz4)
+    ->ArgNames({"height", "width"})
+    ->Args({2016, 2016})
+    ->Args({2160, 2560})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(Codec_blosc2)
+    ->ArgNames({"height", "width"})
+    ->Args({2016, 2016})
+    ->Args({2160, 2560})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(Codec_temporal_delta)
+    ->ArgNames({"height", "width", "keyframe_interval"})
+    ->Args({2016, 2016, 4})
+    ->Args({2016, 2016, 100})
+    ->Args({2160, 2560, 100})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(Decode_temporal_delta)
+    ->ArgNames({"height", "width"})
+    ->Args({2016, 2016})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
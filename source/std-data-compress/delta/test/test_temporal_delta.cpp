@@ -0,0 +1,271 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "temporal_delta.hpp"
+
+#include <random>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace delta = compress::delta;
+
+namespace {
+// odd number of elements exercises the scalar tail after vector loops
+constexpr std::size_t n_elements = 1027;
+
+std::vector<char> random_image(std::size_t n_bytes, unsigned seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<char> image(n_bytes);
+  for (auto& c : image)
+    c = static_cast<char>(dist(gen));
+  return image;
+}
+
+// textured static background with small per image noise
+std::vector<uint16_t> background_image(unsigned seed)
+{
+  std::mt19937 texture_gen(42);
+  std::uniform_int_distribution<int> texture(1000, 20000);
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> noise(0.0f, 2.0f);
+  std::vector<uint16_t> image(64 * 1024);
+  for (auto& pixel : image)
+    pixel = static_cast<uint16_t>(texture(texture_gen) + static_cast<int>(noise(gen)));
+  return image;
+}
+} // namespace
+
+class TemporalDeltaResidual : public ::testing::TestWithParam<std::size_t>
+{};
+
+TEST_P(TemporalDeltaResidual, ShouldRoundTripAnyValues)
+{
+  const auto element_size = GetParam();
+  const auto n_bytes = n_elements * element_size;
+  const auto image = random_image(n_bytes, 1);
+  const auto reference = random_image(n_bytes, 2);
+  std::vector<char> residual(n_bytes);
+  std::vector<char> decoded(n_bytes);
+
+  delta::encode_residual(image.data(), reference.data(), residual.data(), n_bytes, element_size);
+  delta::decode_residual(residual.data(), reference.data(), decoded.data(), n_bytes, element_size);
+  EXPECT_EQ(image, decoded);
+}
+
+TEST_P(TemporalDeltaResidual, ShouldMapSmallDifferencesToSmallValues)
+{
+  const auto element_size = GetParam();
+  const auto n_bytes = n_elements * element_size;
+  std::vector<char> reference(n_bytes, 0);
+  std::vector<char> image(n_bytes, 0);
+  std::vector<char> residual(n_bytes);
+  // first byte of little endian element - values 0, 1, 2 against reference 1
+  for (auto i = 0u; i < n_elements; i++) {
+    reference[i * element_size] = 1;
+    image[i * element_size] = static_cast<char>(i % 3);
+  }
+
+  delta::encode_residual(image.data(), reference.data(), residual.data(), n_bytes, element_size);
+  for (auto i = 0u; i < n_elements; i++) {
+    // zig-zag: -1 -> 1, 0 -> 0, 1 -> 2
+    const auto expected = std::array<char, 3>{1, 0, 2}[i % 3];
+    EXPECT_EQ(expected, residual[i * element_size]);
+    for (auto b = 1u; b < element_size; b++)
+      EXPECT_EQ(0, residual[i * element_size + b]);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(ElementSizes, TemporalDeltaResidual, ::testing::Values(1, 2, 4));
+
+TEST(TemporalDelta, ShouldRejectUnsupportedElementSize)
+{
+  char data[8]{};
+  EXPECT_THROW(delta::encode_residual(data, data, data, 8, 8), std::invalid_argument);
+  EXPECT_THROW(delta::Encoder(3, 10), std::invalid_argument);
+  EXPECT_THROW(delta::Encoder(2, 0), std::invalid_argument);
+}
+
+TEST(TemporalDelta, ShouldRoundTripHeader)
+{
+  char chunk[delta::header_n_bytes];
+  delta::write_header({1024, 8192, 1234567890123ul, 1234567890100ul}, chunk);
+  const auto header = delta::read_header(chunk);
+  EXPECT_EQ(1024u, header.image_n_bytes);
+  EXPECT_EQ(8192u, header.block_size);
+  EXPECT_EQ(1234567890123ul, header.image_id);
+  EXPECT_EQ(1234567890100ul, header.reference_id);
+  EXPECT_FALSE(header.is_keyframe());
+}
+
+TEST(TemporalDelta, ShouldEncodeImagesAgainstKeyframeOfTheirInterval)
+{
+  constexpr auto n_bytes = 64 * 1024 * sizeof(uint16_t);
+  delta::Encoder encoder(2, 10);
+  std::vector<char> compressed(delta::max_compressed_n_bytes(n_bytes, 2));
+  std::vector<std::vector<uint16_t>> images;
+  std::vector<uint16_t> decoded(64 * 1024);
+  std::vector<uint16_t> keyframe(64 * 1024);
+
+  for (auto id = 20u; id < 35; id++) {
+    const auto image = background_image(id);
+    const auto size = encoder.compress(id, reinterpret_cast<const char*>(image.data()), n_bytes,
+                                       compressed.data());
+    ASSERT_GT(size, 0);
+    const auto header = delta::read_header(compressed.data());
+    EXPECT_EQ(id, header.image_id);
+    EXPECT_EQ(id - id % 10, header.reference_id);
+
+    auto* reference = header.is_keyframe() ? nullptr : reinterpret_cast<char*>(keyframe.data());
+    ASSERT_EQ(static_cast<int64_t>(n_bytes),
+              delta::decompress(compressed.data(), 2, reinterpret_cast<char*>(decoded.data()),
+                                reference));
+    EXPECT_EQ(image, decoded);
+    if (header.is_keyframe()) keyframe = decoded;
+  }
+}
+
+TEST(TemporalDelta, ShouldCompressStaticBackgroundBetterThanKeyframe)
+{
+  constexpr auto n_bytes = 64 * 1024 * sizeof(uint16_t);
+  delta::Encoder encoder(2, 100);
+  std::vector<char> compressed(delta::max_compressed_n_bytes(n_bytes, 2));
+
+  const auto keyframe = background_image(0);
+  const auto keyframe_size = encoder.compress(0, reinterpret_cast<const char*>(keyframe.data()),
+                                              n_bytes, compressed.data());
+  const auto image = background_image(1);
+  const auto residual_size = encoder.compress(1, reinterpret_cast<const char*>(image.data()),
+                                              n_bytes, compressed.data());
+  EXPECT_LT(residual_size * 2, keyframe_size);
+}
+
+TEST(TemporalDelta, ShouldEncodeImageWithoutSeenKeyframeAsKeyframe)
+{
+  constexpr auto n_bytes = 1024u;
+  delta::Encoder encoder(2, 10);
+  const auto image = random_image(n_bytes, 3);
+  std::vector<char> compressed(delta::max_compressed_n_bytes(n_bytes, 2));
+
+  ASSERT_GT(encoder.compress(0, image.data(), n_bytes, compressed.data()), 0);
+  // keyframe 10 was lost
+  ASSERT_GT(encoder.compress(13, image.data(), n_bytes, compressed.data()), 0);
+  EXPECT_TRUE(delta::read_header(compressed.data()).is_keyframe());
+  std::vector<char> decoded(n_bytes);
+  EXPECT_EQ(n_bytes, delta::decompress(compressed.data(), 2, decoded.data(), nullptr));
+  EXPECT_EQ(image, decoded);
+
+  // image of different size cannot use the keyframe
+  ASSERT_GT(encoder.compress(5, image.data(), n_bytes / 2, compressed.data()), 0);
+  EXPECT_TRUE(delta::read_header(compressed.data()).is_keyframe());
+}
+
+TEST(TemporalDelta, ShouldNotReferenceKeyframeOfPreviousAcquisition)
+{
+  constexpr auto n_bytes = 1024u;
+  delta::Encoder encoder(2, 10);
+  std::vector<char> compressed(delta::max_compressed_n_bytes(n_bytes, 2));
+  for (auto id = 0u; id < 2; id++)
+    ASSERT_GT(encoder.compress(id, random_image(n_bytes, id).data(), n_bytes, compressed.data()),
+              0);
+
+  // image 1 of the restarted acquisition arrives before its keyframe
+  ASSERT_GT(encoder.compress(1, random_image(n_bytes, 101).data(), n_bytes, compressed.data()), 0);
+  EXPECT_TRUE(delta::read_header(compressed.data()).is_keyframe());
+  // image 2 was not encoded before - it would find the keyframe of the previous acquisition
+  ASSERT_GT(encoder.compress(2, random_image(n_bytes, 102).data(), n_bytes, compressed.data()), 0);
+  EXPECT_TRUE(delta::read_header(compressed.data()).is_keyframe());
+
+  const auto keyframe = random_image(n_bytes, 100);
+  ASSERT_GT(encoder.compress(0, keyframe.data(), n_bytes, compressed.data()), 0);
+  const auto image = random_image(n_bytes, 103);
+  ASSERT_GT(encoder.compress(3, image.data(), n_bytes, compressed.data()), 0);
+  EXPECT_EQ(0u, delta::read_header(compressed.data()).reference_id);
+  std::vector<char> decoded(n_bytes);
+  EXPECT_EQ(n_bytes, delta::decompress(compressed.data(), 2, decoded.data(), keyframe.data()));
+  EXPECT_EQ(image, decoded);
+}
+
+TEST(TemporalDelta, ShouldDropAllKeyframesWhenKeyframeGoesBack)
+{
+  constexpr auto n_bytes = 1024u;
+  delta::Encoder encoder(2, 10);
+  std::vector<char> compressed(delta::max_compressed_n_bytes(n_bytes, 2));
+  const auto image = random_image(n_bytes, 5);
+  for (auto id : {0u, 10u, 0u})
+    ASSERT_GT(encoder.compress(id, image.data(), n_bytes, compressed.data()), 0);
+
+  // keyframe 10 belongs to the previous acquisition
+  ASSERT_GT(encoder.compress(11, image.data(), n_bytes, compressed.data()), 0);
+  EXPECT_TRUE(delta::read_header(compressed.data()).is_keyframe());
+}
+
+TEST(TemporalDelta, ShouldRebaseResidualToKeyframe)
+{
+  constexpr auto n_bytes = 1024u;
+  delta::Encoder encoder(2, 10);
+  std::vector<char> keyframe(delta::max_compressed_n_bytes(n_bytes, 2));
+  std::vector<char> residual(keyframe.size());
+  std::vector<char> rebased(keyframe.size());
+  const auto image = random_image(n_bytes, 7);
+
+  ASSERT_GT(encoder.compress(20, random_image(n_bytes, 6).data(), n_bytes, keyframe.data()), 0);
+  ASSERT_GT(encoder.compress(21, image.data(), n_bytes, residual.data()), 0);
+  ASSERT_GT(delta::rebase_to_keyframe(residual.data(), keyframe.data(), 2, rebased.data()), 0);
+
+  const auto header = delta::read_header(rebased.data());
+  EXPECT_EQ(21u, header.image_id);
+  EXPECT_TRUE(header.is_keyframe());
+  std::vector<char> decoded(n_bytes);
+  EXPECT_EQ(n_bytes, delta::decompress(rebased.data(), 2, decoded.data(), nullptr));
+  EXPECT_EQ(image, decoded);
+
+  EXPECT_THROW(delta::rebase_to_keyframe(residual.data(), residual.data(), 2, rebased.data()),
+               std::invalid_argument);
+}
+
+TEST(TemporalDelta, ShouldRequireReferenceForResidualImages)
+{
+  constexpr auto n_bytes = 1024u;
+  delta::Encoder encoder(2, 10);
+  const auto image = random_image(n_bytes, 4);
+  std::vector<char> compressed(delta::max_compressed_n_bytes(n_bytes, 2));
+  std::vector<char> decoded(n_bytes);
+
+  ASSERT_GT(encoder.compress(0, image.data(), n_bytes, compressed.data()), 0);
+  ASSERT_GT(encoder.compress(1, image.data(), n_bytes, compressed.data()), 0);
+  EXPECT_THROW(delta::decompress(compressed.data(), 2, decoded.data(), nullptr),
+               std::invalid_argument);
+}
+
+TEST(TemporalDelta, ShouldEncodeConcurrently)
+{
+  constexpr auto n_bytes = 4096u;
+  constexpr auto n_images = 400u;
+  delta::Encoder encoder(2, 8);
+  std::vector<std::vector<char>> images;
+  for (auto id = 0u; id < n_images; id++)
+    images.push_back(random_image(n_bytes, id));
+
+  std::vector<std::vector<char>> compressed(
+      n_images, std::vector<char>(delta::max_compressed_n_bytes(n_bytes, 2)));
+  {
+    std::vector<std::jthread> workers;
+    for (auto w = 0u; w < 4; w++)
+      workers.emplace_back([&, w] {
+        for (auto id = w; id < n_images; id += 4)
+          ASSERT_GT(encoder.compress(id, images[id].data(), n_bytes, compressed[id].data()), 0);
+      });
+  }
+
+  std::vector<char> decoded(n_bytes);
+  for (auto id = 0u; id < n_images; id++) {
+    const auto header = delta::read_header(compressed[id].data());
+    const auto* reference = header.is_keyframe() ? nullptr : images[header.reference_id].data();
+    ASSERT_EQ(n_bytes, delta::decompress(compressed[id].data(), 2, decoded.data(), reference));
+    EXPECT_EQ(images[id], decoded);
+  }
+}
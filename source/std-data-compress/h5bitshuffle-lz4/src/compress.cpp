@@ -2,6 +2,9 @@
 // Copyright (c) 2023 Paul Scherrer Institute. All rights reserved.
 /////////////////////////////////////////////////////////////////////
 
+#include <cstring>
+#include <optional>
+
 #include <zmq.h>
 #include <omp.h>
 #include <fmt/core.h>
@@ -12,10 +15,26 @@
 #include "std_buffer/image_metadata.pb.h"
 #include "utils/utils.hpp"
 
+#include "compression_controller.hpp"
+#include "compression_pipeline.hpp"
+#include "quantiser.hpp"
+#include "temporal_delta.hpp"
+
 namespace {
 constexpr auto zmq_io_threads = 1;
-
-std::tuple<utils::DetectorConfig, int, int> read_arguments(int argc, char* argv[])
+constexpr std::size_t header_n_bytes = 12;
+// levels of the adaptive ladder - bitshuffle lz4 and storing images uncompressed
+constexpr std::size_t lz4_compression = 0;
+constexpr std::size_t no_compression = 1;
+
+std::tuple<utils::DetectorConfig,
+           int,
+           int,
+           std::size_t,
+           bool,
+           uint64_t,
+           std::optional<compress::Quantiser>>
+read_arguments(int argc, char* argv[])
 {
   auto program = utils::create_parser("std_data_compress_h5bitshuffle_lz4");
   program->add_argument("-t", "--threads")
@@ -36,32 +55,94 @@ std::tuple<utils::DetectorConfig, int, int> read_arguments(int argc, char* argv[
           return value;
       })
       .default_value(0);
+  program->add_argument("-p", "--pipeline")
+      .help("number of images compressed concurrently by single threaded workers, 0 compresses "
+            "one image at a time with all threads")
+      .scan<'u', std::size_t>()
+      .default_value(0ul);
+  program->add_argument("-a", "--adaptive")
+      .help("store images uncompressed while the pipeline falls behind")
+      .flag();
+  program->add_argument("-d", "--delta")
+      .help("compress images as residuals against keyframe taken every given number of images, "
+            "0 disables")
+      .scan<'u', uint64_t>()
+      .default_value(uint64_t{0});
+  program->add_argument("-q", "--quantisation")
+      .help("lossy quantisation of float32 images before compression: none, rounding or anscombe")
+      .default_value(std::string("none"));
+  program->add_argument("--quantisation_step")
+      .help("quantisation step in photons (rounding) or in Poisson standard deviations (anscombe)")
+      .scan<'g', float>()
+      .default_value(0.5f);
 
   program = utils::parse_arguments(std::move(program), argc, argv);
 
-  return {utils::read_config_from_json_file(program->get("detector_json_filename")),
-          program->get<int>("--threads"), program->get<int>("--block_size")};
+  auto config = utils::read_config_from_json_file(program->get("detector_json_filename"));
+  auto quantiser = compress::Quantiser::from_config(
+      program->get("--quantisation"), program->get<float>("--quantisation_step"), config);
+  return {std::move(config),
+          program->get<int>("--threads"),
+          program->get<int>("--block_size"),
+          program->get<std::size_t>("--pipeline"),
+          program->get<bool>("--adaptive"),
+          program->get<uint64_t>("--delta"),
+          std::move(quantiser)};
+}
+
+// output starts with hdf5 bitshuffle filter header - big endian image size and block size, returned
+// size includes the header
+int compress_image(const char* image,
+                   char* compressed,
+                   std::size_t image_n_bytes,
+                   std::size_t element_size,
+                   int block_size)
+{
+  const auto header_image_n_bytes = htobe64(static_cast<int64_t>(image_n_bytes));
+  const auto header_block_size = htobe32(static_cast<int32_t>(block_size));
+  std::memcpy(compressed + 0, &header_image_n_bytes, 8);
+  std::memcpy(compressed + 8, &header_block_size, 4);
+
+  const auto size = bshuf_compress_lz4(image, compressed + header_n_bytes,
+                                       image_n_bytes / element_size, element_size,
+                                       block_size / element_size);
+  return size > 0 ? static_cast<int>(size + header_n_bytes) : static_cast<int>(size);
 }
 
 } // namespace
 
 int main(int argc, char* argv[])
 {
-  const auto [config, threads, block_size] = read_arguments(argc, argv);
+  const auto [config, threads, block_size, pipeline_depth, adaptive, keyframe_interval,
+              quantiser] = read_arguments(argc, argv);
   [[maybe_unused]] utils::log::logger l{"std_data_compress_h5bitshuffle_lz4", config.log_level};
-  auto converted_bytes = utils::converted_image_n_bytes(config);
+  const auto converted_bytes = utils::converted_image_n_bytes(config);
   omp_set_num_threads(threads);
 
   auto ctx = zmq_ctx_new();
   zmq_ctx_set(ctx, ZMQ_IO_THREADS, zmq_io_threads);
 
   const auto source_name = fmt::format("{}-image", config.detector_name);
-  const auto sink_name = fmt::format("{}-h5bitshuffle-lz4", config.detector_name);
+  const auto sink_name = fmt::format("{}-{}h5bitshuffle-lz4", config.detector_name,
+                                     keyframe_interval > 0 ? "delta-" : "");
+
+  const auto element_size =
+      utils::get_bytes_from_metadata_dtype(utils::get_metadata_dtype(config));
+  // incompressible images grow - slots hold the worst case of the default bitshuffle block size,
+  // the same size std_det_writer opens the sink with
+  const auto slot_n_bytes = compress::delta::max_compressed_n_bytes(converted_bytes, element_size);
+  if (compress::delta::header_n_bytes +
+          bshuf_compress_lz4_bound(converted_bytes / element_size, element_size,
+                                   block_size / element_size) >
+      slot_n_bytes)
+    throw std::invalid_argument(
+        fmt::format("Block size {} is too small - compressed images may not fit the slots of {}",
+                    block_size, sink_name));
 
   auto receiver =
       cb::Communicator{{source_name, converted_bytes, utils::slots_number(config)},
                        {source_name, ctx, cb::CONN_TYPE_CONNECT, ZMQ_SUB}};
-  auto sender = cb::Communicator{{sink_name, converted_bytes, utils::slots_number(config)},
+  auto sender = cb::Communicator{{sink_name, slot_n_bytes, utils::slots_number(config)},
                                  {sink_name, ctx, cb::CONN_TYPE_BIND, ZMQ_PUB}};
 
   utils::stats::CompressionStatsCollector stats(config.detector_name,
@@ -69,43 +150,100 @@ int main(int argc, char* argv[])
   char buffer[512];
   std_daq_protocol::ImageMetadata meta;
 
-  const auto element_size = config.bit_depth / 8;
+  const auto is_pco = config.detector_type == "pco";
+
+  // pco images vary in size - the actual one is given in metadata
+  auto image_n_bytes = [&](const std_daq_protocol::ImageMetadata& image_meta) {
+    return is_pco ? image_meta.size() : converted_bytes;
+  };
+  std::optional<compress::delta::Encoder> delta_encoder;
+  if (keyframe_interval > 0) delta_encoder.emplace(element_size, keyframe_interval, block_size);
+  const auto compression = delta_encoder ? std_daq_protocol::delta_h5bitshuffle_lz4
+                                         : std_daq_protocol::h5bitshuffle_lz4;
+
+  // quantised copy is compressed - the image in the receiver buffer stays untouched
+  auto image_data = [&](const std_daq_protocol::ImageMetadata& image_meta) -> const char* {
+    const auto* data = receiver.get_data(image_meta.image_id());
+    return quantiser ? quantiser->quantise(data, image_n_bytes(image_meta)) : data;
+  };
+
+  auto compress_received = [&](const std_daq_protocol::ImageMetadata& image_meta) {
+    const auto id = image_meta.image_id();
+    if (delta_encoder)
+      return static_cast<int>(delta_encoder->compress(id, image_data(image_meta),
+                                                      image_n_bytes(image_meta),
+                                                      sender.get_data(id)));
+    return compress_image(image_data(image_meta), sender.get_data(id), image_n_bytes(image_meta),
+                          element_size, block_size);
+  };
+
+  auto send_compressed = [&](std_daq_protocol::ImageMetadata& image_meta,
+                             int size,
+                             std_daq_protocol::ImageMetadataCompression compression) {
+    if (size > 0) {
+      image_meta.set_size(size);
+      image_meta.set_compression(compression);
+      if (quantiser) quantiser->describe(image_meta);
+
+      std::string meta_buffer_send;
+      image_meta.SerializeToString(&meta_buffer_send);
+
+      sender.send(image_meta.image_id(), {meta_buffer_send.c_str(), meta_buffer_send.size()},
+                  nullptr);
+    }
+    stats.process(size);
+  };
+
+  if (pipeline_depth == 0) {
+    if (adaptive) throw std::invalid_argument("Adaptive compression needs pipeline mode");
+    while (true) {
+      if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
+        meta.ParseFromArray(buffer, n_bytes);
+        if (meta.status() == std_daq_protocol::good_image)
+          send_compressed(meta, compress_received(meta), compression);
+      }
+      stats.print_stats();
+    }
+  }
 
-  const size_t header_n_bytes = 12;
-  auto header_image_n_bytes = htobe64(static_cast<int64_t>(converted_bytes));
-  const auto header_block_size = htobe32(static_cast<int32_t>(block_size));
+  // every worker compresses its image on single thread - small images do not scale within one
+  const auto n_workers = std::min(static_cast<std::size_t>(threads), pipeline_depth);
+  std::optional<compress::CompressionController> controller;
+  if (adaptive)
+    controller.emplace(no_compression + 1, compress::CompressionController::pipeline_thresholds(
+                                               pipeline_depth, n_workers));
+
+  using job = compress::CompressionPipeline::job;
+  compress::CompressionPipeline pipeline(
+      n_workers, pipeline_depth,
+      [&](std::size_t, job& image) {
+        image.level = controller ? controller->level() : lz4_compression;
+        if (image.level == no_compression) {
+          const auto id = image.meta.image_id();
+          const auto n_bytes = image_n_bytes(image.meta);
+          std::memcpy(sender.get_data(id), image_data(image.meta), n_bytes);
+          return static_cast<int>(n_bytes);
+        }
+        // openmp team size is per calling thread
+        omp_set_num_threads(1);
+        return compress_received(image.meta);
+      },
+      [&](job& image) {
+        stats.process_timing(image.started - image.submitted, image.finished - image.started);
+        if (controller && image.compressed_size > 0)
+          controller->update(image.level, image.backlog,
+                             image.compressed_size /
+                                 static_cast<double>(image_n_bytes(image.meta)));
+        send_compressed(image.meta, image.compressed_size,
+                        image.level == no_compression ? std_daq_protocol::none : compression);
+        stats.print_stats();
+      });
 
   while (true) {
     if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
       meta.ParseFromArray(buffer, n_bytes);
-      if (meta.status() == std_daq_protocol::good_image) {
-        char* compression_buffer = sender.get_data(meta.image_id());
-
-        if (config.detector_type == "pco") {
-          converted_bytes = meta.size();
-          header_image_n_bytes = htobe64(static_cast<int64_t>(converted_bytes));
-        }
-        std::memcpy(compression_buffer + 0, &header_image_n_bytes, 8);
-        std::memcpy(compression_buffer + 8, &header_block_size, 4);
-
-        int size = bshuf_compress_lz4(receiver.get_data(meta.image_id()), compression_buffer + 12,
-                                      converted_bytes / element_size, element_size,
-                                      block_size / element_size);
-
-        if (size > 0) {
-          meta.set_size(size + header_n_bytes);
-          meta.set_compression(std_daq_protocol::h5bitshuffle_lz4);
-
-          std::string meta_buffer_send;
-          meta.SerializeToString(&meta_buffer_send);
-
-          sender.send(meta.image_id(), {meta_buffer_send.c_str(), meta_buffer_send.size()},
-                      nullptr);
-        }
-        stats.process(size);
-      }
+      if (meta.status() == std_daq_protocol::good_image) pipeline.submit(meta);
     }
-    stats.print_stats();
   }
   return 0;
 }
@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "utils/detector_config.hpp"
+#include "std_buffer/image_metadata.pb.h"
+
+struct blosc2_context_s;
+
+namespace convert {
+
+struct chunk_geometry
+{
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+};
+
+// Compresses the rectangle of the converted image covered by single module. Chunks are produced
+// by the thread that converted the module - while its output is still in the cache. Any number
+// of threads can compress concurrently - each borrows its own codec context of this instance.
+class ModuleChunkCompressor
+{
+public:
+  enum class codec
+  {
+    h5bitshuffle_lz4,
+    blosc2
+  };
+
+  ModuleChunkCompressor(const utils::DetectorConfig& config, codec c, int level = 5);
+
+  static codec to_codec(std::string_view name);
+  [[nodiscard]] std::string_view sink_suffix() const;
+  [[nodiscard]] std_daq_protocol::ImageMetadataCompression compression() const;
+
+  [[nodiscard]] const chunk_geometry& geometry(int module_id) const;
+  [[nodiscard]] std::size_t max_chunk_n_bytes() const;
+
+  // returns number of compressed bytes written to output or 0 if compression failed
+  std::size_t compress(int module_id, const char* image, char* output) const;
+
+private:
+  struct blosc2_context_deleter
+  {
+    void operator()(blosc2_context_s* ctx) const;
+  };
+  using blosc2_context_ptr = std::unique_ptr<blosc2_context_s, blosc2_context_deleter>;
+
+  static std::vector<chunk_geometry> calculate_geometries(const utils::DetectorConfig& config);
+  std::size_t compress_h5bitshuffle_lz4(const char* data, std::size_t n_bytes, char* output) const;
+  std::size_t compress_blosc2(const char* data, std::size_t n_bytes, char* output) const;
+  [[nodiscard]] blosc2_context_ptr acquire_blosc2_context() const;
+  void release_blosc2_context(blosc2_context_ptr ctx) const;
+
+  const codec codec_type;
+  const int level;
+  const std::size_t image_width;
+  const std::size_t element_size;
+  const std::vector<chunk_geometry> geometries;
+  std::size_t max_chunk_bytes;
+  // blosc2 contexts cannot be shared between threads - idle ones are reused by the next caller
+  mutable std::mutex blosc2_contexts_mutex;
+  mutable std::vector<blosc2_context_ptr> idle_blosc2_contexts;
+};
+
+} // namespace convert
@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "utils/detector_config.hpp"
+
+namespace convert {
+
+// Placement of module pixels in the assembled image derived from module_positions. Start point
+// is where the first module pixel lands and end point where the last one does - reversed
+// coordinates flip the axis and extents swapped with respect to the module size mean the module
+// is rotated by 90 or 270 degrees. With binning the positions describe the binned rectangle.
+//
+// Placement is precomputed as list of tiles of the output rectangle, every tile covers small
+// square of the module so that strided reads of rotated modules stay within the cache.
+class ModuleGeometry
+{
+public:
+  ModuleGeometry(const utils::DetectorConfig& config,
+                 int module_id,
+                 std::size_t module_width,
+                 std::size_t module_height);
+
+  // module rows land unchanged on consecutive image rows - plain row copies are enough
+  [[nodiscard]] bool is_row_aligned() const;
+  [[nodiscard]] std::size_t output_start() const;
+  [[nodiscard]] int binning_factor() const;
+
+  template <typename Dst, typename Src, typename Store>
+  void place(const Src* module, Dst* image, Store store) const
+  {
+    for (const auto& t : tiles) {
+      for (auto y = 0u; y < t.height; y++) {
+        const Src* src = module + t.src + y * src_y_step * binning;
+        Dst* dst = image + t.dst + y * image_width;
+        if (binning == 1)
+          for (auto x = 0u; x < t.width; x++)
+            dst[x] = store(src[x * src_x_step]);
+        else
+          for (auto x = 0u; x < t.width; x++)
+            dst[x] = store(sum_bin(src + x * src_x_step * binning));
+      }
+    }
+  }
+
+private:
+  struct tile
+  {
+    std::ptrdiff_t src;
+    std::size_t dst;
+    uint32_t width;
+    uint32_t height;
+  };
+  static constexpr std::size_t tile_size = 32;
+
+  template <typename Src> auto sum_bin(const Src* src) const
+  {
+    std::conditional_t<std::is_floating_point_v<Src>, Src, uint32_t> sum = 0;
+    for (auto j = 0; j < binning; j++)
+      for (auto i = 0; i < binning; i++)
+        sum += src[j * src_y_step + i * src_x_step];
+    return sum;
+  }
+
+  const std::size_t image_width;
+  const int binning;
+  // distance in module pixels between neighbouring output pixels along image x and y axes
+  std::ptrdiff_t src_x_step;
+  std::ptrdiff_t src_y_step;
+  std::size_t start;
+  bool row_aligned;
+  std::vector<tile> tiles;
+};
+
+} // namespace convert
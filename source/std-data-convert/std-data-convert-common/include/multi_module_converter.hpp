@@ -0,0 +1,247 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <zmq.h>
+#include <fmt/core.h>
+
+#include "core_buffer/buffer_config.hpp"
+#include "core_buffer/buffer_utils.hpp"
+#include "core_buffer/ram_buffer.hpp"
+#include "utils/utils.hpp"
+
+#include "image_metadata.hpp"
+#include "module_chunk_compressor.hpp"
+#include "synchronizer.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace convert {
+
+inline std::vector<uint16_t> get_active_modules(const utils::DetectorConfig& config)
+{
+  const auto mask = utils::get_modules_mask(config);
+  std::vector<uint16_t> modules;
+  for (auto i = 0; i < config.n_modules; i++)
+    if (mask.none() || mask.test(i)) modules.push_back(static_cast<uint16_t>(i));
+  return modules;
+}
+
+// Converts all modules of the detector in single process. Module frames are converted by the
+// pool directly into the assembled image and one image metadata per complete image is published
+// on {detector_name}-image - the same stream std_data_sync_module provides for single module
+// converters, which makes the module synchronizer unnecessary in this mode.
+//
+// With compression enabled every module is also compressed by the thread that converted it into
+// chunk at fixed offset of {detector_name}-{codec} buffer. Complete images are published on the
+// same stream std_data_compress would use, with the chunk index in the metadata.
+template <typename FrameType> class MultiModuleConverter
+{
+  struct module_frame
+  {
+    FrameType meta;
+    char* data;
+  };
+
+  struct module_source
+  {
+    uint16_t module_id;
+    std::unique_ptr<RamBuffer> buffer;
+    void* socket;
+  };
+
+  struct compressed_output
+  {
+    std::unique_ptr<const ModuleChunkCompressor> compressor;
+    std::vector<uint16_t> modules;
+    RamBuffer buffer;
+    void* socket;
+    std::vector<std::size_t> chunk_sizes;
+    std_daq_protocol::ImageMetadata meta;
+  };
+
+public:
+  using convert_function = std::function<void(const FrameType& meta, char* input, char* output)>;
+
+  MultiModuleConverter(const utils::DetectorConfig& config,
+                       void* ctx,
+                       const std::vector<uint16_t>& modules,
+                       std::size_t module_n_bytes,
+                       std::size_t n_workers,
+                       convert_function convert)
+      : convert(std::move(convert))
+      , image_buffer(fmt::format("{}-image", config.detector_name),
+                     utils::converted_image_n_bytes(config),
+                     utils::slots_number(config))
+      , image_socket(buffer_utils::bind_socket(ctx, config.detector_name + "-image", ZMQ_PUB))
+      , syncer(config.n_modules,
+               config.module_sync_queue_size,
+               utils::get_modules_mask(config),
+               config.module_sync_timeout)
+      , stats(config.detector_name, config.stats_collection_period, config.n_modules)
+      , image_meta(create_image_metadata(config))
+      , n_modules(config.n_modules)
+      , n_slots(utils::slots_number(config))
+      , pool(n_workers, [this](const module_frame& frame) { process(frame); })
+  {
+    for (const auto module_id : modules) {
+      const auto source_name = fmt::format("{}-{}", config.detector_name, module_id);
+      sources.push_back({module_id,
+                         std::make_unique<RamBuffer>(source_name, module_n_bytes,
+                                                     buffer_config::RECEIVER_RAM_BUFFER_N_SLOTS),
+                         buffer_utils::connect_socket_ipc(ctx, source_name, ZMQ_SUB)});
+      poll_items.push_back({sources.back().socket, 0, ZMQ_POLLIN, 0});
+    }
+  }
+
+  // must be called before run() - chunks are written by the conversion threads
+  void enable_compression(const utils::DetectorConfig& config,
+                          void* ctx,
+                          std::unique_ptr<const ModuleChunkCompressor> compressor)
+  {
+    const auto sink_name = fmt::format("{}-{}", config.detector_name, compressor->sink_suffix());
+    auto modules = get_active_modules(config);
+    const auto slot_n_bytes = n_modules * compressor->max_chunk_n_bytes();
+    compressed.reset(new compressed_output{
+        std::move(compressor), std::move(modules), RamBuffer(sink_name, slot_n_bytes, n_slots),
+        buffer_utils::bind_socket(ctx, sink_name, ZMQ_PUB),
+        std::vector<std::size_t>(n_slots * n_modules), {}});
+  }
+
+  [[noreturn]] void run()
+  {
+    while (true) {
+      if (zmq_poll(poll_items.data(), static_cast<int>(poll_items.size()), poll_timeout_ms()) > 0)
+        for (auto i = 0u; i < poll_items.size(); i++)
+          if (poll_items[i].revents & ZMQ_POLLIN) receive_frames(sources[i]);
+      // incomplete images are released by deadline also when no module frame arrives
+      if (syncer.time_to_deadline()) {
+        std::lock_guard<std::mutex> lock(publish_mutex);
+        publish_ready_images();
+      }
+    }
+  }
+
+private:
+  // drains all frames already queued on the socket so that one poll wakeup serves a burst
+  void receive_frames(module_source& source)
+  {
+    module_frame frame{};
+    while (zmq_recv(source.socket, &frame.meta, sizeof(frame.meta), ZMQ_DONTWAIT) > 0) {
+      frame.data = source.buffer->get_data(frame.meta.common.image_id);
+      pool.submit(frame, source.module_id);
+    }
+  }
+
+  void process(const module_frame& frame)
+  {
+    const auto image_id = frame.meta.common.image_id;
+    char* image = image_buffer.get_data(image_id);
+    convert(frame.meta, frame.data, image);
+    if (compressed) compress_module(image_id, frame.meta.common.module_id % n_modules, image);
+
+    std::optional<typename Synchronizer<FrameType>::module_arrival> arrival;
+    const auto n_corrupted = syncer.process_image_metadata(frame.meta, arrival);
+    n_processed_frames.fetch_add(1, std::memory_order_relaxed);
+    if (n_corrupted > 0) n_corrupted_images.fetch_add(n_corrupted, std::memory_order_relaxed);
+    if (arrival) stats.process_arrival(arrival->module_id, arrival->offset, arrival->last);
+
+    // only a completed image or dropped ones can make the oldest image ready - partial images
+    // are released by the deadline in run()
+    if ((arrival && arrival->last) || n_corrupted > 0) {
+      std::lock_guard<std::mutex> lock(publish_mutex);
+      publish_ready_images();
+    }
+  }
+
+  int poll_timeout_ms() const
+  {
+    const auto timeout = syncer.time_to_deadline();
+    if (!timeout) return 1000;
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(*timeout).count());
+  }
+
+  // caller holds publish_mutex
+  void publish_ready_images()
+  {
+    while (auto image = syncer.pop_next_image()) {
+      fill_image_metadata(image->frame, image->missing, image_meta);
+      image_meta.SerializeToString(&meta_buffer_send);
+      zmq_send(image_socket, meta_buffer_send.c_str(), meta_buffer_send.size(), 0);
+      if (compressed && image_meta.status() == std_daq_protocol::good_image)
+        publish_compressed_image();
+    }
+    stats.process(n_processed_frames.exchange(0, std::memory_order_relaxed),
+                  n_corrupted_images.exchange(0, std::memory_order_relaxed));
+    const auto counters = syncer.take_counters();
+    stats.process_deadline(counters.partial_images, counters.late_modules,
+                           counters.duplicated_modules);
+    stats.print_stats();
+  }
+
+  void compress_module(uint64_t image_id, std::size_t module_id, const char* image)
+  {
+    const auto chunk_n_bytes = compressed->compressor->max_chunk_n_bytes();
+    char* chunk = compressed->buffer.get_data(image_id) + module_id * chunk_n_bytes;
+    compressed->chunk_sizes[(image_id % n_slots) * n_modules + module_id] =
+        compressed->compressor->compress(static_cast<int>(module_id), image, chunk);
+  }
+
+  // chunk sizes written by other workers are visible - module completion in the syncer is acq_rel
+  void publish_compressed_image()
+  {
+    auto& meta = compressed->meta;
+    meta.CopyFrom(image_meta);
+    meta.set_compression(compressed->compressor->compression());
+
+    const auto chunk_n_bytes = compressed->compressor->max_chunk_n_bytes();
+    const auto* sizes = &compressed->chunk_sizes[(image_meta.image_id() % n_slots) * n_modules];
+    for (const auto module_id : compressed->modules) {
+      if (sizes[module_id] == 0) return;
+      const auto& g = compressed->compressor->geometry(module_id);
+      auto* chunk = meta.add_chunks();
+      chunk->set_module_id(module_id);
+      chunk->set_offset(module_id * chunk_n_bytes);
+      chunk->set_size(sizes[module_id]);
+      chunk->set_x(g.x);
+      chunk->set_y(g.y);
+      chunk->set_width(g.width);
+      chunk->set_height(g.height);
+      meta.set_size(chunk->offset() + chunk->size());
+    }
+    meta.SerializeToString(&meta_buffer_send);
+    zmq_send(compressed->socket, meta_buffer_send.c_str(), meta_buffer_send.size(), 0);
+  }
+
+  convert_function convert;
+  RamBuffer image_buffer;
+  void* image_socket;
+  Synchronizer<FrameType> syncer;
+  std::vector<module_source> sources;
+  std::vector<zmq_pollitem_t> poll_items;
+
+  std::mutex publish_mutex;
+  // per frame counters are collected by the workers without the lock and drained on publishing
+  std::atomic<std::size_t> n_processed_frames{0};
+  std::atomic<std::size_t> n_corrupted_images{0};
+  utils::stats::SyncStatsCollector stats;
+  std_daq_protocol::ImageMetadata image_meta;
+  std::string meta_buffer_send;
+  const std::size_t n_modules;
+  const std::size_t n_slots;
+  std::unique_ptr<compressed_output> compressed;
+
+  WorkStealingPool<module_frame> pool;
+};
+
+} // namespace convert
@@ -0,0 +1,100 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace convert {
+
+// Every worker owns a queue and takes tasks from its front - when it runs dry it steals from the
+// back of the other queues. Tasks submitted with the same hint land on the same worker, which
+// keeps per module calibration data in its cache while still balancing uneven load.
+template <typename Task> class WorkStealingPool
+{
+  struct worker_queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+public:
+  using handler = std::function<void(const Task&)>;
+
+  WorkStealingPool(std::size_t n_workers, handler h)
+      : process(std::move(h))
+      , queues(n_workers)
+  {
+    workers.reserve(n_workers);
+    for (auto i = 0u; i < n_workers; i++)
+      workers.emplace_back([this, i](std::stop_token stop) { run(i, stop); });
+  }
+
+  ~WorkStealingPool()
+  {
+    for (auto& worker : workers)
+      worker.request_stop();
+  }
+
+  void submit(Task task, std::size_t hint)
+  {
+    auto& queue = queues[hint % queues.size()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    n_pending.release();
+  }
+
+private:
+  void run(std::size_t id, std::stop_token stop)
+  {
+    using namespace std::chrono_literals;
+    while (!stop.stop_requested()) {
+      // acquired token guarantees that one of the queues holds a task not claimed by others
+      if (!n_pending.try_acquire_for(100ms)) continue;
+
+      Task task;
+      while (!take_own(id, task) && !steal(id, task)) {}
+      process(task);
+    }
+  }
+
+  bool take_own(std::size_t id, Task& task)
+  {
+    auto& queue = queues[id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    return true;
+  }
+
+  bool steal(std::size_t id, Task& task)
+  {
+    for (auto i = 1u; i < queues.size(); i++) {
+      auto& queue = queues[(id + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  handler process;
+  std::vector<worker_queue> queues;
+  std::counting_semaphore<> n_pending{0};
+  std::vector<std::jthread> workers;
+};
+
+} // namespace convert
@@ -0,0 +1,189 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "module_chunk_compressor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <endian.h>
+#include <omp.h>
+#include <blosc2.h>
+#include <fmt/core.h>
+#include <bitshuffle/bitshuffle.h>
+
+#include "utils/get_metadata_dtype.hpp"
+
+namespace convert {
+namespace {
+
+// same layout as the header of HDF5 bitshuffle filter - chunk can be stored in file as it is
+constexpr std::size_t h5bitshuffle_header_n_bytes = 12;
+
+std::size_t pixel_n_bytes(const utils::DetectorConfig& config)
+{
+  return utils::get_bytes_from_metadata_dtype(utils::get_metadata_dtype(config));
+}
+
+// chunk rows have to be contiguous for the codecs - gathered to per thread scratch buffer
+const char* gather_rows(const chunk_geometry& g,
+                        const char* image,
+                        std::size_t image_width,
+                        std::size_t element_size)
+{
+  thread_local std::vector<char> scratch;
+  const auto row_n_bytes = g.width * element_size;
+  scratch.resize(row_n_bytes * g.height);
+  for (auto row = 0u; row < g.height; row++)
+    std::memcpy(scratch.data() + row * row_n_bytes,
+                image + ((g.y + row) * image_width + g.x) * element_size, row_n_bytes);
+  return scratch.data();
+}
+
+} // namespace
+
+ModuleChunkCompressor::ModuleChunkCompressor(const utils::DetectorConfig& config,
+                                             codec c,
+                                             int level)
+    : codec_type(c)
+    , level(level)
+    , image_width(config.image_pixel_width)
+    , element_size(pixel_n_bytes(config))
+    , geometries(calculate_geometries(config))
+    , max_chunk_bytes(0)
+{
+  for (const auto& g : geometries) {
+    const auto n_elements = static_cast<std::size_t>(g.width) * g.height;
+    const auto bound =
+        codec_type == codec::blosc2
+            ? n_elements * element_size + BLOSC2_MAX_OVERHEAD
+            : h5bitshuffle_header_n_bytes + bshuf_compress_lz4_bound(n_elements, element_size, 0);
+    max_chunk_bytes = std::max(max_chunk_bytes, bound);
+  }
+}
+
+ModuleChunkCompressor::codec ModuleChunkCompressor::to_codec(std::string_view name)
+{
+  if (name == "h5bitshuffle-lz4") return codec::h5bitshuffle_lz4;
+  if (name == "blosc2") return codec::blosc2;
+  throw std::invalid_argument(fmt::format("Unsupported compression: {}", name));
+}
+
+std::string_view ModuleChunkCompressor::sink_suffix() const
+{
+  return codec_type == codec::blosc2 ? "blosc2" : "h5bitshuffle-lz4";
+}
+
+std_daq_protocol::ImageMetadataCompression ModuleChunkCompressor::compression() const
+{
+  return codec_type == codec::blosc2 ? std_daq_protocol::blosc2
+                                     : std_daq_protocol::h5bitshuffle_lz4;
+}
+
+const chunk_geometry& ModuleChunkCompressor::geometry(int module_id) const
+{
+  return geometries[module_id % geometries.size()];
+}
+
+std::size_t ModuleChunkCompressor::max_chunk_n_bytes() const
+{
+  return max_chunk_bytes;
+}
+
+std::size_t ModuleChunkCompressor::compress(int module_id, const char* image, char* output) const
+{
+  const auto& g = geometry(module_id);
+  const auto* data = gather_rows(g, image, image_width, element_size);
+  const auto n_bytes = static_cast<std::size_t>(g.width) * g.height * element_size;
+
+  if (codec_type == codec::blosc2) return compress_blosc2(data, n_bytes, output);
+  return compress_h5bitshuffle_lz4(data, n_bytes, output);
+}
+
+std::size_t ModuleChunkCompressor::compress_h5bitshuffle_lz4(const char* data,
+                                                             std::size_t n_bytes,
+                                                             char* output) const
+{
+  // modules are already compressed in parallel - nested OpenMP teams would only oversubscribe
+  thread_local bool omp_configured = false;
+  if (!omp_configured) {
+    omp_set_num_threads(1);
+    omp_configured = true;
+  }
+
+  const auto header_n_bytes = htobe64(static_cast<uint64_t>(n_bytes));
+  const auto header_block_size = htobe32(0u);
+  std::memcpy(output, &header_n_bytes, 8);
+  std::memcpy(output + 8, &header_block_size, 4);
+
+  const auto size = bshuf_compress_lz4(data, output + h5bitshuffle_header_n_bytes,
+                                       n_bytes / element_size, element_size, 0);
+  return size > 0 ? size + h5bitshuffle_header_n_bytes : 0;
+}
+
+std::size_t ModuleChunkCompressor::compress_blosc2(const char* data,
+                                                   std::size_t n_bytes,
+                                                   char* output) const
+{
+  auto ctx = acquire_blosc2_context();
+  if (!ctx) return 0;
+  const auto size =
+      blosc2_compress_ctx(ctx.get(), data, static_cast<int32_t>(n_bytes), output,
+                          static_cast<int32_t>(max_chunk_bytes));
+  release_blosc2_context(std::move(ctx));
+  return size > 0 ? size : 0;
+}
+
+ModuleChunkCompressor::blosc2_context_ptr ModuleChunkCompressor::acquire_blosc2_context() const
+{
+  {
+    std::lock_guard<std::mutex> lock(blosc2_contexts_mutex);
+    if (!idle_blosc2_contexts.empty()) {
+      auto ctx = std::move(idle_blosc2_contexts.back());
+      idle_blosc2_contexts.pop_back();
+      return ctx;
+    }
+  }
+  blosc2_cparams params = BLOSC2_CPARAMS_DEFAULTS;
+  params.nthreads = 1;
+  params.typesize = static_cast<int32_t>(element_size);
+  params.compcode = BLOSC_LZ4;
+  params.clevel = static_cast<uint8_t>(level);
+  params.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_BITSHUFFLE;
+  return blosc2_context_ptr(blosc2_create_cctx(params));
+}
+
+void ModuleChunkCompressor::release_blosc2_context(blosc2_context_ptr ctx) const
+{
+  std::lock_guard<std::mutex> lock(blosc2_contexts_mutex);
+  idle_blosc2_contexts.push_back(std::move(ctx));
+}
+
+void ModuleChunkCompressor::blosc2_context_deleter::operator()(blosc2_context_s* ctx) const
+{
+  blosc2_free_ctx(ctx);
+}
+
+std::vector<chunk_geometry> ModuleChunkCompressor::calculate_geometries(
+    const utils::DetectorConfig& config)
+{
+  if (config.modules.empty())
+    throw std::invalid_argument(
+        "Per module compression requires module_positions in detector configuration!");
+
+  std::vector<chunk_geometry> result(config.n_modules);
+  for (const auto& [module_id, positions] : config.modules) {
+    const auto& [start, end] = positions;
+    result[module_id % config.n_modules] = {
+        static_cast<uint32_t>(std::min(start.x, end.x)),
+        static_cast<uint32_t>(std::min(start.y, end.y)),
+        static_cast<uint32_t>(std::abs(end.x - start.x) + 1),
+        static_cast<uint32_t>(std::abs(end.y - start.y) + 1)};
+  }
+  return result;
+}
+
+} // namespace convert
@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "module_geometry.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+namespace convert {
+
+ModuleGeometry::ModuleGeometry(const utils::DetectorConfig& config,
+                               int module_id,
+                               std::size_t module_width,
+                               std::size_t module_height)
+    : image_width(config.image_pixel_width)
+    , binning(config.binning)
+{
+  const auto first = utils::get_module_start_position(config, module_id);
+  const auto last = utils::get_module_end_position(config, module_id);
+  const auto x0 = std::min(first.x, last.x);
+  const auto y0 = std::min(first.y, last.y);
+  const auto out_width = static_cast<std::size_t>(std::abs(last.x - first.x) + 1);
+  const auto out_height = static_cast<std::size_t>(std::abs(last.y - first.y) + 1);
+
+  const auto w = static_cast<std::ptrdiff_t>(module_width);
+  const auto h = static_cast<std::ptrdiff_t>(module_height);
+  const auto flip_x = last.x < first.x;
+  const auto flip_y = last.y < first.y;
+  std::ptrdiff_t origin = 0;
+
+  if (out_width * binning == module_width && out_height * binning == module_height) {
+    src_x_step = flip_x ? -1 : 1;
+    src_y_step = flip_y ? -w : w;
+    origin = (flip_x ? w - 1 : 0) + (flip_y ? (h - 1) * w : 0);
+  }
+  else if (out_width * binning == module_height && out_height * binning == module_width) {
+    // rotated module - image x axis follows module rows and image y axis module columns
+    src_x_step = flip_x ? -w : w;
+    src_y_step = flip_y ? -1 : 1;
+    origin = (flip_x ? (h - 1) * w : 0) + (flip_y ? w - 1 : 0);
+  }
+  else
+    throw std::runtime_error(fmt::format(
+        "Module {} placement {}x{} does not fit module of size {}x{} with binning {}!", module_id,
+        out_width, out_height, module_width, module_height, binning));
+
+  start = y0 * image_width + x0;
+  row_aligned = binning == 1 && src_x_step == 1 && src_y_step == w;
+
+  for (auto ty = 0u; ty < out_height; ty += tile_size)
+    for (auto tx = 0u; tx < out_width; tx += tile_size)
+      tiles.push_back({origin + static_cast<std::ptrdiff_t>(tx * binning) * src_x_step +
+                           static_cast<std::ptrdiff_t>(ty * binning) * src_y_step,
+                       start + ty * image_width + tx,
+                       static_cast<uint32_t>(std::min(tile_size, out_width - tx)),
+                       static_cast<uint32_t>(std::min(tile_size, out_height - ty))});
+}
+
+bool ModuleGeometry::is_row_aligned() const
+{
+  return row_aligned;
+}
+
+std::size_t ModuleGeometry::output_start() const
+{
+  return start;
+}
+
+int ModuleGeometry::binning_factor() const
+{
+  return binning;
+}
+
+} // namespace convert
@@ -0,0 +1,147 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "module_chunk_compressor.hpp"
+
+#include <numeric>
+#include <thread>
+
+#include <blosc2.h>
+#include <gtest/gtest.h>
+#include <bitshuffle/bitshuffle.h>
+
+using namespace convert;
+
+namespace {
+constexpr auto image_width = 1024;
+constexpr auto image_height = 1024;
+
+utils::DetectorConfig create_config()
+{
+  return {"JF",
+          "jungfrau-raw",
+          2,
+          16,
+          image_height,
+          image_width,
+          0,
+          "debug",
+          std::chrono::seconds(30),
+          8,
+          false,
+          16777216,
+          false,
+          50,
+          0,
+          1000,
+          std::chrono::seconds(30),
+          false,
+          {},
+          {{0, {{0, 0}, {1023, 511}}}, {1, {{1023, 1023}, {0, 512}}}}};
+}
+
+std::vector<uint16_t> create_image()
+{
+  std::vector<uint16_t> image(image_width * image_height);
+  for (auto i = 0u; i < image.size(); i++)
+    image[i] = static_cast<uint16_t>((i * 7) % 1000);
+  return image;
+}
+
+std::vector<uint16_t> decompress_blosc2(const std::vector<char>& chunk, std::size_t size)
+{
+  std::vector<uint16_t> decompressed(512 * image_width);
+  blosc2_dparams params = BLOSC2_DPARAMS_DEFAULTS;
+  auto* ctx = blosc2_create_dctx(params);
+  const auto n_bytes = static_cast<int32_t>(decompressed.size() * sizeof(uint16_t));
+  EXPECT_EQ(n_bytes, blosc2_decompress_ctx(ctx, chunk.data(), static_cast<int32_t>(size),
+                                           decompressed.data(), n_bytes));
+  blosc2_free_ctx(ctx);
+  return decompressed;
+}
+
+std::vector<uint16_t> module_rows(const std::vector<uint16_t>& image, std::size_t first_row)
+{
+  return {image.begin() + first_row * image_width,
+          image.begin() + (first_row + 512) * image_width};
+}
+} // namespace
+
+TEST(ModuleChunkCompressor, ShouldCalculateChunkGeometryOfRotatedModule)
+{
+  ModuleChunkCompressor compressor(create_config(), ModuleChunkCompressor::codec::blosc2);
+
+  const auto& g = compressor.geometry(1);
+  EXPECT_EQ(0u, g.x);
+  EXPECT_EQ(512u, g.y);
+  EXPECT_EQ(1024u, g.width);
+  EXPECT_EQ(512u, g.height);
+}
+
+TEST(ModuleChunkCompressor, ShouldCompressModuleIntoBitshuffleChunk)
+{
+  ModuleChunkCompressor compressor(create_config(), ModuleChunkCompressor::codec::h5bitshuffle_lz4);
+  const auto image = create_image();
+  std::vector<char> chunk(compressor.max_chunk_n_bytes());
+
+  const auto size = compressor.compress(1, (const char*)image.data(), chunk.data());
+  ASSERT_GT(size, 12u);
+  EXPECT_LT(size, 512u * image_width * sizeof(uint16_t));
+
+  std::vector<uint16_t> decompressed(512 * image_width);
+  EXPECT_EQ(static_cast<int64_t>(size - 12),
+            bshuf_decompress_lz4(chunk.data() + 12, decompressed.data(), decompressed.size(),
+                                 sizeof(uint16_t), 0));
+  EXPECT_EQ(module_rows(image, 512), decompressed);
+}
+
+TEST(ModuleChunkCompressor, ShouldCompressModuleIntoBlosc2Chunk)
+{
+  ModuleChunkCompressor compressor(create_config(), ModuleChunkCompressor::codec::blosc2);
+  const auto image = create_image();
+  std::vector<char> chunk(compressor.max_chunk_n_bytes());
+
+  const auto size = compressor.compress(0, (const char*)image.data(), chunk.data());
+  ASSERT_GT(size, 0u);
+  EXPECT_EQ(module_rows(image, 0), decompress_blosc2(chunk, size));
+}
+
+TEST(ModuleChunkCompressor, ShouldKeepCompressionLevelOfEachInstance)
+{
+  ModuleChunkCompressor compressed(create_config(), ModuleChunkCompressor::codec::blosc2, 5);
+  ModuleChunkCompressor stored(create_config(), ModuleChunkCompressor::codec::blosc2, 0);
+  const auto image = create_image();
+  std::vector<char> chunk(compressed.max_chunk_n_bytes());
+  const auto module_n_bytes = 512u * image_width * sizeof(uint16_t);
+
+  // both instances are used by the same thread - the second must not inherit the first context
+  ASSERT_LT(compressed.compress(0, (const char*)image.data(), chunk.data()), module_n_bytes);
+  const auto size = stored.compress(0, (const char*)image.data(), chunk.data());
+  EXPECT_GE(size, module_n_bytes);
+  EXPECT_EQ(module_rows(image, 0), decompress_blosc2(chunk, size));
+}
+
+TEST(ModuleChunkCompressor, ShouldCompressConcurrentlyFromManyThreads)
+{
+  ModuleChunkCompressor compressor(create_config(), ModuleChunkCompressor::codec::blosc2);
+  const auto image = create_image();
+
+  std::vector<std::vector<char>> chunks(8, std::vector<char>(compressor.max_chunk_n_bytes()));
+  std::vector<std::size_t> sizes(chunks.size());
+  {
+    std::vector<std::jthread> threads;
+    for (auto i = 0u; i < chunks.size(); i++)
+      threads.emplace_back([&, i] {
+        for (auto n = 0; n < 10; n++)
+          sizes[i] = compressor.compress(i % 2, (const char*)image.data(), chunks[i].data());
+      });
+  }
+  for (auto i = 0u; i < chunks.size(); i++)
+    EXPECT_EQ(module_rows(image, i % 2 ? 512 : 0), decompress_blosc2(chunks[i], sizes[i]));
+}
+
+TEST(ModuleChunkCompressor, ShouldThrowForUnknownCodec)
+{
+  EXPECT_THROW(ModuleChunkCompressor::to_codec("zstd"), std::invalid_argument);
+}
@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "module_geometry.hpp"
+
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+using namespace convert;
+
+namespace {
+constexpr std::size_t module_width = 4;
+constexpr std::size_t module_height = 2;
+constexpr int image_side = 4;
+
+utils::DetectorConfig create_config(utils::Point start, utils::Point end, int binning = 1)
+{
+  return {"JF",
+          "jungfrau-converted",
+          1,
+          16,
+          image_side,
+          image_side,
+          0,
+          "debug",
+          std::chrono::seconds(30),
+          8,
+          false,
+          16777216,
+          false,
+          50,
+          0,
+          1000,
+          std::chrono::seconds(30),
+          false,
+          {},
+          {{0, {start, end}}},
+          {},
+          utils::gap_pixels_mode::keep,
+          binning};
+}
+
+// module pixels numbered 1..8 row by row:
+//   1 2 3 4
+//   5 6 7 8
+std::vector<uint16_t> place(const utils::DetectorConfig& config,
+                            std::size_t width = module_width,
+                            std::size_t height = module_height)
+{
+  std::vector<uint16_t> module(width * height);
+  std::iota(module.begin(), module.end(), 1);
+  std::vector<uint16_t> image(image_side * image_side, 0);
+  ModuleGeometry(config, 0, width, height)
+      .place(module.data(), image.data(), [](auto v) { return static_cast<uint16_t>(v); });
+  return image;
+}
+} // namespace
+
+TEST(ModuleGeometry, ShouldCopyRowsForAlignedModule)
+{
+  const auto config = create_config({0, 1}, {3, 2});
+  EXPECT_TRUE(ModuleGeometry(config, 0, module_width, module_height).is_row_aligned());
+  EXPECT_EQ(4u, ModuleGeometry(config, 0, module_width, module_height).output_start());
+  EXPECT_EQ((std::vector<uint16_t>{0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 0, 0, 0}),
+            place(config));
+}
+
+TEST(ModuleGeometry, ShouldRotateModuleBy180Degrees)
+{
+  const auto config = create_config({3, 1}, {0, 0});
+  EXPECT_FALSE(ModuleGeometry(config, 0, module_width, module_height).is_row_aligned());
+  EXPECT_EQ((std::vector<uint16_t>{8, 7, 6, 5, 4, 3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0}),
+            place(config));
+}
+
+TEST(ModuleGeometry, ShouldFlipModuleVertically)
+{
+  EXPECT_EQ((std::vector<uint16_t>{5, 6, 7, 8, 1, 2, 3, 4, 0, 0, 0, 0, 0, 0, 0, 0}),
+            place(create_config({0, 1}, {3, 0})));
+}
+
+TEST(ModuleGeometry, ShouldRotateModuleBy90DegreesClockwise)
+{
+  // first pixel lands in top right corner, last one in bottom left
+  EXPECT_EQ((std::vector<uint16_t>{5, 1, 0, 0, 6, 2, 0, 0, 7, 3, 0, 0, 8, 4, 0, 0}),
+            place(create_config({1, 0}, {0, 3})));
+}
+
+TEST(ModuleGeometry, ShouldRotateModuleBy270DegreesClockwise)
+{
+  EXPECT_EQ((std::vector<uint16_t>{0, 0, 4, 8, 0, 0, 3, 7, 0, 0, 2, 6, 0, 0, 1, 5}),
+            place(create_config({2, 3}, {3, 0})));
+}
+
+TEST(ModuleGeometry, ShouldSumPixelsWhenBinning)
+{
+  const auto image = place(create_config({2, 2}, {3, 2}, 2));
+  EXPECT_EQ((std::vector<uint16_t>{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 + 2 + 5 + 6, 3 + 4 + 7 + 8, 0,
+                                   0, 0, 0}),
+            image);
+}
+
+TEST(ModuleGeometry, ShouldPlaceModulesLargerThanTile)
+{
+  constexpr std::size_t side = 70;
+  const utils::DetectorConfig config{
+      "JF", "jungfrau-converted", 1, 16, side, side, 0, "debug", std::chrono::seconds(30), 8,
+      false, 16777216, false, 50, 0, 1000, std::chrono::seconds(30), false, {},
+      {{0, {{side - 1, 0}, {0, side - 1}}}}};
+
+  std::vector<uint32_t> module(side * side);
+  std::iota(module.begin(), module.end(), 0);
+  std::vector<uint32_t> image(side * side);
+  ModuleGeometry(config, 0, side, side).place(module.data(), image.data(), [](auto v) {
+    return v;
+  });
+
+  for (auto y = 0u; y < side; y++)
+    for (auto x = 0u; x < side; x++)
+      ASSERT_EQ(module[y * side + (side - 1 - x)], image[y * side + x]);
+}
+
+TEST(ModuleGeometry, ShouldThrowWhenPlacementDoesNotFitModule)
+{
+  EXPECT_THROW(ModuleGeometry(create_config({0, 0}, {2, 1}), 0, module_width, module_height),
+               std::runtime_error);
+  EXPECT_THROW(ModuleGeometry(create_config({0, 0}, {3, 1}, 2), 0, module_width, module_height),
+               std::runtime_error);
+}
@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "work_stealing_pool.hpp"
+
+#include <atomic>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "multi_module_converter.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+void wait_for(const std::atomic<int>& counter, int expected)
+{
+  for (auto i = 0; i < 500 && counter.load() != expected; i++)
+    std::this_thread::sleep_for(10ms);
+}
+} // namespace
+
+TEST(WorkStealingPool, ShouldProcessAllSubmittedTasks)
+{
+  std::atomic<int> sum = 0;
+  std::atomic<int> processed = 0;
+  {
+    convert::WorkStealingPool<int> pool(4, [&](int value) {
+      sum += value;
+      processed++;
+    });
+    for (auto i = 1; i <= 1000; i++)
+      pool.submit(i, i);
+    wait_for(processed, 1000);
+  }
+  EXPECT_EQ(1000, processed.load());
+  EXPECT_EQ(500500, sum.load());
+}
+
+TEST(WorkStealingPool, IdleWorkersShouldStealTasksOfBusyOne)
+{
+  std::mutex mutex;
+  std::set<std::thread::id> workers;
+  std::atomic<int> processed = 0;
+
+  convert::WorkStealingPool<int> pool(4, [&](int) {
+    std::this_thread::sleep_for(5ms);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      workers.insert(std::this_thread::get_id());
+    }
+    processed++;
+  });
+  // all tasks are queued to single worker
+  for (auto i = 0; i < 40; i++)
+    pool.submit(i, 0);
+  wait_for(processed, 40);
+
+  EXPECT_EQ(40, processed.load());
+  EXPECT_LT(1u, workers.size());
+}
+
+TEST(MultiModuleConverter, ShouldUseModulesFromModulePositions)
+{
+  const utils::DetectorConfig config{"JF",
+                                     "jungfrau-converted",
+                                     4,
+                                     16,
+                                     1024,
+                                     2048,
+                                     0,
+                                     "debug",
+                                     std::chrono::seconds(30),
+                                     8,
+                                     false,
+                                     16777216,
+                                     false,
+                                     50,
+                                     0,
+                                     1000,
+                                     std::chrono::seconds(30),
+                                     false,
+                                     {},
+                                     {{1, {{0, 0}, {1023, 511}}}, {3, {{0, 512}, {1023, 1023}}}}};
+  EXPECT_EQ((std::vector<uint16_t>{1, 3}), convert::get_active_modules(config));
+}
@@ -19,15 +19,20 @@ public:
   void convert(std::span<char> input_data, std::span<char> output_buffer) const;
 
 private:
-  static std::size_t calculate_row_jump(std::size_t image_width, std::size_t bit_depth);
-  static int calculate_start_index(const utils::DetectorConfig& config, int module_id);
+  template <typename T, typename Unpack>
+  void convert_rows(const char* input, T* output, Unpack unpack) const;
+  template <typename T> void handle_gap(T* row) const;
+
+  static std::vector<std::ptrdiff_t> calculate_row_offsets(const utils::DetectorConfig& config,
+                                                           int module_id);
   static int calculate_row_jump_direction(const utils::DetectorConfig& config, int module_id);
   static void test_if_module_size_fits_eiger(const utils::DetectorConfig& config, int module_id);
+  static void test_if_bit_depth_is_supported(int bit_depth);
 
-  const std::size_t input_row_size_per_chip;
-  const std::size_t gap_size;
-  const int row_jump;
-  const int start_index;
+  const int bit_depth;
+  const utils::gap_pixels_mode gap_pixels;
+  // output pixel offset of the beginning of every module row
+  const std::vector<std::ptrdiff_t> row_offsets;
 };
 
 } // namespace eg::sdc
@@ -4,6 +4,9 @@
 
 #include <cstring>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <fmt/core.h>
 
 #include "converter.hpp"
@@ -11,43 +14,112 @@
 
 namespace eg::sdc {
 
+namespace {
+
+constexpr std::size_t chip_pixels_per_row = MODULE_X_SIZE / 2;
+
+template <typename T> const char* copy_pixels(const char* input, T* output, std::size_t n_pixels)
+{
+  std::memcpy(output, input, n_pixels * sizeof(T));
+  return input + n_pixels * sizeof(T);
+}
+
+// 4 bit mode packs 2 pixels into a byte - lower nibble holds the first pixel
+const char* expand_nibbles(const char* input, uint8_t* output, std::size_t n_pixels)
+{
+  auto i = 0ul;
+#if defined(__SSE2__)
+  const auto low_mask = _mm_set1_epi8(0x0F);
+  for (; i + 32 <= n_pixels; i += 32, input += 16) {
+    const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+    const auto low = _mm_and_si128(packed, low_mask);
+    const auto high = _mm_and_si128(_mm_srli_epi16(packed, 4), low_mask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_unpacklo_epi8(low, high));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 16), _mm_unpackhi_epi8(low, high));
+  }
+#endif
+  for (; i < n_pixels; i += 2, input++) {
+    output[i] = *input & 0x0F;
+    output[i + 1] = (*input >> 4) & 0x0F;
+  }
+  return input;
+}
+
+} // namespace
+
 Converter::Converter(const utils::DetectorConfig& config, int module_id)
-    : input_row_size_per_chip(MODULE_X_SIZE * config.bit_depth / 16)
-    , gap_size(2 * config.bit_depth / 8)
-    , row_jump(static_cast<int>(calculate_row_jump(config.image_pixel_width, config.bit_depth)) *
-               calculate_row_jump_direction(config, module_id))
-    , start_index(calculate_start_index(config, module_id))
+    : bit_depth(config.bit_depth)
+    , gap_pixels(config.gap_pixels)
+    , row_offsets(calculate_row_offsets(config, module_id))
 {
   utils::test_if_module_is_inside_image(config, module_id);
   test_if_module_size_fits_eiger(config, module_id);
+  test_if_bit_depth_is_supported(bit_depth);
 }
 
 void Converter::convert(std::span<char> input, std::span<char> output_buffer) const
 {
-  constexpr std::size_t chips_per_module = 2;
-  const auto input_second_chip_pos = input_row_size_per_chip;
-  const auto output_second_chip_pos = input_second_chip_pos + gap_size;
-
-  for (auto row = 0u; row < MODULE_Y_SIZE; row++) {
-    const auto input_start = row * input_row_size_per_chip * chips_per_module;
-    const auto output_start = start_index + row * row_jump;
-    std::memcpy(output_buffer.data() + output_start, input.data() + input_start,
-                input_row_size_per_chip);
-    std::memcpy(output_buffer.data() + output_start + output_second_chip_pos,
-                input.data() + input_start + input_second_chip_pos, input_row_size_per_chip);
+  switch (bit_depth) {
+  case 4:
+    convert_rows(input.data(), reinterpret_cast<uint8_t*>(output_buffer.data()), expand_nibbles);
+    break;
+  case 8:
+    convert_rows(input.data(), reinterpret_cast<uint8_t*>(output_buffer.data()),
+                 copy_pixels<uint8_t>);
+    break;
+  case 16:
+    convert_rows(input.data(), reinterpret_cast<uint16_t*>(output_buffer.data()),
+                 copy_pixels<uint16_t>);
+    break;
+  default:
+    convert_rows(input.data(), reinterpret_cast<uint32_t*>(output_buffer.data()),
+                 copy_pixels<uint32_t>);
   }
 }
 
-int Converter::calculate_start_index(const utils::DetectorConfig& config, int module_id)
+template <typename T, typename Unpack>
+void Converter::convert_rows(const char* input, T* output, Unpack unpack) const
 {
-  const auto start_position = utils::get_module_start_position(config, module_id);
-  const auto row_jump = calculate_row_jump(config.image_pixel_width, config.bit_depth);
-  return static_cast<int>(start_position.y * row_jump + start_position.x * config.bit_depth / 8);
+  // gap is handled right after its row is written - while the edge pixels are still in cache
+  for (const auto offset : row_offsets) {
+    T* row = output + offset;
+    input = unpack(input, row, chip_pixels_per_row);
+    input = unpack(input, row + chip_pixels_per_row + GAP_X_MODULE_PIXELS, chip_pixels_per_row);
+    handle_gap(row);
+  }
 }
 
-std::size_t Converter::calculate_row_jump(std::size_t image_width, std::size_t bit_depth)
+template <typename T> void Converter::handle_gap(T* row) const
 {
-  return image_width * bit_depth / 8;
+  T* gap = row + chip_pixels_per_row;
+  if (gap_pixels == utils::gap_pixels_mode::zero) {
+    gap[0] = 0;
+    gap[1] = 0;
+  }
+  else if (gap_pixels == utils::gap_pixels_mode::interpolate) {
+    // edge pixels of chips are double sized and cover the gap - counts are split evenly
+    T& left_edge = gap[-1];
+    T& right_edge = gap[GAP_X_MODULE_PIXELS];
+    gap[0] = left_edge / 2;
+    left_edge -= gap[0];
+    gap[1] = right_edge / 2;
+    right_edge -= gap[1];
+  }
+}
+
+std::vector<std::ptrdiff_t> Converter::calculate_row_offsets(const utils::DetectorConfig& config,
+                                                             int module_id)
+{
+  const auto start_position = utils::get_module_start_position(config, module_id);
+  const auto start_index =
+      static_cast<std::ptrdiff_t>(start_position.y) * config.image_pixel_width + start_position.x;
+  const auto row_jump = static_cast<std::ptrdiff_t>(config.image_pixel_width) *
+                        calculate_row_jump_direction(config, module_id);
+
+  std::vector<std::ptrdiff_t> offsets(MODULE_Y_SIZE);
+  for (auto row = 0u; row < MODULE_Y_SIZE; row++)
+    offsets[row] = start_index + row * row_jump;
+  return offsets;
 }
 
 int Converter::calculate_row_jump_direction(const utils::DetectorConfig& config, int module_id)
@@ -70,4 +142,10 @@ void Converter::test_if_module_size_fits_eiger(const utils::DetectorConfig& conf
         "Eiger module height cannot be different than {} (set {})!", MODULE_Y_SIZE, diff));
 }
 
+void Converter::test_if_bit_depth_is_supported(int bit_depth)
+{
+  if (bit_depth != 4 && bit_depth != 8 && bit_depth != 16 && bit_depth != 32)
+    throw std::runtime_error(fmt::format("Eiger bit depth {} is not supported!", bit_depth));
+}
+
 } // namespace eg::sdc
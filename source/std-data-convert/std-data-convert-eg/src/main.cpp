@@ -11,31 +11,94 @@
 #include "detectors/eiger.hpp"
 #include "utils/utils.hpp"
 #include "converter.hpp"
+#include "multi_module_converter.hpp"
 
+using namespace std::string_literals;
 using namespace buffer_config;
 using namespace eg;
 
 namespace {
-std::tuple<utils::DetectorConfig, uint16_t> read_arguments(int argc, char* argv[])
+struct arguments
+{
+  utils::DetectorConfig config;
+  uint16_t module_id;
+  bool all_modules;
+  std::size_t n_workers;
+  std::string compression;
+  int compression_level;
+};
+
+arguments read_arguments(int argc, char* argv[])
 {
   auto program = utils::create_parser("std_data_convert_eg");
-  program->add_argument("module_id").scan<'d', uint16_t>();
+  program->add_argument("--all_modules")
+      .help("convert all modules of the detector in this process instead of single module_id")
+      .default_value(false)
+      .implicit_value(true);
+  program->add_argument("--n_workers")
+      .help("number of conversion threads used with --all_modules (0 - one per module)")
+      .scan<'u', std::size_t>()
+      .default_value(0ul);
+  program->add_argument("--compression")
+      .help("compress modules right after conversion with --all_modules: none, h5bitshuffle-lz4, "
+            "blosc2")
+      .default_value("none"s);
+  program->add_argument("--compression_level")
+      .help("compression level used by blosc2")
+      .scan<'d', int>()
+      .default_value(5);
+  program->add_argument("module_id").scan<'d', uint16_t>().default_value(uint16_t{0});
 
   program = utils::parse_arguments(std::move(program), argc, argv);
 
   return {utils::read_config_from_json_file(program->get("detector_json_filename")),
-          program->get<uint16_t>("module_id")};
+          program->get<uint16_t>("module_id"), program->get<bool>("--all_modules"),
+          program->get<std::size_t>("--n_workers"), program->get("--compression"),
+          program->get<int>("--compression_level")};
+}
+
+std::size_t frame_n_bytes(const utils::DetectorConfig& config)
+{
+  return MODULE_N_PIXELS * config.bit_depth / 8;
+}
+
+[[noreturn]] void run_all_modules(const utils::DetectorConfig& config, const arguments& args)
+{
+  const auto modules = convert::get_active_modules(config);
+  const size_t module_bytes = frame_n_bytes(config);
+  const size_t converted_bytes = utils::converted_image_n_bytes(config);
+
+  std::vector<std::unique_ptr<sdc::Converter>> converters(config.n_modules);
+  for (const auto module_id : modules)
+    converters[module_id] = std::make_unique<sdc::Converter>(config, module_id);
+
+  auto ctx = zmq_ctx_new();
+  convert::MultiModuleConverter<EGFrame> converter(
+      config, ctx, modules, module_bytes, args.n_workers == 0 ? modules.size() : args.n_workers,
+      [&](const EGFrame& meta, char* input, char* output) {
+        converters[meta.common.module_id % config.n_modules]->convert(
+            std::span<char>(input, module_bytes), std::span<char>(output, converted_bytes));
+      });
+  if (args.compression != "none")
+    converter.enable_compression(
+        config, ctx,
+        std::make_unique<convert::ModuleChunkCompressor>(
+            config, convert::ModuleChunkCompressor::to_codec(args.compression),
+            args.compression_level));
+  converter.run();
 }
 
 } // namespace
 
 int main(int argc, char* argv[])
 {
-  const auto [config, module_id] = read_arguments(argc, argv);
-  if (config.bit_depth < 8) throw std::runtime_error("Bit depth below 8 is not supported!");
+  const auto args = read_arguments(argc, argv);
+  const auto& [config, module_id, all_modules, n_workers, compression, compression_level] = args;
   [[maybe_unused]] utils::log::logger l{"std_data_convert_eg", config.log_level};
+  if (all_modules) run_all_modules(config, args);
+  if (compression != "none") throw std::invalid_argument("--compression requires --all_modules!");
 
-  const size_t frame_n_bytes = MODULE_N_PIXELS * config.bit_depth / 8;
+  const size_t module_bytes = frame_n_bytes(config);
   const size_t converted_bytes = utils::converted_image_n_bytes(config);
 
   utils::stats::ModuleStatsCollector stats_collector(config.detector_name,
@@ -44,7 +107,7 @@ int main(int argc, char* argv[])
   auto ctx = zmq_ctx_new();
   const auto source_name = fmt::format("{}-{}", config.detector_name, module_id);
 
-  const cb::RamBufferConfig recv_buffer_config = {source_name, frame_n_bytes,
+  const cb::RamBufferConfig recv_buffer_config = {source_name, module_bytes,
                                                   RECEIVER_RAM_BUFFER_N_SLOTS};
   const cb::CommunicatorConfig recv_comm_config = {source_name, ctx, cb::CONN_TYPE_CONNECT,
                                                    ZMQ_SUB};
@@ -66,7 +129,7 @@ int main(int argc, char* argv[])
   while (true) {
     auto [id, image] = receiver.receive(std::span<char>((char*)&meta, sizeof(meta)));
     if (id != INVALID_IMAGE_ID) {
-      converter.convert(std::span<char>(image, frame_n_bytes),
+      converter.convert(std::span<char>(image, module_bytes),
                         std::span<char>(sender.get_data(id), converted_bytes));
 
       sender.send(id, std::span((char*)(&meta), sizeof(meta)), nullptr);
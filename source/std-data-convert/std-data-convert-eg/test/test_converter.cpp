@@ -0,0 +1,169 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "converter.hpp"
+
+#include <gtest/gtest.h>
+
+#include "detectors/eiger.hpp"
+
+using namespace eg;
+
+namespace {
+constexpr std::size_t image_width = MODULE_X_SIZE + GAP_X_MODULE_PIXELS;
+constexpr std::size_t image_height = MODULE_Y_SIZE;
+constexpr std::size_t chip_width = MODULE_X_SIZE / 2;
+
+utils::DetectorConfig create_config(int bit_depth,
+                                    utils::gap_pixels_mode gap_pixels = utils::gap_pixels_mode::keep,
+                                    bool flipped = false)
+{
+  const utils::Point first = {0, 0};
+  const utils::Point last = {static_cast<int>(image_width - 1), static_cast<int>(image_height - 1)};
+  return {"eg",
+          "eiger",
+          1,
+          bit_depth,
+          static_cast<int>(image_height),
+          static_cast<int>(image_width),
+          0,
+          "debug",
+          std::chrono::seconds(30),
+          8,
+          false,
+          16777216,
+          false,
+          50,
+          0,
+          1000,
+          std::chrono::seconds(30),
+          false,
+          {},
+          {{0,
+            flipped ? std::pair{utils::Point{first.x, last.y}, utils::Point{last.x, first.y}}
+                    : std::pair{first, last}}},
+          {},
+          gap_pixels};
+}
+
+template <typename T> std::vector<T> iota_module_data()
+{
+  std::vector<T> data(MODULE_N_PIXELS);
+  for (auto i = 0u; i < data.size(); i++)
+    data[i] = static_cast<T>(i % 251);
+  return data;
+}
+
+template <typename T> T expected_pixel(const std::vector<T>& input, std::size_t row, std::size_t x)
+{
+  return input[row * MODULE_X_SIZE + (x < chip_width ? x : x - GAP_X_MODULE_PIXELS)];
+}
+
+template <typename T>
+std::vector<T> convert(const utils::DetectorConfig& config, std::vector<T> input)
+{
+  std::vector<T> output(image_width * image_height, 0xAA);
+  eg::sdc::Converter converter(config, 0);
+  converter.convert({reinterpret_cast<char*>(input.data()), input.size() * sizeof(T)},
+                    {reinterpret_cast<char*>(output.data()), output.size() * sizeof(T)});
+  return output;
+}
+
+template <typename T> void check_copied_module(int bit_depth)
+{
+  const auto input = iota_module_data<T>();
+  const auto output = convert(create_config(bit_depth), input);
+
+  for (auto row = 0u; row < image_height; row++) {
+    for (auto x = 0u; x < image_width; x++) {
+      if (x == chip_width || x == chip_width + 1)
+        ASSERT_EQ(T(0xAA), output[row * image_width + x]);
+      else
+        ASSERT_EQ(expected_pixel(input, row, x), output[row * image_width + x]);
+    }
+  }
+}
+
+} // namespace
+
+TEST(ConverterEg, ShouldCopyChipsAroundGapFor8BitMode)
+{
+  check_copied_module<uint8_t>(8);
+}
+
+TEST(ConverterEg, ShouldCopyChipsAroundGapFor16BitMode)
+{
+  check_copied_module<uint16_t>(16);
+}
+
+TEST(ConverterEg, ShouldCopyChipsAroundGapFor32BitMode)
+{
+  check_copied_module<uint32_t>(32);
+}
+
+TEST(ConverterEg, ShouldExpand4BitPixelsToBytes)
+{
+  const auto pixels = iota_module_data<uint8_t>();
+  std::vector<uint8_t> packed(MODULE_N_PIXELS / 2);
+  for (auto i = 0u; i < packed.size(); i++)
+    packed[i] = (pixels[2 * i] & 0x0F) | ((pixels[2 * i + 1] & 0x0F) << 4);
+
+  std::vector<uint8_t> output(image_width * image_height, 0xAA);
+  eg::sdc::Converter converter(create_config(4), 0);
+  converter.convert({reinterpret_cast<char*>(packed.data()), packed.size()},
+                    {reinterpret_cast<char*>(output.data()), output.size()});
+
+  for (auto row = 0u; row < image_height; row++) {
+    for (auto x = 0u; x < image_width; x++) {
+      if (x == chip_width || x == chip_width + 1)
+        ASSERT_EQ(0xAA, output[row * image_width + x]);
+      else
+        ASSERT_EQ(expected_pixel(pixels, row, x) & 0x0F, output[row * image_width + x]);
+    }
+  }
+}
+
+TEST(ConverterEg, ShouldMirrorRowsWhenModuleIsFlipped)
+{
+  const auto input = iota_module_data<uint16_t>();
+  const auto output = convert(create_config(16, utils::gap_pixels_mode::keep, true), input);
+
+  for (auto row = 0u; row < image_height; row++)
+    for (auto x = 0u; x < chip_width; x++)
+      ASSERT_EQ(expected_pixel(input, row, x), output[(image_height - 1 - row) * image_width + x]);
+}
+
+TEST(ConverterEg, ShouldZeroGapPixels)
+{
+  const auto output = convert(create_config(16, utils::gap_pixels_mode::zero),
+                              iota_module_data<uint16_t>());
+
+  for (auto row = 0u; row < image_height; row++) {
+    EXPECT_EQ(0, output[row * image_width + chip_width]);
+    EXPECT_EQ(0, output[row * image_width + chip_width + 1]);
+  }
+}
+
+TEST(ConverterEg, ShouldSplitEdgePixelsIntoGap)
+{
+  const auto input = iota_module_data<uint32_t>();
+  const auto output = convert(create_config(32, utils::gap_pixels_mode::interpolate), input);
+
+  for (auto row = 0u; row < image_height; row++) {
+    const auto* line = output.data() + row * image_width;
+    const auto left = expected_pixel(input, row, chip_width - 1);
+    const auto right = expected_pixel(input, row, chip_width + GAP_X_MODULE_PIXELS);
+
+    EXPECT_EQ(left, line[chip_width - 1] + line[chip_width]);
+    EXPECT_EQ(left / 2, line[chip_width]);
+    EXPECT_EQ(right, line[chip_width + 1] + line[chip_width + 2]);
+    EXPECT_EQ(right / 2, line[chip_width + 1]);
+    EXPECT_EQ(expected_pixel(input, row, 0), line[0]);
+  }
+}
+
+TEST(ConverterEg, ShouldThrowForUnsupportedBitDepth)
+{
+  EXPECT_THROW(eg::sdc::Converter(create_config(12), 0), std::runtime_error);
+}
@@ -15,13 +15,31 @@ namespace gf::sdc {
 class Converter
 {
 public:
+  // scalar unpacking is the reference - vectorised ones are picked when CPU supports them
+  enum class unpacker
+  {
+    scalar,
+    ssse3,
+    avx2
+  };
+
   explicit Converter(std::size_t image_height,
                      std::size_t image_width,
                      quadrant_id q,
-                     int module_id);
+                     int module_id,
+                     unpacker u = best_unpacker());
   void convert(std::span<char> input_data, std::span<char> output_buffer) const;
 
+  static bool is_supported(unpacker u);
+  static unpacker best_unpacker();
+
 private:
+  using unpack_function = const char* (*)(const char* input,
+                                          const char* input_end,
+                                          uint16_t* output,
+                                          std::size_t n_pixels);
+  static unpack_function select_unpack_function(unpacker u);
+
   static std::size_t calculate_start_index(int module_id,
                                            quadrant_id quadrant,
                                            std::size_t image_height,
@@ -32,6 +50,7 @@ private:
   const std::size_t width;
   const std::size_t start_index;
   const int row_jump;
+  const unpack_function unpack;
 };
 
 } // namespace gf::sdc
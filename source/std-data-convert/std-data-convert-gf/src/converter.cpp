@@ -4,6 +4,12 @@
 
 #include "converter.hpp"
 
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace gf::sdc {
 
 namespace {
@@ -17,39 +23,122 @@ struct conversion_handle
   unsigned int p22 : 8;
 };
 #pragma pack()
+
+// reference implementation - 2 pixels are stored in 3 bytes
+const char* unpack_scalar(const char* input, const char*, uint16_t* output, std::size_t n_pixels)
+{
+  const auto* handle = reinterpret_cast<const conversion_handle*>(input);
+  for (auto j = 0u; j < n_pixels; handle++, j += 2) {
+    output[j] = (handle->p11) | (handle->p21 << 8);
+    output[j + 1] = (handle->p12) | (handle->p22 << 4);
+  }
+  return reinterpret_cast<const char*>(handle);
+}
+
+#if defined(__x86_64__)
+// Every 16 bit lane gathers the 2 bytes holding its pixel: even pixel lies in the lower 12 bits
+// of bytes (3k, 3k+1), odd pixel in the upper 12 bits of bytes (3k+1, 3k+2).
+__attribute__((target("ssse3"))) __m128i unpack_12_bytes(__m128i packed)
+{
+  const auto shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+  const auto gathered = _mm_shuffle_epi8(packed, shuffle);
+  return _mm_or_si128(_mm_and_si128(gathered, _mm_set1_epi32(0x00000FFF)),
+                      _mm_and_si128(_mm_srli_epi16(gathered, 4), _mm_set1_epi32(0xFFFF0000)));
+}
+
+__attribute__((target("ssse3"))) const char* unpack_ssse3(const char* input,
+                                                          const char* input_end,
+                                                          uint16_t* output,
+                                                          std::size_t n_pixels)
+{
+  // 8 pixels come from 12 bytes, but 16 bytes are loaded - stay within the input buffer
+  auto j = 0ul;
+  for (; j + 8 <= n_pixels && input + 16 <= input_end; j += 8, input += 12) {
+    const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + j), unpack_12_bytes(packed));
+  }
+  return unpack_scalar(input, input_end, output + j, n_pixels - j);
+}
+
+__attribute__((target("avx2"))) const char* unpack_avx2(const char* input,
+                                                        const char* input_end,
+                                                        uint16_t* output,
+                                                        std::size_t n_pixels)
+{
+  // pshufb works within 128 bit lanes - each lane gets its own 12 bytes of the input
+  const auto shuffle = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11, 0, 1,
+                                        1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+  const auto even_mask = _mm256_set1_epi32(0x00000FFF);
+  const auto odd_mask = _mm256_set1_epi32(0xFFFF0000);
+
+  auto j = 0ul;
+  for (; j + 16 <= n_pixels && input + 28 <= input_end; j += 16, input += 24) {
+    const auto packed = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 12)), 1);
+    const auto gathered = _mm256_shuffle_epi8(packed, shuffle);
+    const auto pixels =
+        _mm256_or_si256(_mm256_and_si256(gathered, even_mask),
+                        _mm256_and_si256(_mm256_srli_epi16(gathered, 4), odd_mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + j), pixels);
+  }
+  return unpack_ssse3(input, input_end, output + j, n_pixels - j);
+}
+#endif
+
 } // namespace
 
 Converter::Converter(std::size_t image_height,
                      std::size_t image_width,
                      quadrant_id q,
-                     int module_id)
+                     int module_id,
+                     unpacker u)
     : height(image_height)
     , width(image_width)
     , start_index(calculate_start_index(module_id, q, image_height, image_width))
     , row_jump(calculate_row_jump(q, image_width))
+    , unpack(select_unpack_function(u))
 {}
 
 void Converter::convert(std::span<char> input, std::span<char> output_buffer) const
 {
-  // in theory the pixels number should be divisible by 4 - so there should be no problem with
-  // alignment of conversion_handle
-  const std::span<conversion_handle> conversion(reinterpret_cast<conversion_handle*>(input.data()),
-                                                input.size() / sizeof(conversion_handle));
-
-  std::span<uint16_t> output(reinterpret_cast<uint16_t*>(output_buffer.data()),
-                             output_buffer.size() / sizeof(uint16_t));
-
-  for (auto i = 0u, row = 0u; row < height / 4; row++) {
-    const long int start_row = (row_jump * static_cast<int>(row))+ start_index;
-    const long int end_row = start_row + width / 2;
-
-    for (auto j = start_row; j < end_row; i++, j += 2) {
-      output[j] = (conversion[i].p11) | (conversion[i].p21 << 8);
-      output[j + 1] = (conversion[i].p12) | (conversion[i].p22 << 4);
-    }
+  const char* packed = input.data();
+  const char* packed_end = input.data() + input.size();
+  auto* output = reinterpret_cast<uint16_t*>(output_buffer.data());
+
+  // rows of north quadrants are mirrored - row_jump is negative for them
+  for (auto row = 0u; row < height / 4; row++) {
+    const long int start_row = (row_jump * static_cast<int>(row)) + start_index;
+    packed = unpack(packed, packed_end, output + start_row, width / 2);
   }
 }
 
+bool Converter::is_supported(unpacker u)
+{
+#if defined(__x86_64__)
+  if (u == unpacker::avx2) return __builtin_cpu_supports("avx2");
+  if (u == unpacker::ssse3) return __builtin_cpu_supports("ssse3");
+#endif
+  return u == unpacker::scalar;
+}
+
+Converter::unpacker Converter::best_unpacker()
+{
+  if (is_supported(unpacker::avx2)) return unpacker::avx2;
+  if (is_supported(unpacker::ssse3)) return unpacker::ssse3;
+  return unpacker::scalar;
+}
+
+Converter::unpack_function Converter::select_unpack_function(unpacker u)
+{
+  if (!is_supported(u)) throw std::invalid_argument("Unpacker is not supported by this CPU");
+#if defined(__x86_64__)
+  if (u == unpacker::avx2) return unpack_avx2;
+  if (u == unpacker::ssse3) return unpack_ssse3;
+#endif
+  return unpack_scalar;
+}
+
 std::size_t Converter::calculate_start_index(int module_id,
                                              quadrant_id quadrant,
                                              std::size_t image_height,
@@ -2,6 +2,7 @@
 // Copyright (c) 2022 Paul Scherrer Institute. All rights reserved.
 /////////////////////////////////////////////////////////////////////
 
+#include <numeric>
 #include <span>
 #include <cstdlib>
 
@@ -12,20 +13,38 @@
 #include "detectors/gigafrost.hpp"
 #include "utils/utils.hpp"
 #include "converter.hpp"
+#include "multi_module_converter.hpp"
 
 using namespace gf;
 using namespace buffer_config;
 
 namespace {
-std::tuple<utils::DetectorConfig, uint16_t> read_arguments(int argc, char* argv[])
+struct arguments
+{
+  utils::DetectorConfig config;
+  uint16_t module_id;
+  bool all_modules;
+  std::size_t n_workers;
+};
+
+arguments read_arguments(int argc, char* argv[])
 {
   auto program = utils::create_parser("std_data_convert_gf");
-  program->add_argument("module_id").scan<'d', uint16_t>();
+  program->add_argument("--all_modules")
+      .help("convert all modules of the detector in this process instead of single module_id")
+      .default_value(false)
+      .implicit_value(true);
+  program->add_argument("--n_workers")
+      .help("number of conversion threads used with --all_modules (0 - one per module)")
+      .scan<'u', std::size_t>()
+      .default_value(0ul);
+  program->add_argument("module_id").scan<'d', uint16_t>().default_value(uint16_t{0});
 
   program = utils::parse_arguments(std::move(program), argc, argv);
 
   return {utils::read_config_from_json_file(program->get("detector_json_filename")),
-          program->get<uint16_t>("module_id")};
+          program->get<uint16_t>("module_id"), program->get<bool>("--all_modules"),
+          program->get<std::size_t>("--n_workers")};
 }
 
 std::tuple<std::size_t, std::size_t> calculate_data_sizes(const utils::DetectorConfig& config)
@@ -37,13 +56,41 @@ std::tuple<std::size_t, std::size_t> calculate_data_sizes(const utils::DetectorC
   return {MODULE_DATA_IN_BYTES, utils::converted_image_n_bytes(config)};
 }
 
+quadrant_id get_quadrant(uint16_t module_id)
+{
+  return static_cast<quadrant_id>((module_id % 8) / 2);
+}
+
+[[noreturn]] void run_all_modules(const utils::DetectorConfig& config, std::size_t n_workers)
+{
+  const auto [module_bytes, converted_bytes] = calculate_data_sizes(config);
+  // detector streams two images in parallel - every module position is served by two sources
+  std::vector<uint16_t> sources(2 * config.n_modules);
+  std::iota(sources.begin(), sources.end(), 0);
+
+  std::vector<std::unique_ptr<sdc::Converter>> converters;
+  for (auto module_id = 0; module_id < config.n_modules; module_id++)
+    converters.push_back(std::make_unique<sdc::Converter>(
+        config.image_pixel_height, config.image_pixel_width, get_quadrant(module_id), module_id));
+
+  convert::MultiModuleConverter<GFFrame> converter(
+      config, zmq_ctx_new(), sources, module_bytes, n_workers == 0 ? sources.size() : n_workers,
+      [&, module_bytes, converted_bytes](const GFFrame& meta, char* input, char* output) {
+        converters[meta.common.module_id % config.n_modules]->convert(
+            std::span<char>(input, module_bytes), std::span<char>(output, converted_bytes));
+      });
+  converter.run();
+}
+
 } // namespace
 
 int main(int argc, char* argv[])
 {
-  const auto [config, module_id] = read_arguments(argc, argv);
+  const auto [config, module_id, all_modules, n_workers] = read_arguments(argc, argv);
   [[maybe_unused]] utils::log::logger l{"std_data_convert_gf", config.log_level};
-  const auto quadrant = static_cast<quadrant_id>((module_id % 8) / 2);
+  if (all_modules) run_all_modules(config, n_workers);
+
+  const auto quadrant = get_quadrant(module_id);
   const auto converter_name = fmt::format("{}-{}-converted", config.detector_name, module_id);
   const auto [module_bytes, converted_bytes] = calculate_data_sizes(config);
 
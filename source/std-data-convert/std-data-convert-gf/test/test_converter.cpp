@@ -5,6 +5,7 @@
 #include "converter.hpp"
 
 #include <cmath>
+#include <random>
 
 #include <gtest/gtest.h>
 #include <range/v3/all.hpp>
@@ -18,6 +19,36 @@ char example_data_1[] = {0b00000001, 0b00100010, 0b00100000,
                          0b00000011, 0b01000010, 0b00100000}; // 513, 514, 515, 516
 char example_data_2[] = {0b00000010, 0b00110110, 0b01100000,
                          0b00000100, 0b01010110, 0b01100000}; // 1538, 1539, 1540, 1541
+
+using unpacker = gf::sdc::Converter::unpacker;
+
+std::vector<char> random_module_data(std::size_t height, std::size_t width)
+{
+  std::mt19937 generator(height * width);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  std::vector<char> data(height / 4 * width / 2 * 3 / 2);
+  for (auto& byte : data)
+    byte = static_cast<char>(distribution(generator));
+  return data;
+}
+
+// converts all modules of all quadrants into a single image with chosen unpacker
+std::vector<uint16_t> convert_image(std::size_t height, std::size_t width, unpacker u)
+{
+  std::vector<uint16_t> image(height * width, 0xFFFF);
+  std::span output_buffer(reinterpret_cast<char*>(image.data()), image.size() * sizeof(uint16_t));
+
+  auto data = random_module_data(height, width);
+  using enum gf::quadrant_id;
+  for (auto q : {SW, SE, NW, NE}) {
+    for (auto module : {0, 1}) {
+      std::ranges::rotate(data, data.begin() + 1);
+      gf::sdc::Converter{height, width, q, module, u}.convert(data, output_buffer);
+    }
+  }
+  return image;
+}
+
 } // namespace
 
 TEST(ConverterGf, CheckConversionFrom12bitTo16bitForSouthWest_8x4)
@@ -380,3 +411,30 @@ TEST(ConverterGf, CheckConversionFromGeneratedBytes)
     }
   }
 }
+
+TEST(ConverterGf, VectorisedUnpackersShouldMatchScalarReference)
+{
+  // 2016 - full image, 40 and 24 exercise vector loop followed by scalar tail of each row
+  for (auto [height, width] : {std::pair{2016ul, 2016ul}, std::pair{48ul, 40ul},
+                               std::pair{8ul, 24ul}, std::pair{8ul, 4ul}})
+  {
+    const auto expected = convert_image(height, width, unpacker::scalar);
+    EXPECT_EQ(0, std::ranges::count(expected, 0xFFFF));
+
+    for (auto u : {unpacker::ssse3, unpacker::avx2}) {
+      if (!gf::sdc::Converter::is_supported(u)) continue;
+      EXPECT_EQ(expected, convert_image(height, width, u))
+          << "unpacker=" << static_cast<int>(u) << " height=" << height << " width=" << width;
+    }
+  }
+}
+
+TEST(ConverterGf, ShouldThrowForUnsupportedUnpacker)
+{
+  for (auto u : {unpacker::ssse3, unpacker::avx2}) {
+    if (!gf::sdc::Converter::is_supported(u)) {
+      EXPECT_THROW((gf::sdc::Converter{8, 4, gf::quadrant_id::SW, 0, u}), std::invalid_argument);
+    }
+  }
+  EXPECT_TRUE(gf::sdc::Converter::is_supported(gf::sdc::Converter::best_unpacker()));
+}
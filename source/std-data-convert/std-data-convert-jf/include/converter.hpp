@@ -5,12 +5,18 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <span>
 
+#include "detectors/jungfrau.hpp"
 #include "utils/detector_config.hpp"
+#include "module_geometry.hpp"
 
+#include "gains_and_pedestals_cache.hpp"
 #include "parameters.hpp"
+#include "pedestal_tracker.hpp"
 
 namespace jf::sdc {
 
@@ -22,22 +28,53 @@ public:
                      const utils::DetectorConfig& config,
                      int module_id);
 
+  explicit Converter(std::shared_ptr<const GainsAndPedestalsCache> cache,
+                     const utils::DetectorConfig& config,
+                     int module_id);
+
   explicit Converter(const utils::DetectorConfig& config, int module_id);
-  void convert(std::span<const uint16_t> input, std::span<uint16_t>);
+  Converter(Converter&&) = default;
+  Converter(const Converter&) = delete;
+  Converter& operator=(const Converter&) = delete;
+
+  void convert(std::span<const uint16_t> input, std::span<uint16_t>, bool dark_frame = false);
+  // dark frames are recognised by daq_rec bits set in the pedestal tracking config
+  void convert(const JFFrame& meta, std::span<const uint16_t> input, std::span<uint16_t> output);
+
+  void enable_pedestal_tracking(const pedestal_tracking_config& tracking);
+  parameters pedestals() const;
+  std::size_t pedestals_version() const;
 
 private:
-  void convert(std::span<const uint16_t> input_data, std::span<float> output_data);
-  void convert_data(std::span<const uint16_t> input_data, std::span<float> output_data);
+  Converter(const utils::DetectorConfig& config, int module_id, bool with_gains);
+
+  template <typename T, typename Store>
+  void convert(std::span<const uint16_t> input_data, std::span<T> output_data, Store store);
+  template <typename T, typename Store>
+  void convert_rows(std::span<const uint16_t> input_data,
+                    T* output,
+                    std::size_t start,
+                    std::size_t row_stride,
+                    Store store) const;
+  void convert_data(std::span<const uint16_t> input_data, std::span<uint16_t> output_buffer);
   void copy_raw_data(std::span<const uint16_t> input, std::span<uint16_t> output_buffer) const;
+  void swap_g0_pedestals();
+  void use_own_gains_and_pedestals();
 
   void test_data_size_consistency(std::span<const uint16_t> data) const;
-  void test_if_module_size_fits_jungfrau(const utils::DetectorConfig& config, int module_id);
   static void test_gains_and_pedestals_consistency(const parameters& g, const parameters& p);
-  static std::size_t calculate_start_index(const utils::DetectorConfig& config, int module_id);
+  static float calculate_gain_scale(const utils::converted_output_config& output);
 
-  parameters_pairs gains_and_pedestals;
+  // conversion reads from the view - it points either to own table or to shared cache
+  parameters_pairs_view gains_and_pedestals;
+  parameters_pairs own_gains_and_pedestals;
+  std::shared_ptr<const GainsAndPedestalsCache> cache;
+  std::optional<PedestalTracker> pedestal_tracker;
+  std::size_t n_pedestal_swaps = 0;
+  uint64_t dark_frame_bits = 0;
+  utils::converted_output_config::Type output_type;
+  convert::ModuleGeometry geometry;
   std::size_t row_jump;
-  std::size_t start_index;
   bool with_gains;
 };
 
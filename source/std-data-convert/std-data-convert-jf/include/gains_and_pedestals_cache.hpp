@@ -0,0 +1,41 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "parameters.hpp"
+
+namespace jf::sdc {
+
+// Read-only memory mapped table of (gain, pedestal) pairs of a single module. The table is
+// preprocessed from HDF5 calibration file once and stored next to it as
+// `<filename>.<module_id>.cache` so that all converter processes share the same pages instead
+// of decoding HDF5 each. Calibration file holds either single module or all modules in order.
+class GainsAndPedestalsCache
+{
+public:
+  // maps the cache of module in filename - it is (re)built when missing, corrupted or older than
+  // filename
+  static std::shared_ptr<const GainsAndPedestalsCache> load(const std::string& filename,
+                                                            std::size_t image_size,
+                                                            int module_id);
+  ~GainsAndPedestalsCache();
+
+  GainsAndPedestalsCache(const GainsAndPedestalsCache&) = delete;
+  GainsAndPedestalsCache& operator=(const GainsAndPedestalsCache&) = delete;
+
+  parameters_pairs_view table() const;
+  parameters gains() const;
+
+private:
+  GainsAndPedestalsCache(void* mapping, std::size_t mapping_size);
+
+  void* mapping;
+  std::size_t mapping_size;
+};
+
+} // namespace jf::sdc
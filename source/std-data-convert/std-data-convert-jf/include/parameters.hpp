@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <vector>
 #include <array>
+#include <span>
 
 namespace jf::sdc {
 static_assert(sizeof(float) == 4u, "float must comply to IEEE-754 standard for floating points");
@@ -14,4 +15,5 @@ static_assert(sizeof(float) == 4u, "float must comply to IEEE-754 standard for f
 constexpr inline std::size_t N_GAINS = 3u;
 using parameters = std::array<std::vector<float>, N_GAINS>;
 using parameters_pairs = std::array<std::vector<std::pair<float, float>>, N_GAINS>;
+using parameters_pairs_view = std::array<std::span<const std::pair<float, float>>, N_GAINS>;
 } // namespace jf::sdc
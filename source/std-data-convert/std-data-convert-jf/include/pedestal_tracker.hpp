@@ -0,0 +1,43 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace jf::sdc {
+
+struct pedestal_tracking_config
+{
+  // raw ADC distance from the pedestal below which G0 pixel is treated as not hit by photons
+  float threshold;
+  // number of frames over which the running mean is effectively averaged
+  std::size_t window;
+  // number of tracked frames after which updated pedestals are handed over to conversion
+  std::size_t swap_period;
+  // daq_rec bits of frames taken without beam - all G0 pixels of such frames update pedestals
+  uint64_t dark_frame_bits = 0;
+};
+
+class PedestalTracker
+{
+public:
+  explicit PedestalTracker(std::span<const float> initial_pedestals,
+                           const pedestal_tracking_config& config);
+
+  // returns true when swap period elapsed and pedestals() should be taken over
+  bool process(std::span<const uint16_t> frame, bool dark_frame);
+  std::span<const float> pedestals() const;
+
+private:
+  std::vector<float> accumulator;
+  const float threshold;
+  const float alpha;
+  const std::size_t swap_period;
+  std::size_t n_frames;
+};
+
+} // namespace jf::sdc
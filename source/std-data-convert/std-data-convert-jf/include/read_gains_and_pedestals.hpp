@@ -12,4 +12,7 @@
 namespace jf::sdc {
 std::tuple<parameters, parameters> read_gains_and_pedestals(const std::string& filename,
                                                             std::size_t image_size);
+void write_gains_and_pedestals(const std::string& filename,
+                               const parameters& gains,
+                               const parameters& pedestals);
 }
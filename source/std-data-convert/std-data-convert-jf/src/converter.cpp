@@ -5,71 +5,225 @@
 #include "converter.hpp"
 
 #include <algorithm>
+#include <bit>
 
 #include <fmt/core.h>
 #include "detectors/jungfrau.hpp"
 
 namespace jf::sdc {
 
+namespace {
+
+// IEEE-754 binary32 -> binary16 with round-to-nearest-even, written branch-light so that the
+// conversion loop stays vectorizable.
+inline uint16_t to_float16(float value)
+{
+  const auto bits = std::bit_cast<uint32_t>(value);
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t abs = bits & 0x7FFFFFFFu;
+
+  // NaN stays NaN (quiet), values above half max become infinity
+  if (abs > 0x7F800000u) return sign | 0x7E00u;
+  if (abs >= 0x477FF000u) return sign | 0x7C00u;
+  // subnormal range - adding 0.5 aligns the mantissa with the half precision subnormal step
+  if (abs < 0x38800000u)
+    return sign | (std::bit_cast<uint32_t>(std::bit_cast<float>(abs) + 0.5f) - 0x3F000000u);
+  // rebias exponent (127 -> 15) and round mantissa from 23 to 10 bits
+  return sign | ((abs + 0xC8000FFFu + ((abs >> 13) & 1u)) >> 13);
+}
+
+inline uint16_t to_photon_count(float value)
+{
+  return static_cast<uint16_t>(std::clamp(value + 0.5f, 0.f, 65535.f));
+}
+
+} // namespace
+
 Converter::Converter(const parameters& g,
                      const parameters& p,
                      const utils::DetectorConfig& config,
                      int module_id)
-    : Converter(config, module_id)
+    : Converter(config, module_id, true)
 {
-  with_gains = true;
   test_gains_and_pedestals_consistency(g, p);
 
+  // for photon counts output the scaling by photon energy is folded into the gains
+  const auto scale = calculate_gain_scale(config.converted_output);
   for (auto i = 0u; i < N_GAINS; i++) {
-    gains_and_pedestals[i].reserve(g[i].size());
-    std::ranges::transform(g[i], p[i], std::back_inserter(gains_and_pedestals[i]),
-                           [](auto a, auto b) { return std::make_pair(a, b); });
+    own_gains_and_pedestals[i].reserve(g[i].size());
+    std::ranges::transform(g[i], p[i], std::back_inserter(own_gains_and_pedestals[i]),
+                           [scale](auto a, auto b) { return std::make_pair(a * scale, b); });
+    gains_and_pedestals[i] = own_gains_and_pedestals[i];
+  }
+}
+
+Converter::Converter(std::shared_ptr<const GainsAndPedestalsCache> c,
+                     const utils::DetectorConfig& config,
+                     int module_id)
+    : Converter(config, module_id, true)
+{
+  cache = std::move(c);
+  gains_and_pedestals = cache->table();
+
+  // scaled gains cannot be shared - the process needs its own copy of the table
+  if (const auto scale = calculate_gain_scale(config.converted_output); scale != 1.f) {
+    use_own_gains_and_pedestals();
+    for (auto& table : own_gains_and_pedestals)
+      for (auto& pair : table)
+        pair.first *= scale;
   }
 }
 
 Converter::Converter(const utils::DetectorConfig& config, int module_id)
-    : row_jump(config.image_pixel_width)
-    , start_index(calculate_start_index(config, module_id))
-    , with_gains(false)
+    : Converter(config, module_id, false)
+{
+  // summing raw values would mix gain bits into the ADC counts
+  if (geometry.binning_factor() > 1)
+    throw std::runtime_error("Binning is not supported for raw Jungfrau data!");
+}
+
+Converter::Converter(const utils::DetectorConfig& config, int module_id, bool with_gains)
+    : output_type(config.converted_output.type)
+    , geometry(config, module_id, MODULE_X_SIZE, MODULE_Y_SIZE)
+    , row_jump(config.image_pixel_width)
+    , with_gains(with_gains)
 {
   utils::test_if_module_is_inside_image(config, module_id);
-  test_if_module_size_fits_jungfrau(config, module_id);
 }
 
-void Converter::convert(std::span<const uint16_t> input, std::span<uint16_t> output)
+void Converter::convert(std::span<const uint16_t> input,
+                        std::span<uint16_t> output,
+                        bool dark_frame)
 {
-  if (with_gains)
-    convert_data(input, {(float*)output.data(), output.size() / sizeof(float) * sizeof(uint16_t)});
+  if (with_gains) {
+    convert_data(input, output);
+    if (pedestal_tracker && pedestal_tracker->process(input, dark_frame)) swap_g0_pedestals();
+  }
   else
     copy_raw_data(input, output);
 }
 
+void Converter::convert(const JFFrame& meta,
+                        std::span<const uint16_t> input,
+                        std::span<uint16_t> output)
+{
+  convert(input, output, (meta.daq_rec & dark_frame_bits) != 0);
+}
+
+void Converter::enable_pedestal_tracking(const pedestal_tracking_config& tracking)
+{
+  if (!with_gains)
+    throw std::runtime_error("Pedestal tracking requires converter with gains and pedestals!");
+  use_own_gains_and_pedestals();
+
+  std::vector<float> g0_pedestals;
+  g0_pedestals.reserve(gains_and_pedestals[0].size());
+  std::ranges::transform(gains_and_pedestals[0], std::back_inserter(g0_pedestals),
+                         [](const auto& p) { return p.second; });
+  pedestal_tracker.emplace(g0_pedestals, tracking);
+  dark_frame_bits = tracking.dark_frame_bits;
+}
+
+parameters Converter::pedestals() const
+{
+  parameters p;
+  for (auto i = 0u; i < N_GAINS; i++) {
+    p[i].reserve(gains_and_pedestals[i].size());
+    std::ranges::transform(gains_and_pedestals[i], std::back_inserter(p[i]),
+                           [](const auto& pair) { return pair.second; });
+  }
+  return p;
+}
+
+std::size_t Converter::pedestals_version() const
+{
+  return n_pedestal_swaps;
+}
+
+// conversion and tracking run on the same thread - the table is replaced between two frames
+void Converter::swap_g0_pedestals()
+{
+  const auto tracked = pedestal_tracker->pedestals();
+  for (auto i = 0u; i < tracked.size(); i++)
+    own_gains_and_pedestals[0][i].second = tracked[i];
+  n_pedestal_swaps++;
+}
+
+void Converter::use_own_gains_and_pedestals()
+{
+  if (!cache) return;
+  for (auto i = 0u; i < N_GAINS; i++) {
+    own_gains_and_pedestals[i].assign(gains_and_pedestals[i].begin(),
+                                      gains_and_pedestals[i].end());
+    gains_and_pedestals[i] = own_gains_and_pedestals[i];
+  }
+  cache.reset();
+}
+
 void Converter::copy_raw_data(std::span<const uint16_t> input,
                               std::span<uint16_t> output_buffer) const
 {
+  if (!geometry.is_row_aligned()) {
+    geometry.place(input.data(), output_buffer.data(), [](uint16_t v) { return v; });
+    return;
+  }
+
   for (auto row = 0u; row < MODULE_Y_SIZE; row++) {
     const auto input_start = row * MODULE_X_SIZE;
-    const auto output_start = (start_index + row * row_jump);
+    const auto output_start = (geometry.output_start() + row * row_jump);
     std::memcpy(output_buffer.data() + output_start, input.data() + input_start,
                 MODULE_X_SIZE * sizeof(uint16_t));
   }
 }
 
-void Converter::convert_data(std::span<const uint16_t> input_data, std::span<float> output_data)
+void Converter::convert_data(std::span<const uint16_t> input_data,
+                             std::span<uint16_t> output_buffer)
 {
   test_data_size_consistency(input_data);
-  convert(input_data, output_data);
+
+  switch (output_type) {
+  case utils::converted_output_config::float16:
+    convert(input_data, output_buffer, to_float16);
+    break;
+  case utils::converted_output_config::uint16:
+    convert(input_data, output_buffer, to_photon_count);
+    break;
+  default:
+    convert(input_data,
+            std::span<float>{(float*)output_buffer.data(),
+                             output_buffer.size() * sizeof(uint16_t) / sizeof(float)},
+            [](float value) { return value; });
+  }
 }
 
-void Converter::convert(std::span<const uint16_t> input_data, std::span<float> output_data)
+template <typename T, typename Store>
+void Converter::convert(std::span<const uint16_t> input_data, std::span<T> output_data, Store store)
+{
+  if (geometry.is_row_aligned()) {
+    convert_rows(input_data, output_data.data(), geometry.output_start(), row_jump, store);
+    return;
+  }
+
+  // energies are placed (and binned) before conversion to the output type
+  thread_local std::vector<float> module(MODULE_N_PIXELS);
+  convert_rows(input_data, module.data(), 0, MODULE_X_SIZE, [](float value) { return value; });
+  geometry.place(module.data(), output_data.data(), store);
+}
+
+template <typename T, typename Store>
+void Converter::convert_rows(std::span<const uint16_t> input_data,
+                             T* output,
+                             std::size_t start,
+                             std::size_t row_stride,
+                             Store store) const
 {
   for (auto i = 0u; i < MODULE_Y_SIZE; i++) {
     for (auto j = 0u; j < MODULE_X_SIZE; j++) {
       auto index = i * MODULE_X_SIZE + j;
       auto gain_group = (input_data[index] >> 14) % N_GAINS;
-      output_data[start_index + (i * row_jump) + j] =
-          ((input_data[index] & 0x3FFF) - gains_and_pedestals[gain_group][index].second) *
-          gains_and_pedestals[gain_group][index].first;
+      output[start + (i * row_stride) + j] =
+          store(((input_data[index] & 0x3FFF) - gains_and_pedestals[gain_group][index].second) *
+                gains_and_pedestals[gain_group][index].first);
     }
   }
 }
@@ -89,24 +243,13 @@ void Converter::test_gains_and_pedestals_consistency(const parameters& g, const
         fmt::format("Gains and pedestals have different size {} != {}!", g[0].size(), p[0].size()));
 }
 
-void Converter::test_if_module_size_fits_jungfrau(const utils::DetectorConfig& config,
-                                                  int module_id)
+float Converter::calculate_gain_scale(const utils::converted_output_config& output)
 {
-  const auto module_end = utils::get_module_end_position(config, module_id);
-  const auto module_start = utils::get_module_start_position(config, module_id);
-
-  if (auto diff = abs(module_start.x - module_end.x); diff != MODULE_X_SIZE - 1)
-    throw std::runtime_error(fmt::format(
-        "Jungfrau module width cannot be different than {} (set {})!", MODULE_X_SIZE - 1, diff));
-  if (auto diff = abs(module_start.y - module_end.y); diff != MODULE_Y_SIZE - 1)
+  if (output.type != utils::converted_output_config::uint16) return 1.f;
+  if (output.photon_energy_kev <= 0.f)
     throw std::runtime_error(fmt::format(
-        "Jungfrau module height cannot be different than {} (set {})!", MODULE_Y_SIZE - 1, diff));
-}
-
-std::size_t Converter::calculate_start_index(const utils::DetectorConfig& config, int module_id)
-{
-  const auto start_position = utils::get_module_start_position(config, module_id);
-  return (config.image_pixel_width * start_position.y) + start_position.x;
+        "Photon counts output requires positive photon energy (set {})!", output.photon_energy_kev));
+  return 1.f / output.photon_energy_kev;
 }
 
 } // namespace jf::sdc
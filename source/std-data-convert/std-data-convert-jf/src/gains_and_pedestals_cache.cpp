@@ -0,0 +1,248 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "gains_and_pedestals_cache.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <source_location>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "detectors/jungfrau.hpp"
+#include "read_gains_and_pedestals.hpp"
+
+namespace jf::sdc {
+namespace {
+
+constexpr char cache_magic[8] = {'S', 'D', 'C', 'J', 'F', 'G', 'P', '1'};
+// payload starts at page boundary so that the table is aligned for vector loads
+constexpr std::size_t payload_offset = 4096;
+
+struct cache_header
+{
+  char magic[8];
+  uint64_t n_pixels;
+  uint64_t source_size;
+  int64_t source_mtime_ns;
+  uint64_t checksum;
+};
+static_assert(sizeof(cache_header) <= payload_offset);
+
+struct source_stamp
+{
+  uint64_t size;
+  int64_t mtime_ns;
+};
+
+source_stamp get_source_stamp(const std::string& filename)
+{
+  struct stat st = {};
+  if (stat(filename.c_str(), &st) != 0)
+    throw std::runtime_error(fmt::format("Cannot stat {}: {}", filename, strerror(errno)));
+  return {static_cast<uint64_t>(st.st_size),
+          static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+}
+
+// FNV-1a over 64-bit words - payload is always made of 8 byte (gain, pedestal) pairs
+uint64_t calculate_checksum(std::span<const std::pair<float, float>> payload)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const auto& pair : payload) {
+    uint64_t word;
+    std::memcpy(&word, &pair, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::span<const std::pair<float, float>> payload_of(const void* mapping, std::size_t n_pixels)
+{
+  return {reinterpret_cast<const std::pair<float, float>*>(static_cast<const char*>(mapping) +
+                                                           payload_offset),
+          N_GAINS * n_pixels};
+}
+
+std::size_t mapping_size_of(std::size_t n_pixels)
+{
+  return payload_offset + N_GAINS * n_pixels * sizeof(std::pair<float, float>);
+}
+
+// calibration file of the whole detector holds modules one after another
+parameters module_slice(const parameters& params, int module_id, const std::string& filename)
+{
+  const auto n_pixels = params[0].size();
+  std::size_t offset = 0;
+  if (n_pixels > MODULE_N_PIXELS) {
+    offset = static_cast<std::size_t>(module_id) * MODULE_N_PIXELS;
+    if (offset + MODULE_N_PIXELS > n_pixels)
+      throw std::runtime_error(
+          fmt::format("{} holds {} pixels per gain - no module {}", filename, n_pixels, module_id));
+  }
+
+  parameters slice;
+  const auto size = std::min<std::size_t>(n_pixels - offset, MODULE_N_PIXELS);
+  for (auto i = 0u; i < N_GAINS; i++)
+    slice[i].assign(params[i].begin() + offset, params[i].begin() + offset + size);
+  return slice;
+}
+
+void write_cache(int fd,
+                 const parameters& gains,
+                 const parameters& pedestals,
+                 const source_stamp& stamp)
+{
+  const auto n_pixels = gains[0].size();
+
+  std::vector<std::pair<float, float>> payload;
+  payload.reserve(N_GAINS * n_pixels);
+  for (auto i = 0u; i < N_GAINS; i++)
+    for (auto j = 0u; j < n_pixels; j++)
+      payload.emplace_back(gains[i][j], pedestals[i][j]);
+
+  std::vector<char> header_block(payload_offset);
+  cache_header header{{}, n_pixels, stamp.size, stamp.mtime_ns, calculate_checksum(payload)};
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  std::memcpy(header_block.data(), &header, sizeof(header));
+
+  const auto payload_bytes = payload.size() * sizeof(std::pair<float, float>);
+  if (write(fd, header_block.data(), payload_offset) != static_cast<ssize_t>(payload_offset) ||
+      write(fd, payload.data(), payload_bytes) != static_cast<ssize_t>(payload_bytes))
+    throw std::runtime_error(fmt::format("Cannot write gains and pedestals cache: {}",
+                                         strerror(errno)));
+}
+
+void write_cache_file(const std::string& cache_filename,
+                      const parameters& gains,
+                      const parameters& pedestals,
+                      const source_stamp& stamp)
+{
+  // written aside and renamed so that concurrently starting converters never map partial file
+  const auto tmp_filename = fmt::format("{}.{}.tmp", cache_filename, getpid());
+  const int fd = open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw std::runtime_error(fmt::format("Cannot create {}: {}", tmp_filename, strerror(errno)));
+
+  try {
+    write_cache(fd, gains, pedestals, stamp);
+  }
+  catch (const std::runtime_error&) {
+    close(fd);
+    std::filesystem::remove(tmp_filename);
+    throw;
+  }
+  close(fd);
+  std::filesystem::rename(tmp_filename, cache_filename);
+}
+
+} // namespace
+
+GainsAndPedestalsCache::GainsAndPedestalsCache(void* mapping, std::size_t mapping_size)
+    : mapping(mapping)
+    , mapping_size(mapping_size)
+{}
+
+GainsAndPedestalsCache::~GainsAndPedestalsCache()
+{
+  munmap(mapping, mapping_size);
+}
+
+std::shared_ptr<const GainsAndPedestalsCache> GainsAndPedestalsCache::load(
+    const std::string& filename, std::size_t image_size, int module_id)
+{
+  spdlog::debug("{}: filename: {}, image_size: {}, module_id: {}",
+                std::source_location::current().function_name(), filename, image_size, module_id);
+
+  const auto cache_filename = fmt::format("{}.{}.cache", filename, module_id);
+  const auto stamp = get_source_stamp(filename);
+
+  auto map_cache = [&stamp](int fd) -> std::shared_ptr<const GainsAndPedestalsCache> {
+    struct stat st = {};
+    cache_header header = {};
+    if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        static_cast<std::size_t>(st.st_size) != mapping_size_of(header.n_pixels))
+      return nullptr;
+
+    const auto size = mapping_size_of(header.n_pixels);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<const GainsAndPedestalsCache> cache(new GainsAndPedestalsCache(mapping, size));
+    if (header.source_size != stamp.size || header.source_mtime_ns != stamp.mtime_ns ||
+        header.checksum != calculate_checksum(payload_of(mapping, header.n_pixels)))
+      return nullptr;
+    return cache;
+  };
+
+  auto map_cache_file = [&]() -> std::shared_ptr<const GainsAndPedestalsCache> {
+    const int fd = open(cache_filename.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    auto cache = map_cache(fd);
+    close(fd);
+    return cache;
+  };
+
+  if (auto cache = map_cache_file()) return cache;
+
+  spdlog::info("Building gains and pedestals cache {}", cache_filename);
+  const auto [all_gains, all_pedestals] = read_gains_and_pedestals(filename, image_size);
+  const auto gains = module_slice(all_gains, module_id, filename);
+  const auto pedestals = module_slice(all_pedestals, module_id, filename);
+  try {
+    write_cache_file(cache_filename, gains, pedestals, stamp);
+    if (auto cache = map_cache_file()) return cache;
+  }
+  catch (const std::exception& e) {
+    spdlog::warn("Cannot store gains and pedestals cache: {}", e.what());
+  }
+
+  // calibration directory is not writable - keep private in-memory copy of the cache
+  const int fd = memfd_create("jf-gains-and-pedestals", 0);
+  if (fd < 0) throw std::runtime_error(fmt::format("memfd_create failed: {}", strerror(errno)));
+  std::shared_ptr<const GainsAndPedestalsCache> cache;
+  try {
+    write_cache(fd, gains, pedestals, stamp);
+    cache = map_cache(fd);
+  }
+  catch (const std::runtime_error&) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+  if (!cache) throw std::runtime_error("Cannot map in-memory gains and pedestals cache");
+  return cache;
+}
+
+parameters_pairs_view GainsAndPedestalsCache::table() const
+{
+  const auto n_pixels = static_cast<const cache_header*>(mapping)->n_pixels;
+  const auto payload = payload_of(mapping, n_pixels);
+
+  parameters_pairs_view view;
+  for (auto i = 0u; i < N_GAINS; i++)
+    view[i] = payload.subspan(i * n_pixels, n_pixels);
+  return view;
+}
+
+parameters GainsAndPedestalsCache::gains() const
+{
+  parameters g;
+  const auto view = table();
+  for (auto i = 0u; i < N_GAINS; i++) {
+    g[i].reserve(view[i].size());
+    std::ranges::transform(view[i], std::back_inserter(g[i]), [](auto p) { return p.first; });
+  }
+  return g;
+}
+
+} // namespace jf::sdc
@@ -2,6 +2,9 @@
 // Copyright (c) 2022 Paul Scherrer Institute. All rights reserved.
 /////////////////////////////////////////////////////////////////////
 
+#include <mutex>
+#include <thread>
+
 #include <zmq.h>
 
 #include "core_buffer/buffer_config.hpp"
@@ -10,6 +13,7 @@
 #include "utils/utils.hpp"
 
 #include "converter.hpp"
+#include "multi_module_converter.hpp"
 #include "read_gains_and_pedestals.hpp"
 
 using namespace std::string_literals;
@@ -19,38 +23,94 @@ auto read_arguments(int argc, char* argv[])
 {
   auto program = utils::create_parser("std_data_convert_jf");
   program->add_argument("-g", "--gains_and_pedestals")
-      .help("gains and pedestals filename")
+      .help("gains and pedestals filename ('{}' is replaced by module id with --all_modules)")
+      .default_value(""s);
+  program->add_argument("--pedestal_tracking_threshold")
+      .help("raw ADC threshold below which G0 pixels update pedestals (0 disables tracking)")
+      .scan<'g', float>()
+      .default_value(0.f);
+  program->add_argument("--pedestal_tracking_window")
+      .help("number of frames averaged by running mean of tracked pedestals")
+      .scan<'u', std::size_t>()
+      .default_value(1000ul);
+  program->add_argument("--pedestal_tracking_swap_period")
+      .help("number of frames after which tracked pedestals are used for conversion")
+      .scan<'u', std::size_t>()
+      .default_value(10000ul);
+  program->add_argument("--pedestal_tracking_dark_frame_bits")
+      .help("daq_rec bits marking frames without beam - all their G0 pixels update pedestals")
+      .scan<'i', uint64_t>()
+      .default_value(uint64_t{0});
+  program->add_argument("--pedestal_dump")
+      .help("filename where gains and tracked pedestals are dumped after each swap")
       .default_value(""s);
-  program->add_argument("module_id").scan<'d', uint16_t>();
+  program->add_argument("--all_modules")
+      .help("convert all modules of the detector in this process instead of single module_id")
+      .default_value(false)
+      .implicit_value(true);
+  program->add_argument("--n_workers")
+      .help("number of conversion threads used with --all_modules (0 - one per module)")
+      .scan<'u', std::size_t>()
+      .default_value(0ul);
+  program->add_argument("--compression")
+      .help("compress modules right after conversion with --all_modules: none, h5bitshuffle-lz4, "
+            "blosc2")
+      .default_value("none"s);
+  program->add_argument("--compression_level")
+      .help("compression level used by blosc2")
+      .scan<'d', int>()
+      .default_value(5);
+  program->add_argument("module_id").scan<'d', uint16_t>().default_value(uint16_t{0});
   return utils::parse_arguments(std::move(program), argc, argv);
 }
 
-jf::sdc::Converter create_converter(const std::string& filename,
-                                    const utils::DetectorConfig& config,
-                                    int module_id)
+std::tuple<jf::sdc::Converter, std::shared_ptr<const jf::sdc::GainsAndPedestalsCache>>
+create_converter(const std::string& filename, const utils::DetectorConfig& config, int module_id)
 {
   if (filename.empty() && config.detector_type == "jungfrau-converted")
     throw std::runtime_error(
         "jungfrau-converted detector type requires valid gains and pedestals filename!");
 
-  if (filename.empty()) return jf::sdc::Converter{config, module_id};
+  if (filename.empty()) return {jf::sdc::Converter{config, module_id}, nullptr};
+
+  const auto start = std::chrono::steady_clock::now();
+  auto cache = jf::sdc::GainsAndPedestalsCache::load(
+      filename, config.image_pixel_height * config.image_pixel_width, module_id);
+  auto converter = jf::sdc::Converter{cache, config, module_id};
+  spdlog::info("Gains and pedestals loaded in {} ms",
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count());
+  return {std::move(converter), std::move(cache)};
+}
 
-  const auto [gains, pedestals] = jf::sdc::read_gains_and_pedestals(
-      filename, config.image_pixel_height * config.image_pixel_width);
-  return jf::sdc::Converter{gains, pedestals, config, module_id};
+void setup_pedestal_tracking(jf::sdc::Converter& converter, const argparse::ArgumentParser& parser)
+{
+  const auto threshold = parser.get<float>("--pedestal_tracking_threshold");
+  if (threshold <= 0.f) return;
+
+  converter.enable_pedestal_tracking(
+      {threshold, parser.get<std::size_t>("--pedestal_tracking_window"),
+       parser.get<std::size_t>("--pedestal_tracking_swap_period"),
+       parser.get<uint64_t>("--pedestal_tracking_dark_frame_bits")});
+  spdlog::info("Pedestal tracking enabled with threshold={}", threshold);
 }
 
-int main(int argc, char* argv[])
+void run_single_module(const utils::DetectorConfig& config, const argparse::ArgumentParser& parser)
 {
-  auto parser = read_arguments(argc, argv);
+  if (parser.get("--compression") != "none")
+    throw std::invalid_argument("--compression requires --all_modules!");
 
-  const auto config = utils::read_config_from_json_file(parser->get("detector_json_filename"));
-  [[maybe_unused]] utils::log::logger l{"std_data_convert_jf", config.log_level};
-  const auto module_id = parser->get<uint16_t>("module_id");
+  const auto module_id = parser.get<uint16_t>("module_id");
   utils::stats::ModuleStatsCollector stats_collector(config.detector_name,
                                                      config.stats_collection_period, module_id);
 
-  auto converter = create_converter(parser->get("--gains_and_pedestals"), config, module_id);
+  auto [converter, calibration] =
+      create_converter(parser.get("--gains_and_pedestals"), config, module_id);
+  setup_pedestal_tracking(converter, parser);
+  const auto pedestal_dump_filename = parser.get("--pedestal_dump");
+  auto dumped_pedestals_version = converter.pedestals_version();
+  std::jthread pedestal_dump;
 
   auto ctx = zmq_ctx_new();
 
@@ -73,12 +133,88 @@ int main(int argc, char* argv[])
     auto [id, image] = receiver.receive(std::span<char>((char*)&meta, sizeof(meta)));
     if (id != INVALID_IMAGE_ID) {
       auto data = sender.get_data(id);
-      converter.convert({(uint16_t*)image, MODULE_N_PIXELS},
+      converter.convert(meta, {(uint16_t*)image, MODULE_N_PIXELS},
                         {(uint16_t*)data, converted_bytes / sizeof(uint16_t)});
       sender.send(id, std::span<char>((char*)&meta, sizeof(meta)), nullptr);
       stats_collector.process();
+
+      if (!pedestal_dump_filename.empty() &&
+          dumped_pedestals_version != converter.pedestals_version())
+      {
+        dumped_pedestals_version = converter.pedestals_version();
+        // writing the file is slow - it must not hold back the conversion
+        if (pedestal_dump.joinable()) pedestal_dump.join();
+        pedestal_dump = std::jthread([&, pedestals = converter.pedestals()] {
+          try {
+            jf::sdc::write_gains_and_pedestals(pedestal_dump_filename, calibration->gains(),
+                                               pedestals);
+          }
+          catch (const std::exception& e) {
+            spdlog::error("Failed to dump pedestals: {}", e.what());
+          }
+        });
+      }
     }
     stats_collector.print_stats();
   }
+}
+
+void run_all_modules(const utils::DetectorConfig& config, const argparse::ArgumentParser& parser)
+{
+  if (!parser.get("--pedestal_dump").empty())
+    throw std::invalid_argument("--pedestal_dump is not supported together with --all_modules!");
+
+  struct module_converter
+  {
+    jf::sdc::Converter converter;
+    std::shared_ptr<const jf::sdc::GainsAndPedestalsCache> calibration;
+    std::mutex mutex;
+  };
+
+  const auto modules = convert::get_active_modules(config);
+  std::vector<std::unique_ptr<module_converter>> converters(config.n_modules);
+  for (const auto module_id : modules) {
+    const auto filename = fmt::format(fmt::runtime(parser.get("--gains_and_pedestals")), module_id);
+    auto [converter, calibration] = create_converter(filename, config, module_id);
+    setup_pedestal_tracking(converter, parser);
+    converters[module_id] =
+        std::make_unique<module_converter>(std::move(converter), std::move(calibration));
+  }
+
+  // tracked pedestals are updated by conversion - frames of single module must not run in parallel
+  const bool serialize_modules = parser.get<float>("--pedestal_tracking_threshold") > 0.f;
+  const size_t converted_n_pixels = utils::converted_image_n_bytes(config) / sizeof(uint16_t);
+  const auto n_workers = parser.get<std::size_t>("--n_workers");
+
+  auto ctx = zmq_ctx_new();
+  convert::MultiModuleConverter<JFFrame> converter(
+      config, ctx, modules, MODULE_N_PIXELS * config.bit_depth / 8,
+      n_workers == 0 ? modules.size() : n_workers,
+      [&](const JFFrame& meta, char* input, char* output) {
+        auto& module = *converters[meta.common.module_id % config.n_modules];
+        std::unique_lock<std::mutex> lock(module.mutex, std::defer_lock);
+        if (serialize_modules) lock.lock();
+        module.converter.convert(meta, {(uint16_t*)input, MODULE_N_PIXELS},
+                                 {(uint16_t*)output, converted_n_pixels});
+      });
+  if (const auto compression = parser.get("--compression"); compression != "none")
+    converter.enable_compression(config, ctx,
+                                 std::make_unique<convert::ModuleChunkCompressor>(
+                                     config, convert::ModuleChunkCompressor::to_codec(compression),
+                                     parser.get<int>("--compression_level")));
+  converter.run();
+}
+
+int main(int argc, char* argv[])
+{
+  auto parser = read_arguments(argc, argv);
+
+  const auto config = utils::read_config_from_json_file(parser->get("detector_json_filename"));
+  [[maybe_unused]] utils::log::logger l{"std_data_convert_jf", config.log_level};
+
+  if (parser->get<bool>("--all_modules"))
+    run_all_modules(config, *parser);
+  else
+    run_single_module(config, *parser);
   return 0;
 }
@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "pedestal_tracker.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+namespace jf::sdc {
+namespace {
+
+const pedestal_tracking_config& validate(const pedestal_tracking_config& config)
+{
+  if (config.window == 0 || config.swap_period == 0)
+    throw std::invalid_argument(
+        fmt::format("Pedestal tracking window ({}) and swap period ({}) must be positive!",
+                    config.window, config.swap_period));
+  return config;
+}
+
+} // namespace
+
+PedestalTracker::PedestalTracker(std::span<const float> initial_pedestals,
+                                 const pedestal_tracking_config& config)
+    : accumulator(initial_pedestals.begin(), initial_pedestals.end())
+    , threshold(validate(config).threshold)
+    , alpha(1.f / static_cast<float>(config.window))
+    , swap_period(config.swap_period)
+    , n_frames(0)
+{}
+
+bool PedestalTracker::process(std::span<const uint16_t> frame, bool dark_frame)
+{
+  const auto n_pixels = std::min(frame.size(), accumulator.size());
+  // local copies - members could alias accumulator and prevent vectorization
+  const auto limit = dark_frame ? std::numeric_limits<float>::max() : threshold;
+  const auto weight = alpha;
+  const uint16_t* raw = frame.data();
+  float* pedestals = accumulator.data();
+
+  // exponential running mean over pixels in G0 that were not hit by photons
+  for (std::size_t i = 0; i < n_pixels; i++) {
+    const float delta = static_cast<float>(raw[i] & 0x3FFF) - pedestals[i];
+    const float update = (raw[i] < 0x4000 && delta < limit) ? weight : 0.f;
+    pedestals[i] += delta * update;
+  }
+  return ++n_frames % swap_period == 0;
+}
+
+std::span<const float> PedestalTracker::pedestals() const
+{
+  return accumulator;
+}
+
+} // namespace jf::sdc
@@ -4,10 +4,13 @@
 
 #include "read_gains_and_pedestals.hpp"
 
+#include <algorithm>
+#include <filesystem>
 #include <memory>
 #include <source_location>
 
 #include <hdf5.h>
+#include <fmt/core.h>
 #include <spdlog/spdlog.h>
 
 namespace jf::sdc {
@@ -15,21 +18,55 @@ namespace {
 
 parameters decode_parameters(hid_t file_id, const std::string& id, std::size_t image_size)
 {
-  std::unique_ptr<double> data(new double[N_GAINS * image_size]);
-
   hid_t dataset_id = H5Dopen2(file_id, id.c_str(), H5P_DEFAULT);
+  if (dataset_id < 0) throw std::runtime_error(fmt::format("Cannot open dataset {}!", id));
+
+  // per gain stride follows the file - dumped tables hold only the pixels of single module
+  hid_t space_id = H5Dget_space(dataset_id);
+  const auto n_elements = static_cast<std::size_t>(H5Sget_simple_extent_npoints(space_id));
+  H5Sclose(space_id);
+  const auto stride = n_elements / N_GAINS;
+  const auto size = std::min(image_size, stride);
+
+  std::unique_ptr<double[]> data(new double[n_elements]);
   H5Dread(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.get());
   H5Dclose(dataset_id);
 
   parameters params;
   for (auto i = 0u; i < N_GAINS; i++) {
-    params[i].reserve(image_size);
-    for (auto j = 0u; j < image_size; j++)
-      params[i].emplace_back(static_cast<float>(data.get()[i * image_size + j]));
+    params[i].reserve(size);
+    for (auto j = 0u; j < size; j++)
+      params[i].emplace_back(static_cast<float>(data[i * stride + j]));
   }
   return params;
 }
 
+void encode_parameters(hid_t file_id, const std::string& id, const parameters& params)
+{
+  const auto image_size = params[0].size();
+  std::unique_ptr<double[]> data(new double[N_GAINS * image_size]);
+  for (auto i = 0u; i < N_GAINS; i++)
+    std::ranges::copy(params[i], data.get() + i * image_size);
+
+  hsize_t dims[2] = {N_GAINS, image_size};
+  hid_t space_id = H5Screate_simple(2, dims, nullptr);
+  hid_t dataset_id = H5Dcreate2(file_id, id.c_str(), H5T_NATIVE_DOUBLE, space_id, H5P_DEFAULT,
+                                H5P_DEFAULT, H5P_DEFAULT);
+  const auto status =
+      H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.get());
+  H5Dclose(dataset_id);
+  H5Sclose(space_id);
+
+  if (dataset_id < 0 || status < 0)
+    throw std::runtime_error(fmt::format("Cannot write dataset {}!", id));
+}
+
+// older calibration files keep pedestals in the dataset called gainsRMS
+std::string pedestals_dataset(hid_t file_id)
+{
+  return H5Lexists(file_id, "/pedestals", H5P_DEFAULT) > 0 ? "/pedestals" : "/gainsRMS";
+}
+
 } // namespace
 
 std::tuple<parameters, parameters> read_gains_and_pedestals(const std::string& filename,
@@ -40,9 +77,27 @@ std::tuple<parameters, parameters> read_gains_and_pedestals(const std::string& f
 
   hid_t file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   auto gains = decode_parameters(file_id, "/gains", image_size);
-  auto pedestals = decode_parameters(file_id, "/gainsRMS", image_size);
+  auto pedestals = decode_parameters(file_id, pedestals_dataset(file_id), image_size);
   H5Fclose(file_id);
 
   return {gains, pedestals};
 }
+
+void write_gains_and_pedestals(const std::string& filename,
+                               const parameters& gains,
+                               const parameters& pedestals)
+{
+  spdlog::debug("{}: filename: {}", std::source_location::current().function_name(), filename);
+
+  // written aside and renamed so that readers never see partially written file
+  const auto tmp_filename = filename + ".tmp";
+  hid_t file_id = H5Fcreate(tmp_filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file_id < 0) throw std::runtime_error(fmt::format("Cannot create file {}!", tmp_filename));
+
+  encode_parameters(file_id, "/gains", gains);
+  encode_parameters(file_id, "/pedestals", pedestals);
+  H5Fclose(file_id);
+
+  std::filesystem::rename(tmp_filename, filename);
+}
 } // namespace jf::sdc
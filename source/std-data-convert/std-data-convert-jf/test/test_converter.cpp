@@ -26,29 +26,35 @@ jf::sdc::parameters prepare_params(float default_value = 0)
                              std::vector(data_elements, default_value)};
 }
 
-utils::DetectorConfig config{"jf",
-                             "jungfrau-converted",
-                             4,
-                             16,
-                             2 * MODULE_Y_SIZE,
-                             2 * MODULE_X_SIZE,
-                             0,
-                             "debug",
-                             std::chrono::seconds(30),
-                             8,
-                             false,
-                             16777216,
-                             false,
-                             50,
-                             0,
-                             1000,
-                             std::chrono::seconds(30),
-                             false,
-                             {},
-                             {{0, {{0, 0}, {1023, 511}}},
-                              {1, {{0, 512}, {1023, 1023}}},
-                              {2, {{1024, 0}, {2047, 511}}},
-                              {3, {{1024, 512}, {2047, 1023}}}}};
+utils::DetectorConfig create_config(utils::converted_output_config output = {})
+{
+  return {"jf",
+          "jungfrau-converted",
+          4,
+          16,
+          2 * MODULE_Y_SIZE,
+          2 * MODULE_X_SIZE,
+          0,
+          "debug",
+          std::chrono::seconds(30),
+          8,
+          false,
+          16777216,
+          false,
+          50,
+          0,
+          1000,
+          std::chrono::seconds(30),
+          false,
+          {},
+          {{0, {{0, 0}, {1023, 511}}},
+           {1, {{0, 512}, {1023, 1023}}},
+           {2, {{1024, 0}, {2047, 511}}},
+           {3, {{1024, 512}, {2047, 1023}}}},
+          output};
+}
+
+const utils::DetectorConfig config = create_config();
 
 } // namespace
 
@@ -128,3 +134,142 @@ TEST(ConverterJf, ShouldCalculateValuesUsingGainAndPedestalForModule3)
     EXPECT_TRUE(equal(expected_line, output_line));
   }
 }
+
+TEST(ConverterJf, ShouldOutputHalfPrecisionFloats)
+{
+  const auto half_config = create_config({utils::converted_output_config::float16, 0.f});
+  jf::sdc::Converter converter{prepare_params(0.5f), prepare_params(-1), half_config, 0};
+  std::vector<uint16_t> output(half_config.image_pixel_width * half_config.image_pixel_height);
+
+  converter.convert(iota_data, output);
+  // 0.5 * (0 + 1) = 0.5, 0.5 * (1 + 1) = 1.0, 0.5 * (2 + 1) = 1.5, 0.5 * (1023 + 1) = 512
+  EXPECT_EQ(0x3800, output[0]);
+  EXPECT_EQ(0x3C00, output[1]);
+  EXPECT_EQ(0x3E00, output[2]);
+  EXPECT_EQ(0x6000, output[1023]);
+  // 0.5 * (2 + 1) in second row of the module
+  EXPECT_EQ(0x3E00, output[2 * MODULE_X_SIZE + 2]);
+}
+
+TEST(ConverterJf, ShouldOutputRoundedPhotonCounts)
+{
+  const auto photon_config = create_config({utils::converted_output_config::uint16, 4.f});
+  jf::sdc::Converter converter{prepare_params(1), prepare_params(0), photon_config, 3};
+  std::vector<uint16_t> output(photon_config.image_pixel_width * photon_config.image_pixel_height);
+
+  converter.convert(iota_data, output);
+  for (auto i = 0u; i < MODULE_Y_SIZE; i++) {
+    const auto expected_line =
+        iota_data | views::drop(i * MODULE_X_SIZE) | views::take(MODULE_X_SIZE) |
+        views::transform([](auto a) { return static_cast<uint16_t>((a + 2) / 4); });
+    const auto output_line = output |
+                             views::drop((MODULE_Y_SIZE + i) * MODULE_X_SIZE * 2 + MODULE_X_SIZE) |
+                             views::take(MODULE_X_SIZE);
+    EXPECT_TRUE(equal(expected_line, output_line));
+  }
+}
+
+TEST(ConverterJf, ShouldClampNegativePhotonCountsToZero)
+{
+  const auto photon_config = create_config({utils::converted_output_config::uint16, 1.f});
+  jf::sdc::Converter converter{prepare_params(1), prepare_params(2000), photon_config, 0};
+  std::vector<uint16_t> output(photon_config.image_pixel_width * photon_config.image_pixel_height);
+
+  converter.convert(iota_data, output);
+  EXPECT_EQ(0, output[0]);
+  EXPECT_EQ(0, output[MODULE_X_SIZE - 1]);
+}
+
+TEST(ConverterJf, ShouldThrowForPhotonCountsWithoutPhotonEnergy)
+{
+  const auto photon_config = create_config({utils::converted_output_config::uint16, 0.f});
+  EXPECT_THROW((jf::sdc::Converter{prepare_params(1), prepare_params(0), photon_config, 0}),
+               std::runtime_error);
+}
+
+TEST(ConverterJf, ShouldUseTrackedPedestalsAfterSwapPeriod)
+{
+  jf::sdc::Converter converter{prepare_params(1), prepare_params(0), config, 0};
+  converter.enable_pedestal_tracking({20000.f, 1, 2});
+  std::vector<float> output(config.image_pixel_width * config.image_pixel_height);
+  std::span output_as_uints{(uint16_t*)output.data(), output.size() / 2};
+
+  converter.convert(iota_data, output_as_uints);
+  EXPECT_EQ(0u, converter.pedestals_version());
+  EXPECT_FLOAT_EQ(1023.f, output[1023]);
+
+  converter.convert(iota_data, output_as_uints);
+  EXPECT_EQ(1u, converter.pedestals_version());
+  EXPECT_FLOAT_EQ(1023.f, converter.pedestals()[0][1023]);
+  EXPECT_FLOAT_EQ(0.f, converter.pedestals()[1][1023]);
+
+  converter.convert(iota_data, output_as_uints);
+  for (auto i = 0u; i < MODULE_Y_SIZE; i++)
+    for (auto j = 0u; j < MODULE_X_SIZE; j++)
+      ASSERT_FLOAT_EQ(0.f, output[i * config.image_pixel_width + j]);
+}
+
+TEST(ConverterJf, ShouldTrackAllG0PixelsOfFramesMarkedDarkByDaqRec)
+{
+  jf::sdc::Converter converter{prepare_params(1), prepare_params(0), config, 0};
+  converter.enable_pedestal_tracking({1.f, 1, 1, 0x4});
+  std::vector<float> output(config.image_pixel_width * config.image_pixel_height);
+  std::span output_as_uints{(uint16_t*)output.data(), output.size() / 2};
+  JFFrame meta{};
+
+  meta.daq_rec = 0x3;
+  converter.convert(meta, iota_data, output_as_uints);
+  EXPECT_FLOAT_EQ(0.f, converter.pedestals()[0][1023]);
+
+  meta.daq_rec = 0x5;
+  converter.convert(meta, iota_data, output_as_uints);
+  EXPECT_FLOAT_EQ(1023.f, converter.pedestals()[0][1023]);
+}
+
+TEST(ConverterJf, ShouldThrowWhenTrackingPedestalsOfRawData)
+{
+  jf::sdc::Converter converter{config, 0};
+  EXPECT_THROW(converter.enable_pedestal_tracking({10.f, 1, 1}), std::runtime_error);
+}
+
+TEST(ConverterJf, ShouldPlaceModuleRotatedBy180Degrees)
+{
+  const utils::DetectorConfig rotated{
+      "jf", "jungfrau-converted", 1, 16, MODULE_Y_SIZE, MODULE_X_SIZE, 0, "debug",
+      std::chrono::seconds(30), 8, false, 16777216, false, 50, 0, 1000, std::chrono::seconds(30),
+      false, {}, {{0, {{1023, 511}, {0, 0}}}}};
+  jf::sdc::Converter converter{prepare_params(1), prepare_params(0), rotated, 0};
+  std::vector<float> output(MODULE_N_PIXELS);
+  std::span output_as_uints{(uint16_t*)output.data(), output.size() * 2};
+
+  converter.convert(iota_data, output_as_uints);
+  for (auto i = 0u; i < MODULE_N_PIXELS; i++)
+    ASSERT_FLOAT_EQ(iota_data[MODULE_N_PIXELS - 1 - i], output[i]);
+}
+
+TEST(ConverterJf, ShouldThrowWhenBinningRawData)
+{
+  const utils::DetectorConfig binned{
+      "jf", "jungfrau-converted", 1, 16, MODULE_Y_SIZE / 2, MODULE_X_SIZE / 2, 0, "debug",
+      std::chrono::seconds(30), 8, false, 16777216, false, 50, 0, 1000, std::chrono::seconds(30),
+      false, {}, {{0, {{0, 0}, {511, 255}}}}, {}, utils::gap_pixels_mode::keep, 2};
+  EXPECT_THROW((jf::sdc::Converter{binned, 0}), std::runtime_error);
+}
+
+TEST(ConverterJf, ShouldSumEnergiesOfBinnedPixels)
+{
+  const utils::DetectorConfig binned{
+      "jf", "jungfrau-converted", 1, 16, MODULE_Y_SIZE / 2, MODULE_X_SIZE / 2, 0, "debug",
+      std::chrono::seconds(30), 8, false, 16777216, false, 50, 0, 1000, std::chrono::seconds(30),
+      false, {}, {{0, {{0, 0}, {511, 255}}}}, {}, utils::gap_pixels_mode::keep, 2};
+  jf::sdc::Converter converter{prepare_params(1), prepare_params(0), binned, 0};
+  std::vector<float> output(MODULE_N_PIXELS / 4);
+  std::span output_as_uints{(uint16_t*)output.data(), output.size() * 2};
+
+  converter.convert(iota_data, output_as_uints);
+  // pixels 0, 1, 1024 and 1025 of the module - iota data repeats every 1024 pixels
+  EXPECT_FLOAT_EQ(0.f + 1.f + 0.f + 1.f, output[0]);
+  EXPECT_FLOAT_EQ(2.f + 3.f + 2.f + 3.f, output[1]);
+  EXPECT_THROW((jf::sdc::Converter{binned, 0}.convert(iota_data, output_as_uints)),
+               std::runtime_error);
+}
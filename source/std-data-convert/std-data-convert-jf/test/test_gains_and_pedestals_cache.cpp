@@ -0,0 +1,122 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "gains_and_pedestals_cache.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "detectors/jungfrau.hpp"
+#include "read_gains_and_pedestals.hpp"
+
+using namespace jf::sdc;
+namespace fs = std::filesystem;
+
+namespace {
+constexpr std::size_t n_pixels = 64;
+
+parameters prepare_params(float offset)
+{
+  parameters p;
+  for (auto i = 0u; i < N_GAINS; i++)
+    for (auto j = 0u; j < n_pixels; j++)
+      p[i].push_back(offset + static_cast<float>(i * n_pixels + j));
+  return p;
+}
+
+class GainsAndPedestalsCacheJf : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto seed = ::testing::UnitTest::GetInstance()->random_seed();
+    directory = fs::temp_directory_path() / ("sdc_jf_cache_" + std::to_string(seed));
+    fs::create_directories(directory);
+    filename = (directory / "gains_and_pedestals.h5").string();
+    write_gains_and_pedestals(filename, prepare_params(1.f), prepare_params(-1.f));
+  }
+  void TearDown() override { fs::remove_all(directory); }
+
+  fs::path directory;
+  std::string filename;
+};
+
+} // namespace
+
+TEST_F(GainsAndPedestalsCacheJf, ShouldBuildCacheFromCalibrationFile)
+{
+  const auto cache = GainsAndPedestalsCache::load(filename, n_pixels, 0);
+
+  EXPECT_TRUE(fs::exists(filename + ".0.cache"));
+  const auto table = cache->table();
+  for (auto i = 0u; i < N_GAINS; i++) {
+    ASSERT_EQ(n_pixels, table[i].size());
+    for (auto j = 0u; j < n_pixels; j++) {
+      EXPECT_FLOAT_EQ(1.f + static_cast<float>(i * n_pixels + j), table[i][j].first);
+      EXPECT_FLOAT_EQ(-1.f + static_cast<float>(i * n_pixels + j), table[i][j].second);
+    }
+  }
+  EXPECT_EQ(prepare_params(1.f), cache->gains());
+}
+
+TEST_F(GainsAndPedestalsCacheJf, ShouldAlignTableForVectorLoads)
+{
+  const auto cache = GainsAndPedestalsCache::load(filename, n_pixels, 0);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(cache->table()[0].data()) % 64);
+}
+
+TEST_F(GainsAndPedestalsCacheJf, ShouldRebuildCacheWhenCalibrationFileChanges)
+{
+  GainsAndPedestalsCache::load(filename, n_pixels, 0);
+
+  write_gains_and_pedestals(filename, prepare_params(5.f), prepare_params(3.f));
+  fs::last_write_time(filename, fs::last_write_time(filename) + std::chrono::seconds(1));
+
+  const auto cache = GainsAndPedestalsCache::load(filename, n_pixels, 0);
+  EXPECT_FLOAT_EQ(5.f, cache->table()[0][0].first);
+  EXPECT_FLOAT_EQ(3.f, cache->table()[0][0].second);
+}
+
+TEST_F(GainsAndPedestalsCacheJf, ShouldRebuildCorruptedCache)
+{
+  GainsAndPedestalsCache::load(filename, n_pixels, 0);
+  {
+    std::fstream cache_file(filename + ".0.cache", std::ios::in | std::ios::out | std::ios::binary);
+    cache_file.seekp(-1, std::ios::end);
+    cache_file.put('\x7f');
+  }
+
+  const auto cache = GainsAndPedestalsCache::load(filename, n_pixels, 0);
+  const auto last = static_cast<float>(N_GAINS * n_pixels - 1);
+  EXPECT_FLOAT_EQ(-1.f + last, cache->table()[N_GAINS - 1][n_pixels - 1].second);
+}
+
+TEST_F(GainsAndPedestalsCacheJf, ShouldCacheEachModuleOfDetectorCalibration)
+{
+  constexpr std::size_t module_n_pixels = jf::MODULE_N_PIXELS;
+  parameters gains, pedestals;
+  for (auto i = 0u; i < N_GAINS; i++)
+    for (auto m = 0u; m < 2; m++) {
+      gains[i].insert(gains[i].end(), module_n_pixels, static_cast<float>(10 * m + i));
+      pedestals[i].insert(pedestals[i].end(), module_n_pixels, static_cast<float>(100 * m + i));
+    }
+  const auto detector_filename = (directory / "detector.h5").string();
+  write_gains_and_pedestals(detector_filename, gains, pedestals);
+
+  for (auto m = 0; m < 2; m++) {
+    const auto cache = GainsAndPedestalsCache::load(detector_filename, 2 * module_n_pixels, m);
+    EXPECT_TRUE(fs::exists(detector_filename + "." + std::to_string(m) + ".cache"));
+    const auto table = cache->table();
+    for (auto i = 0u; i < N_GAINS; i++) {
+      ASSERT_EQ(module_n_pixels, table[i].size());
+      EXPECT_FLOAT_EQ(static_cast<float>(10 * m + i), table[i].front().first);
+      EXPECT_FLOAT_EQ(static_cast<float>(10 * m + i), table[i].back().first);
+      EXPECT_FLOAT_EQ(static_cast<float>(100 * m + i), table[i].back().second);
+    }
+  }
+  EXPECT_THROW(GainsAndPedestalsCache::load(detector_filename, 2 * module_n_pixels, 2),
+               std::runtime_error);
+}
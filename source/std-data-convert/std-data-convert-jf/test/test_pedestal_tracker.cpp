@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "pedestal_tracker.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace jf::sdc;
+
+namespace {
+constexpr uint16_t g1_flag = 0x4000;
+} // namespace
+
+TEST(PedestalTrackerJf, ShouldThrowForZeroWindowOrSwapPeriod)
+{
+  const std::vector<float> pedestals(8, 0.f);
+  EXPECT_THROW((PedestalTracker{pedestals, {10.f, 0, 1}}), std::invalid_argument);
+  EXPECT_THROW((PedestalTracker{pedestals, {10.f, 1, 0}}), std::invalid_argument);
+}
+
+TEST(PedestalTrackerJf, ShouldMovePedestalsTowardsNotHitPixels)
+{
+  const std::vector<float> pedestals(4, 100.f);
+  PedestalTracker tracker{pedestals, {50.f, 4, 100}};
+
+  const std::vector<uint16_t> frame = {104, 96, 100, 300};
+  tracker.process(frame, false);
+
+  EXPECT_FLOAT_EQ(101.f, tracker.pedestals()[0]);
+  EXPECT_FLOAT_EQ(99.f, tracker.pedestals()[1]);
+  EXPECT_FLOAT_EQ(100.f, tracker.pedestals()[2]);
+  // above threshold - pixel was hit by photons and pedestal stays untouched
+  EXPECT_FLOAT_EQ(100.f, tracker.pedestals()[3]);
+}
+
+TEST(PedestalTrackerJf, ShouldUpdateAllG0PixelsForDarkFrames)
+{
+  const std::vector<float> pedestals(3, 100.f);
+  PedestalTracker tracker{pedestals, {50.f, 2, 100}};
+
+  const std::vector<uint16_t> frame = {300, 100 | g1_flag, 50};
+  tracker.process(frame, true);
+
+  EXPECT_FLOAT_EQ(200.f, tracker.pedestals()[0]);
+  EXPECT_FLOAT_EQ(100.f, tracker.pedestals()[1]);
+  EXPECT_FLOAT_EQ(75.f, tracker.pedestals()[2]);
+}
+
+TEST(PedestalTrackerJf, ShouldConvergeToMeanOfDarkFrames)
+{
+  const std::vector<float> pedestals(2, 0.f);
+  PedestalTracker tracker{pedestals, {1.f, 10, 1000}};
+
+  for (auto i = 0u; i < 500; i++) {
+    const std::vector<uint16_t> frame = {static_cast<uint16_t>(1000 + (i % 2) * 10), 2000};
+    tracker.process(frame, true);
+  }
+
+  EXPECT_NEAR(1005.f, tracker.pedestals()[0], 1.f);
+  EXPECT_NEAR(2000.f, tracker.pedestals()[1], 0.01f);
+}
+
+TEST(PedestalTrackerJf, ShouldReportSwapAfterEachPeriod)
+{
+  const std::vector<float> pedestals(1, 0.f);
+  PedestalTracker tracker{pedestals, {1.f, 10, 3}};
+  const std::vector<uint16_t> frame = {0};
+
+  EXPECT_FALSE(tracker.process(frame, false));
+  EXPECT_FALSE(tracker.process(frame, false));
+  EXPECT_TRUE(tracker.process(frame, false));
+  EXPECT_FALSE(tracker.process(frame, false));
+  EXPECT_FALSE(tracker.process(frame, false));
+  EXPECT_TRUE(tracker.process(frame, false));
+}
@@ -0,0 +1,25 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace correction {
+
+// per pixel maps of the whole image - empty map means the correction step is skipped
+struct correction_maps
+{
+  // non-zero value marks bad pixel
+  std::vector<uint8_t> mask;
+  std::vector<float> dark;
+  std::vector<float> flat;
+};
+
+// reads optional datasets /mask, /dark and /flat - at least one of them has to be present
+correction_maps read_correction_maps(const std::string& filename, std::size_t image_size);
+
+} // namespace correction
@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "std_buffer/image_metadata.pb.h"
+
+#include "correction_maps.hpp"
+
+namespace correction {
+
+// Applies dark subtraction and flat-field to the image in place:
+//   corrected = (raw - dark) * mean(flat - dark) / (flat - dark)
+// Maps are folded into a single offset and gain per pixel, so the hot loop is a branch-free
+// multiply-add the compiler vectorizes. Bad pixels (masked or with non-positive flat) get zero
+// gain and are either left as 0 or replaced by the mean of their good direct neighbours.
+class Corrector
+{
+public:
+  Corrector(const correction_maps& maps,
+            std::size_t image_width,
+            std::size_t image_height,
+            bool interpolate_masked);
+
+  // image is corrected only when its geometry described by meta matches the maps - returns false
+  // and leaves the image untouched otherwise
+  bool correct(char* image, const std_daq_protocol::ImageMetadata& meta) const;
+  template <typename T> void correct(T* image) const;
+
+  [[nodiscard]] std::size_t bad_pixels() const;
+
+private:
+  struct masked_pixel
+  {
+    uint32_t index;
+    uint32_t n_neighbours;
+    std::array<uint32_t, 4> neighbours;
+  };
+
+  template <typename T> bool correct_matching(T* image,
+                                              const std_daq_protocol::ImageMetadata& meta) const;
+  template <typename T> void interpolate(T* image) const;
+  void prepare_interpolation(std::size_t image_width, std::size_t image_height);
+
+  std::size_t width;
+  std::size_t height;
+  std::vector<float> offsets;
+  std::vector<float> gains;
+  std::vector<masked_pixel> masked;
+  bool interpolate_masked;
+};
+
+} // namespace correction
@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "correction_maps.hpp"
+
+#include <source_location>
+#include <stdexcept>
+
+#include <hdf5.h>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+namespace correction {
+namespace {
+
+template <typename T>
+std::vector<T> read_map(hid_t file_id, const std::string& id, hid_t type, std::size_t image_size)
+{
+  if (H5Lexists(file_id, id.c_str(), H5P_DEFAULT) <= 0) return {};
+
+  hid_t dataset_id = H5Dopen2(file_id, id.c_str(), H5P_DEFAULT);
+  if (dataset_id < 0) throw std::runtime_error(fmt::format("Cannot open dataset {}!", id));
+
+  hid_t space_id = H5Dget_space(dataset_id);
+  const auto n_elements = static_cast<std::size_t>(H5Sget_simple_extent_npoints(space_id));
+  H5Sclose(space_id);
+  if (n_elements != image_size) {
+    H5Dclose(dataset_id);
+    throw std::runtime_error(fmt::format("Dataset {} has {} pixels, image has {}!", id,
+                                         n_elements, image_size));
+  }
+
+  std::vector<T> map(n_elements);
+  const auto status = H5Dread(dataset_id, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, map.data());
+  H5Dclose(dataset_id);
+  if (status < 0) throw std::runtime_error(fmt::format("Cannot read dataset {}!", id));
+  return map;
+}
+
+} // namespace
+
+correction_maps read_correction_maps(const std::string& filename, std::size_t image_size)
+{
+  spdlog::debug("{}: filename: {}, image_size: {}", std::source_location::current().function_name(),
+                filename, image_size);
+
+  hid_t file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file_id < 0) throw std::runtime_error(fmt::format("Cannot open file {}!", filename));
+
+  correction_maps maps;
+  try {
+    maps.mask = read_map<uint8_t>(file_id, "/mask", H5T_NATIVE_UINT8, image_size);
+    maps.dark = read_map<float>(file_id, "/dark", H5T_NATIVE_FLOAT, image_size);
+    maps.flat = read_map<float>(file_id, "/flat", H5T_NATIVE_FLOAT, image_size);
+  }
+  catch (...) {
+    H5Fclose(file_id);
+    throw;
+  }
+  H5Fclose(file_id);
+
+  if (maps.mask.empty() && maps.dark.empty() && maps.flat.empty())
+    throw std::runtime_error(
+        fmt::format("File {} contains none of /mask, /dark or /flat datasets!", filename));
+  return maps;
+}
+
+} // namespace correction
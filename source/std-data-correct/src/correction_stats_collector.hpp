@@ -0,0 +1,50 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "utils/stats/timed_stats_collector.hpp"
+
+class CorrectionStatsCollector : public utils::stats::TimedStatsCollector
+{
+  using Parent = utils::stats::TimedStatsCollector;
+
+public:
+  explicit CorrectionStatsCollector(std::string_view detector_name,
+                                    std::chrono::seconds period,
+                                    std::string_view source)
+      : utils::stats::TimedStatsCollector(detector_name, period, source)
+  {}
+
+  [[nodiscard]] std::string additional_message() override
+  {
+    auto outcome =
+        fmt::format("{},corrected_images={},rejected_images={},avg_correction_time_us={:.1f}",
+                    Parent::additional_message(), corrected_images, rejected_images,
+                    corrected_images > 0 ? static_cast<double>(correction_time.count()) /
+                                               corrected_images
+                                         : 0.);
+    reset_stats();
+    return outcome;
+  }
+
+  void correct(std::chrono::microseconds duration)
+  {
+    corrected_images++;
+    correction_time += duration;
+  }
+
+  void reject() { rejected_images++; }
+
+private:
+  void reset_stats()
+  {
+    corrected_images = 0;
+    rejected_images = 0;
+    correction_time = {};
+  }
+  unsigned corrected_images = 0;
+  unsigned rejected_images = 0;
+  std::chrono::microseconds correction_time{};
+};
@@ -0,0 +1,165 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "corrector.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fmt/core.h>
+
+namespace correction {
+
+namespace {
+
+template <typename T> constexpr float max_value()
+{
+  // largest float that still converts to uint32 without overflow
+  if constexpr (std::is_same_v<T, uint32_t>) return 4294967040.f;
+  return static_cast<float>(std::numeric_limits<T>::max());
+}
+
+template <typename T> inline T store(float value)
+{
+  if constexpr (std::is_floating_point_v<T>)
+    return value;
+  else
+    return static_cast<T>(std::clamp(value + 0.5f, 0.f, max_value<T>()));
+}
+
+template <typename T>
+void test_map_size(const std::vector<T>& map, std::size_t image_size, std::string_view name)
+{
+  if (!map.empty() && map.size() != image_size)
+    throw std::invalid_argument(
+        fmt::format("Size of {} map {} differs from image size {}!", name, map.size(), image_size));
+}
+
+} // namespace
+
+Corrector::Corrector(const correction_maps& maps,
+                     std::size_t image_width,
+                     std::size_t image_height,
+                     bool interpolate_masked_pixels)
+    : width(image_width)
+    , height(image_height)
+    , offsets(image_width * image_height, 0.f)
+    , gains(image_width * image_height, 1.f)
+    , interpolate_masked(interpolate_masked_pixels)
+{
+  const auto image_size = image_width * image_height;
+  test_map_size(maps.mask, image_size, "mask");
+  test_map_size(maps.dark, image_size, "dark");
+  test_map_size(maps.flat, image_size, "flat");
+
+  if (!maps.dark.empty()) offsets = maps.dark;
+  if (!maps.mask.empty())
+    for (auto i = 0u; i < image_size; i++)
+      if (maps.mask[i] != 0) gains[i] = 0.f;
+
+  if (!maps.flat.empty()) {
+    // normalisation by the mean response keeps the corrected image in the scale of raw counts
+    double sum = 0;
+    std::size_t n_good = 0;
+    for (auto i = 0u; i < image_size; i++)
+      if (const auto response = maps.flat[i] - offsets[i]; gains[i] != 0.f && response > 0.f) {
+        sum += response;
+        n_good++;
+      }
+    const auto mean = n_good > 0 ? static_cast<float>(sum / n_good) : 0.f;
+
+    for (auto i = 0u; i < image_size; i++) {
+      const auto response = maps.flat[i] - offsets[i];
+      gains[i] = gains[i] != 0.f && response > 0.f ? mean / response : 0.f;
+    }
+  }
+
+  prepare_interpolation(image_width, image_height);
+}
+
+bool Corrector::correct(char* image, const std_daq_protocol::ImageMetadata& meta) const
+{
+  switch (meta.dtype()) {
+  case std_daq_protocol::ImageMetadataDtype::uint8:
+    return correct_matching(reinterpret_cast<uint8_t*>(image), meta);
+  case std_daq_protocol::ImageMetadataDtype::uint16:
+    return correct_matching(reinterpret_cast<uint16_t*>(image), meta);
+  case std_daq_protocol::ImageMetadataDtype::uint32:
+    return correct_matching(reinterpret_cast<uint32_t*>(image), meta);
+  case std_daq_protocol::ImageMetadataDtype::float32:
+    return correct_matching(reinterpret_cast<float*>(image), meta);
+  default:
+    throw std::runtime_error(fmt::format("Correction of images with dtype {} is not supported!",
+                                         static_cast<int>(meta.dtype())));
+  }
+}
+
+template <typename T>
+bool Corrector::correct_matching(T* image, const std_daq_protocol::ImageMetadata& meta) const
+{
+  // binned or compressed images do not map onto the pixels of the maps
+  if (meta.width() != width || meta.height() != height || meta.size() != gains.size() * sizeof(T))
+    return false;
+  correct(image);
+  return true;
+}
+
+template <typename T> void Corrector::correct(T* __restrict image) const
+{
+  const float* __restrict offset = offsets.data();
+  const float* __restrict gain = gains.data();
+  const auto image_size = gains.size();
+
+  for (auto i = 0u; i < image_size; i++)
+    image[i] = store<T>((static_cast<float>(image[i]) - offset[i]) * gain[i]);
+
+  if (interpolate_masked) interpolate(image);
+}
+
+template <typename T> void Corrector::interpolate(T* image) const
+{
+  // neighbours are good pixels - their values are already corrected
+  for (const auto& pixel : masked) {
+    if (pixel.n_neighbours == 0) continue;
+    float sum = 0.f;
+    for (auto i = 0u; i < pixel.n_neighbours; i++)
+      sum += static_cast<float>(image[pixel.neighbours[i]]);
+    image[pixel.index] = store<T>(sum / static_cast<float>(pixel.n_neighbours));
+  }
+}
+
+std::size_t Corrector::bad_pixels() const
+{
+  return masked.size();
+}
+
+void Corrector::prepare_interpolation(std::size_t image_width, std::size_t image_height)
+{
+  const auto is_good = [this](std::size_t index) { return gains[index] != 0.f; };
+
+  for (auto y = 0u; y < image_height; y++)
+    for (auto x = 0u; x < image_width; x++) {
+      const auto index = y * image_width + x;
+      if (is_good(index)) continue;
+
+      masked_pixel pixel{static_cast<uint32_t>(index), 0, {}};
+      const auto add = [&](std::size_t neighbour) {
+        if (is_good(neighbour)) pixel.neighbours[pixel.n_neighbours++] = neighbour;
+      };
+      if (x > 0) add(index - 1);
+      if (x + 1 < image_width) add(index + 1);
+      if (y > 0) add(index - image_width);
+      if (y + 1 < image_height) add(index + image_width);
+      masked.push_back(pixel);
+    }
+}
+
+template void Corrector::correct(uint8_t*) const;
+template void Corrector::correct(uint16_t*) const;
+template void Corrector::correct(uint32_t*) const;
+template void Corrector::correct(float*) const;
+
+} // namespace correction
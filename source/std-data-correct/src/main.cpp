@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <string>
+
+#include <zmq.h>
+#include <spdlog/spdlog.h>
+
+#include "core_buffer/communicator.hpp"
+#include "core_buffer/ram_buffer.hpp"
+#include "core_buffer/buffer_utils.hpp"
+#include "std_buffer/image_metadata.pb.h"
+#include "utils/utils.hpp"
+
+#include "correction_maps.hpp"
+#include "correction_stats_collector.hpp"
+#include "corrector.hpp"
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr auto zmq_io_threads = 1;
+
+struct arguments
+{
+  utils::DetectorConfig config;
+  std::string maps_filename;
+  std::string source_suffix;
+  bool interpolate_masked;
+};
+
+arguments read_arguments(int argc, char* argv[])
+{
+  auto program = utils::create_parser("std_data_correct");
+  program->add_argument("-m", "--maps")
+      .help("hdf5 file with optional /mask, /dark and /flat datasets of the image size")
+      .required();
+  program->add_argument("-s", "--source_suffix")
+      .help("suffix for ipc source of the images - data stays in the image ram_buffer")
+      .default_value("image"s);
+  program->add_argument("-i", "--interpolate")
+      .help("replace bad pixels with mean of their good neighbours instead of 0")
+      .flag();
+
+  program = utils::parse_arguments(std::move(program), argc, argv);
+  return {utils::read_config_from_json_file(program->get("detector_json_filename")),
+          program->get("--maps"), program->get("--source_suffix"),
+          program->get<bool>("--interpolate")};
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  const auto [config, maps_filename, source_suffix, interpolate] = read_arguments(argc, argv);
+  [[maybe_unused]] utils::log::logger l{"std_data_correct", config.log_level};
+
+  const auto width = static_cast<std::size_t>(config.image_pixel_width);
+  const auto height = static_cast<std::size_t>(config.image_pixel_height);
+  const correction::Corrector corrector{
+      correction::read_correction_maps(maps_filename, width * height), width, height, interpolate};
+  spdlog::info("Loaded correction maps from {} - {} bad pixels", maps_filename,
+               corrector.bad_pixels());
+
+  auto ctx = zmq_ctx_new();
+  zmq_ctx_set(ctx, ZMQ_IO_THREADS, zmq_io_threads);
+
+  const auto source_name = fmt::format("{}-{}", config.detector_name, source_suffix);
+  const auto sink_name = fmt::format("{}-corrected", config.detector_name);
+  const auto source_name_image = fmt::format("{}-image", config.detector_name);
+
+  // images are corrected in place - the ram_buffer slot is shared with the source stream
+  auto receiver = cb::Communicator{
+      {source_name_image, utils::converted_image_n_bytes(config), utils::slots_number(config)},
+      {source_name, ctx, cb::CONN_TYPE_CONNECT, ZMQ_SUB}};
+  auto sender_socket = buffer_utils::bind_socket(ctx, sink_name, ZMQ_PUB);
+
+  char buffer[512];
+  std_daq_protocol::ImageMetadata meta;
+  CorrectionStatsCollector stats(config.detector_name, config.stats_collection_period,
+                                 source_suffix);
+
+  while (true) {
+    if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
+      meta.ParseFromArray(buffer, n_bytes);
+      // maps cover the whole image - pixels of modules that arrived in partial images are
+      // corrected as well, uncorrected image must not be published as corrected one
+      const auto start = std::chrono::steady_clock::now();
+      if (corrector.correct(receiver.get_data(meta.image_id()), meta)) {
+        stats.correct(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start));
+        zmq_send(sender_socket, buffer, n_bytes, 0);
+      }
+      else
+        stats.reject();
+      stats.process();
+    }
+    stats.print_stats();
+  }
+  return 0;
+}
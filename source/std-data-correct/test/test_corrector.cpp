@@ -0,0 +1,105 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "corrector.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace correction;
+
+namespace {
+constexpr std::size_t width = 3;
+constexpr std::size_t height = 2;
+
+std_daq_protocol::ImageMetadata create_meta(std_daq_protocol::ImageMetadataDtype dtype,
+                                            std::size_t element_size)
+{
+  std_daq_protocol::ImageMetadata meta;
+  meta.set_width(width);
+  meta.set_height(height);
+  meta.set_size(width * height * element_size);
+  meta.set_dtype(dtype);
+  return meta;
+}
+} // namespace
+
+TEST(Corrector, ShouldSubtractDarkAndClampAtZero)
+{
+  const Corrector corrector{{{}, {10, 10, 10, 10, 10, 10}, {}}, width, height, false};
+  std::vector<uint16_t> image{15, 10, 5, 100, 11, 0};
+
+  corrector.correct(image.data());
+  EXPECT_EQ((std::vector<uint16_t>{5, 0, 0, 90, 1, 0}), image);
+}
+
+TEST(Corrector, ShouldNormaliseFlatFieldByMeanResponse)
+{
+  // responses 10, 20, 30, 40, 50, 60 - mean 35
+  const Corrector corrector{
+      {{}, {5, 5, 5, 5, 5, 5}, {15, 25, 35, 45, 55, 65}}, width, height, false};
+  std::vector<float> image{15, 25, 35, 45, 55, 65};
+
+  EXPECT_TRUE(corrector.correct(reinterpret_cast<char*>(image.data()),
+                                create_meta(std_daq_protocol::ImageMetadataDtype::float32, 4)));
+  for (auto value : image)
+    EXPECT_FLOAT_EQ(35.f, value);
+}
+
+TEST(Corrector, ShouldZeroMaskedPixelsAndPixelsWithoutResponse)
+{
+  const Corrector corrector{{{0, 1, 0, 0, 0, 0}, {}, {1, 1, 0, 1, 1, 1}}, width, height, false};
+  std::vector<uint32_t> image{7, 7, 7, 7, 7, 7};
+
+  corrector.correct(image.data());
+  EXPECT_EQ(2u, corrector.bad_pixels());
+  EXPECT_EQ((std::vector<uint32_t>{7, 0, 0, 7, 7, 7}), image);
+}
+
+TEST(Corrector, ShouldInterpolateMaskedPixelsFromGoodNeighbours)
+{
+  const Corrector corrector{{{0, 1, 0, 0, 0, 1}, {}, {}}, width, height, true};
+  std::vector<uint8_t> image{10, 99, 20, 30, 40, 99};
+
+  corrector.correct(image.data());
+  // pixel 1 has good neighbours 0, 2 and 4 - pixel 5 has 2 and 4
+  EXPECT_EQ((std::vector<uint8_t>{10, 23, 20, 30, 40, 30}), image);
+}
+
+TEST(Corrector, ShouldThrowForMapOfDifferentSize)
+{
+  EXPECT_THROW((Corrector{{{0, 1}, {}, {}}, width, height, false}), std::invalid_argument);
+}
+
+TEST(Corrector, ShouldThrowForUnsupportedDtype)
+{
+  const Corrector corrector{{{}, {}, {}}, width, height, false};
+  std::vector<uint16_t> image(width * height);
+  EXPECT_THROW(corrector.correct(reinterpret_cast<char*>(image.data()),
+                                 create_meta(std_daq_protocol::ImageMetadataDtype::float16, 2)),
+               std::runtime_error);
+}
+
+TEST(Corrector, ShouldRejectImageOfDifferentGeometry)
+{
+  const Corrector corrector{{{}, {10, 10, 10, 10, 10, 10}, {}}, width, height, false};
+  std::vector<uint16_t> image{15, 10, 5, 100, 11, 0};
+  const auto original = image;
+  auto* data = reinterpret_cast<char*>(image.data());
+
+  auto binned = create_meta(std_daq_protocol::ImageMetadataDtype::uint16, 2);
+  binned.set_width(1);
+  binned.set_size(height * 2);
+  EXPECT_FALSE(corrector.correct(data, binned));
+
+  auto transposed = create_meta(std_daq_protocol::ImageMetadataDtype::uint16, 2);
+  transposed.set_width(height);
+  transposed.set_height(width);
+  EXPECT_FALSE(corrector.correct(data, transposed));
+
+  auto compressed = create_meta(std_daq_protocol::ImageMetadataDtype::uint16, 2);
+  compressed.set_size(5);
+  EXPECT_FALSE(corrector.correct(data, compressed));
+
+  EXPECT_EQ(original, image);
+}
@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace sync_benchmark {
+
+using clock = std::chrono::steady_clock;
+
+inline double to_us(clock::duration d)
+{
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+enum class arrival_pattern
+{
+  in_order,
+  // modules of two consecutive images interleaved in random order of modules
+  reordered,
+  // every other image misses its last module
+  missing,
+  // no image is ever complete - every new image overflows the queue
+  overflow
+};
+
+struct arrival
+{
+  uint64_t image_offset;
+  int module_id;
+};
+
+// sequence of module arrivals for n_images consecutive images
+inline std::vector<arrival> generate_arrivals(int n_modules, int n_images, arrival_pattern pattern)
+{
+  std::vector<arrival> arrivals;
+  arrivals.reserve(static_cast<std::size_t>(n_modules) * n_images);
+  std::vector<int> order(n_modules);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(42);
+
+  for (auto i = 0; i < n_images; i++) {
+    const auto id = static_cast<uint64_t>(i);
+    switch (pattern) {
+    case arrival_pattern::in_order:
+      for (auto m : order)
+        arrivals.push_back({id, m});
+      break;
+    case arrival_pattern::reordered:
+      if (i % 2 == 1) break;
+      std::ranges::shuffle(order, rng);
+      for (auto m : order) {
+        arrivals.push_back({id, m});
+        if (i + 1 < n_images) arrivals.push_back({id + 1, m});
+      }
+      break;
+    case arrival_pattern::missing:
+      for (auto m = 0; m < n_modules - (i % 2); m++)
+        arrivals.push_back({id, m});
+      break;
+    case arrival_pattern::overflow:
+      for (auto m = 0; m < n_modules - 1; m++)
+        arrivals.push_back({id, m});
+      break;
+    }
+  }
+  return arrivals;
+}
+
+// insert-to-emit latencies collected over all iterations of the benchmark
+class LatencyCounters
+{
+public:
+  void add(clock::time_point inserted, clock::time_point emitted)
+  {
+    latencies_us.push_back(to_us(emitted - inserted));
+  }
+
+  void report(benchmark::State& state)
+  {
+    if (latencies_us.empty()) return;
+    std::ranges::sort(latencies_us);
+    state.counters["p50_us"] = percentile(0.5);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["p99.9_us"] = percentile(0.999);
+    state.counters["max_us"] = latencies_us.back();
+  }
+
+private:
+  [[nodiscard]] double percentile(double q) const
+  {
+    const auto i = static_cast<std::size_t>(q * static_cast<double>(latencies_us.size()));
+    return latencies_us[std::min(i, latencies_us.size() - 1)];
+  }
+
+  std::vector<double> latencies_us;
+};
+
+} // namespace sync_benchmark
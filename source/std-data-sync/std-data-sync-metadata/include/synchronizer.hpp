@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "std_buffer/image_metadata.pb.h"
+#include "utils/image_id.hpp"
+
+// Merge-join of the metadata stream and the stream of received images. Both streams arrive in
+// order of image ids, possibly with skew between them. Pending ids of both sides live in one
+// window of n_images_buffer slots indexed by image_id % n_images_buffer, metadata messages are
+// preallocated in the slots and swapped in and out so no message is allocated per image.
+//
+// Images are released in order of ids - the oldest pending id is matched when both sides have
+// it, and is unmatched once the other side already passed it or the window overflows.
+class Synchronizer
+{
+public:
+  // counted since the previous call of take_counters
+  struct counters
+  {
+    std::size_t unmatched_metadata = 0;
+    std::size_t unmatched_images = 0;
+    // matched, but overwritten before sent
+    std::size_t dropped_images = 0;
+  };
+
+private:
+  struct slot
+  {
+    // image_id + 1 of the id received on given side, 0 when empty
+    uint64_t metadata_tag = 0;
+    uint64_t image_tag = 0;
+    std_daq_protocol::ImageMetadata meta;
+  };
+
+  const std::size_t n_images_buffer;
+  std::vector<slot> window;
+  // oldest pending id and one past the newest id received on each side
+  utils::image_id head = 0;
+  utils::image_id metadata_end = 0;
+  utils::image_id images_end = 0;
+  counters unmatched;
+
+  mutable std::mutex mutex;
+  std::condition_variable image_ready;
+
+public:
+  explicit Synchronizer(std::size_t n_images_buffer);
+
+  // metadata is swapped into the window - message left in the argument can be reused
+  void add_metadata(std_daq_protocol::ImageMetadata& metadata);
+  void add_received_image(utils::image_id id);
+
+  // swaps metadata of the next matched image into meta
+  bool pop_next_received_image(std_daq_protocol::ImageMetadata& meta);
+  // returns true when the next pop may succeed, false on timeout
+  bool wait_for_received_image(std::chrono::milliseconds timeout);
+
+  counters take_counters();
+  [[nodiscard]] std::size_t get_queue_length() const;
+
+private:
+  slot* reserve(utils::image_id id,
+                uint64_t slot::*side,
+                utils::image_id& side_end,
+                std::size_t& n_unmatched);
+  void move_head(utils::image_id new_head);
+  void release(slot& s, utils::image_id id);
+  void notify_if_ready(std::unique_lock<std::mutex>& lock);
+  [[nodiscard]] bool is_head_resolved() const;
+};
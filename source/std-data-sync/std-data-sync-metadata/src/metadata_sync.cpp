@@ -13,6 +13,7 @@
 #include "utils/utils.hpp"
 #include "std_buffer/image_metadata.pb.h"
 
+#include "metadata_sync_stats_collector.hpp"
 #include "synchronizer.hpp"
 
 using namespace std;
@@ -36,13 +37,10 @@ void* zmq_socket_connect(void* ctx, const std::string& stream_address)
   return socket;
 }
 
-void process_incoming_metadata_stream(const utils::DetectorConfig& config,
-                                      const std::string& metadata_stream_address,
+void process_incoming_metadata_stream(const std::string& metadata_stream_address,
                                       void* ctx,
                                       std::shared_ptr<Synchronizer> syncer)
 {
-  utils::stats::QueueStatsCollector stats(config.detector_name, config.stats_collection_period);
-
   char buffer[512];
   std_daq_protocol::ImageMetadata image_meta;
 
@@ -50,11 +48,8 @@ void process_incoming_metadata_stream(const utils::DetectorConfig& config,
   while (true) {
     if (auto n_bytes = zmq_recv(metadata_socket, buffer, sizeof(buffer), 0); n_bytes > 0) {
       image_meta.ParseFromArray(buffer, n_bytes);
-      bool dropped = syncer->add_metadata(image_meta);
-      stats.process(dropped);
-      stats.update_queue_length(syncer->get_queue_length());
+      syncer->add_metadata(image_meta);
     }
-    stats.print_stats();
   }
 }
 
@@ -80,16 +75,21 @@ void send_synchronized_images(const utils::DetectorConfig& config,
                               std::shared_ptr<Synchronizer> syncer)
 {
   using namespace std::chrono_literals;
+  MetadataSyncStatsCollector stats(config.detector_name, config.stats_collection_period);
   auto sender = buffer_utils::bind_socket(ctx, config.detector_name + "-image", ZMQ_PUB);
 
+  std_daq_protocol::ImageMetadata meta;
+  std::string meta_buffer_send;
   while (true) {
-    if (auto meta = syncer->get_next_received_image(); meta.has_value()) {
-      std::string meta_buffer_send;
-      meta->SerializeToString(&meta_buffer_send);
-      zmq_send(sender, meta_buffer_send.c_str(), meta_buffer_send.size(), 0);
-    }
-    else
-      std::this_thread::sleep_for(1ms);
+    // timeout only keeps the statistics flowing when no images arrive
+    if (syncer->wait_for_received_image(1s))
+      while (syncer->pop_next_received_image(meta)) {
+        meta.SerializeToString(&meta_buffer_send);
+        zmq_send(sender, meta_buffer_send.c_str(), meta_buffer_send.size(), 0);
+        stats.process();
+      }
+    stats.update(syncer->take_counters(), syncer->get_queue_length());
+    stats.print_stats();
   }
 }
 } // namespace
@@ -107,7 +107,7 @@ int main(int argc, char* argv[])
 
   auto syncer = std::make_shared<Synchronizer>(10000);
 
-  std::jthread processing_metadata_thread(process_incoming_metadata_stream, config,
+  std::jthread processing_metadata_thread(process_incoming_metadata_stream,
                                           metadata_stream_address, ctx, syncer);
   std::jthread processing_images_thread(process_incoming_image_stream, config, ctx, syncer);
   std::jthread sending_synchronized_images_thread(send_synchronized_images, config, ctx, syncer);
@@ -0,0 +1,47 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "utils/stats/timed_stats_collector.hpp"
+
+#include "synchronizer.hpp"
+
+class MetadataSyncStatsCollector : public utils::stats::TimedStatsCollector
+{
+  using Parent = utils::stats::TimedStatsCollector;
+
+public:
+  explicit MetadataSyncStatsCollector(std::string_view detector_name, std::chrono::seconds period)
+      : utils::stats::TimedStatsCollector(detector_name, period)
+  {}
+
+  [[nodiscard]] std::string additional_message() override
+  {
+    auto outcome = fmt::format(
+        "{},n_unmatched_metadata={},n_unmatched_images={},n_dropped_images={},queue={}",
+        Parent::additional_message(), unmatched.unmatched_metadata, unmatched.unmatched_images,
+        unmatched.dropped_images, queue);
+    reset_stats();
+    return outcome;
+  }
+
+  void update(const Synchronizer::counters& counters, std::size_t queue_len)
+  {
+    unmatched.unmatched_metadata += counters.unmatched_metadata;
+    unmatched.unmatched_images += counters.unmatched_images;
+    unmatched.dropped_images += counters.dropped_images;
+    queue = std::max(queue, queue_len);
+  }
+
+private:
+  void reset_stats()
+  {
+    unmatched = {};
+    queue = 0;
+  }
+
+  Synchronizer::counters unmatched;
+  std::size_t queue = 0;
+};
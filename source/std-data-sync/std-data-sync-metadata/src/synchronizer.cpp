@@ -3,48 +3,135 @@
 /////////////////////////////////////////////////////////////////////
 
 #include "synchronizer.hpp"
-#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <utility>
 
 using namespace std;
 
+namespace {
+constexpr uint64_t tag(utils::image_id id)
+{
+  return id + 1;
+}
+} // namespace
+
 Synchronizer::Synchronizer(std::size_t n_images_buffer)
     : n_images_buffer(n_images_buffer)
+    , window(n_images_buffer)
 {}
 
-bool Synchronizer::add_metadata(const std_daq_protocol::ImageMetadata& metadata)
+void Synchronizer::add_metadata(std_daq_protocol::ImageMetadata& metadata)
 {
-  std::lock_guard<std::mutex> lock(mutex_metadata);
-  metadata_cache[metadata.image_id()] = metadata;
-  if (metadata_cache.size() > n_images_buffer) {
-    metadata_cache.erase(metadata_cache.begin());
-    return true;
+  std::unique_lock<std::mutex> lock(mutex);
+  const auto id = metadata.image_id();
+  if (auto* s = reserve(id, &slot::metadata_tag, metadata_end, unmatched.unmatched_metadata)) {
+    s->meta.Swap(&metadata);
+    notify_if_ready(lock);
   }
-  return false;
 }
 
 void Synchronizer::add_received_image(utils::image_id id)
 {
-  std::lock_guard<std::mutex> lock(mutex_images);
-  received_images.insert(id);
-  received_images.erase(received_images.begin(),
-                        received_images.lower_bound(metadata_cache.begin()->first));
+  std::unique_lock<std::mutex> lock(mutex);
+  if (reserve(id, &slot::image_tag, images_end, unmatched.unmatched_images))
+    notify_if_ready(lock);
 }
 
-std::optional<std_daq_protocol::ImageMetadata> Synchronizer::get_next_received_image()
+bool Synchronizer::pop_next_received_image(std_daq_protocol::ImageMetadata& meta)
 {
-  std::scoped_lock lock(mutex_metadata, mutex_images);
-  if (metadata_cache.empty() || received_images.empty()) return std::nullopt;
-  if (metadata_cache.begin()->first == *(received_images.begin())) {
-    auto data = metadata_cache.begin()->second;
-    metadata_cache.erase(metadata_cache.begin());
-    received_images.erase(received_images.begin());
-    return data;
+  std::lock_guard<std::mutex> lock(mutex);
+  while (is_head_resolved()) {
+    auto& s = window[head % n_images_buffer];
+    if (s.metadata_tag == tag(head) && s.image_tag == tag(head)) {
+      meta.Swap(&s.meta);
+      s.metadata_tag = s.image_tag = 0;
+      head++;
+      return true;
+    }
+    // the other side already passed this id - it will not be matched anymore
+    release(s, head);
+    head++;
   }
-  return std::nullopt;
+  return false;
+}
+
+bool Synchronizer::wait_for_received_image(std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  return image_ready.wait_for(lock, timeout, [this] { return is_head_resolved(); });
+}
+
+Synchronizer::counters Synchronizer::take_counters()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::exchange(unmatched, {});
 }
 
 std::size_t Synchronizer::get_queue_length() const
 {
-  std::lock_guard<std::mutex> lock(mutex_metadata);
-  return metadata_cache.size();
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::max(metadata_end, images_end) - head;
+}
+
+Synchronizer::slot* Synchronizer::reserve(utils::image_id id,
+                                          uint64_t slot::*side,
+                                          utils::image_id& side_end,
+                                          std::size_t& n_unmatched)
+{
+  if (id < head) {
+    // ids far below the newest id of the same side belong to a restarted acquisition
+    if (side_end > id + n_images_buffer) {
+      move_head(std::max(metadata_end, images_end));
+      head = metadata_end = images_end = id;
+    }
+    // arrived after its id was already resolved or the side lags more than the window
+    else {
+      n_unmatched++;
+      side_end = std::max(side_end, id + 1);
+      return nullptr;
+    }
+  }
+  if (id >= head + n_images_buffer) move_head(id - n_images_buffer + 1);
+
+  auto& s = window[id % n_images_buffer];
+  s.*side = tag(id);
+  side_end = std::max(side_end, id + 1);
+  return &s;
+}
+
+// releases all pending ids below new_head - there are at most n_images_buffer of them
+void Synchronizer::move_head(utils::image_id new_head)
+{
+  const auto end = std::min(new_head, std::max(metadata_end, images_end));
+  for (auto id = head; id < end; id++)
+    release(window[id % n_images_buffer], id);
+  head = std::max(head, new_head);
+}
+
+void Synchronizer::release(slot& s, utils::image_id id)
+{
+  const bool has_metadata = s.metadata_tag == tag(id);
+  const bool has_image = s.image_tag == tag(id);
+  if (has_metadata && has_image)
+    unmatched.dropped_images++;
+  else if (has_metadata)
+    unmatched.unmatched_metadata++;
+  else if (has_image)
+    unmatched.unmatched_images++;
+  if (has_metadata) s.metadata_tag = 0;
+  if (has_image) s.image_tag = 0;
+}
+
+void Synchronizer::notify_if_ready(std::unique_lock<std::mutex>& lock)
+{
+  if (!is_head_resolved()) return;
+  lock.unlock();
+  image_ready.notify_one();
+}
+
+// both sides reached the oldest pending id - it is either matched or cannot be matched anymore
+bool Synchronizer::is_head_resolved() const
+{
+  return head < std::min(metadata_end, images_end);
 }
@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "synchronizer.hpp"
+#include "latency_counters.hpp"
+
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+using namespace sync_benchmark;
+
+const int sync_n_images_buffer = 10000;
+const int tested_frequency = 2000;
+
+void add_metadata(Synchronizer& syncer, std_daq_protocol::ImageMetadata& meta, uint64_t id)
+{
+  meta.set_image_id(id);
+  syncer.add_metadata(meta);
+}
+
+// images stream runs `skew` ids ahead of the metadata stream, every `missing` metadata is lost -
+// skew larger than the window overflows it
+void Metadata_sync(benchmark::State& state)
+{
+  const auto skew = static_cast<uint64_t>(state.range(0));
+  const auto missing = static_cast<uint64_t>(state.range(1));
+  Synchronizer syncer(sync_n_images_buffer);
+  std_daq_protocol::ImageMetadata meta, popped;
+  LatencyCounters latencies;
+
+  uint64_t first_image = 0;
+  std::size_t n_emitted = 0;
+  for (auto _ : state) {
+    for (auto id = first_image; id < first_image + tested_frequency; id++) {
+      syncer.add_received_image(id + skew);
+      const auto start = clock::now();
+      if (missing == 0 || id % missing != 0) add_metadata(syncer, meta, id);
+      while (syncer.pop_next_received_image(popped)) {
+        latencies.add(start, clock::now());
+        n_emitted++;
+      }
+    }
+    first_image += tested_frequency;
+  }
+
+  const auto counters = syncer.take_counters();
+  latencies.report(state);
+  state.counters["emitted"] =
+      benchmark::Counter(static_cast<double>(n_emitted), benchmark::Counter::kAvgIterations);
+  const auto n_unmatched = counters.unmatched_metadata + counters.unmatched_images;
+  state.counters["unmatched"] =
+      benchmark::Counter(static_cast<double>(n_unmatched), benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * tested_frequency);
+}
+
+// metadata and images are received by separate threads as in std_data_sync_metadata, images
+// lead by `skew` ids - latency is measured from the later of both inserts to the sender pop
+void Metadata_sync_threads(benchmark::State& state)
+{
+  const auto skew = static_cast<uint64_t>(state.range(0));
+  const auto n_images = static_cast<std::size_t>(tested_frequency);
+  Synchronizer syncer(sync_n_images_buffer);
+  std::vector<clock::time_point> metadata_inserted(n_images);
+  std::vector<clock::time_point> image_inserted(n_images);
+  std::vector<clock::time_point> popped(n_images);
+  LatencyCounters latencies;
+
+  uint64_t first_image = 0;
+  for (auto _ : state) {
+    std::jthread sender([&] {
+      std_daq_protocol::ImageMetadata meta;
+      for (std::size_t n_popped = 0; n_popped < n_images;) {
+        syncer.wait_for_received_image(std::chrono::milliseconds(100));
+        while (syncer.pop_next_received_image(meta)) {
+          popped[meta.image_id() - first_image] = clock::now();
+          n_popped++;
+        }
+      }
+    });
+    std::jthread images([&] {
+      for (auto i = 0u; i < n_images; i++) {
+        image_inserted[i] = clock::now();
+        syncer.add_received_image(first_image + i);
+        if (i >= skew) std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    });
+
+    std_daq_protocol::ImageMetadata meta;
+    for (auto i = 0u; i < n_images; i++) {
+      metadata_inserted[i] = clock::now();
+      add_metadata(syncer, meta, first_image + i);
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    images.join();
+    sender.join();
+
+    for (auto i = 0u; i < n_images; i++)
+      latencies.add(std::max(metadata_inserted[i], image_inserted[i]), popped[i]);
+    first_image += n_images;
+  }
+
+  latencies.report(state);
+  state.SetItemsProcessed(state.iterations() * tested_frequency);
+}
+
+} // namespace
+
+BENCHMARK(Metadata_sync)
+    ->ArgNames({"skew", "missing"})
+    ->Args({0, 0})
+    ->Args({100, 0})
+    ->Args({100, 10})
+    ->Args({2 * sync_n_images_buffer, 0});
+BENCHMARK(Metadata_sync_threads)
+    ->ArgName("skew")
+    ->Arg(0)
+    ->Arg(100)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "synchronizer.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+struct MetadataSynchronizerTest : public ::testing::Test
+{
+  static constexpr std::size_t queue_size = 4;
+  Synchronizer sync{queue_size};
+  std_daq_protocol::ImageMetadata meta;
+
+  void add_metadata(utils::image_id id)
+  {
+    std_daq_protocol::ImageMetadata m;
+    m.set_image_id(id);
+    m.set_width(static_cast<uint32_t>(id * 10));
+    sync.add_metadata(m);
+  }
+
+  void expect_next(utils::image_id id)
+  {
+    ASSERT_TRUE(sync.pop_next_received_image(meta));
+    EXPECT_EQ(id, meta.image_id());
+    EXPECT_EQ(id * 10, meta.width());
+  }
+};
+
+TEST_F(MetadataSynchronizerTest, ShouldReleaseImageWhenBothSidesAreReceived)
+{
+  add_metadata(1);
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+  sync.add_received_image(1);
+  expect_next(1);
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldMatchImagesArrivingWithSkew)
+{
+  for (auto id = 5u; id < 8; id++)
+    sync.add_received_image(id);
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+  for (auto id = 5u; id < 8; id++) {
+    add_metadata(id);
+    expect_next(id);
+  }
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+  const auto counters = sync.take_counters();
+  EXPECT_EQ(0u, counters.unmatched_metadata);
+  EXPECT_EQ(0u, counters.unmatched_images);
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldSkipIdsPassedByOtherSide)
+{
+  add_metadata(1);
+  add_metadata(2);
+  sync.add_received_image(0);
+  sync.add_received_image(2);
+  add_metadata(3);
+  expect_next(2);
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+
+  const auto counters = sync.take_counters();
+  EXPECT_EQ(1u, counters.unmatched_metadata);
+  EXPECT_EQ(1u, counters.unmatched_images);
+  EXPECT_EQ(0u, sync.take_counters().unmatched_images);
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldCountIdsArrivingAfterBeingResolved)
+{
+  add_metadata(2);
+  sync.add_received_image(2);
+  expect_next(2);
+  sync.add_received_image(1);
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+  EXPECT_EQ(1u, sync.take_counters().unmatched_images);
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldReleaseIdsFallingOutOfWindow)
+{
+  for (auto id = 0u; id < queue_size; id++)
+    add_metadata(id);
+  sync.add_received_image(0);
+  add_metadata(10);
+  EXPECT_EQ(queue_size, sync.get_queue_length());
+  EXPECT_FALSE(sync.pop_next_received_image(meta));
+
+  const auto counters = sync.take_counters();
+  EXPECT_EQ(queue_size - 1, counters.unmatched_metadata);
+  EXPECT_EQ(1u, counters.dropped_images);
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldRestartWhenIdsGoBack)
+{
+  add_metadata(100);
+  sync.add_received_image(100);
+  expect_next(100);
+  add_metadata(1);
+  sync.add_received_image(1);
+  expect_next(1);
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldCountSideLaggingBeyondWindowAsUnmatched)
+{
+  sync.add_received_image(20);
+  sync.add_received_image(21);
+  add_metadata(10);
+  add_metadata(11);
+  EXPECT_EQ(2u, sync.take_counters().unmatched_metadata);
+  add_metadata(21);
+  expect_next(21);
+}
+
+TEST_F(MetadataSynchronizerTest, ShouldWakeUpWaitingSender)
+{
+  using namespace std::chrono_literals;
+  EXPECT_FALSE(sync.wait_for_received_image(1ms));
+
+  std::jthread producer([this] {
+    std::this_thread::sleep_for(10ms);
+    add_metadata(3);
+    sync.add_received_image(3);
+  });
+  EXPECT_TRUE(sync.wait_for_received_image(10s));
+  expect_next(3);
+}
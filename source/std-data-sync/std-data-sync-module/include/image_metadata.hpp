@@ -0,0 +1,98 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+
+#include <spdlog/spdlog.h>
+
+#include "detectors/eiger.hpp"
+#include "detectors/gigafrost.hpp"
+#include "detectors/jungfrau.hpp"
+#include "utils/utils.hpp"
+#include "std_buffer/image_metadata.pb.h"
+
+template <typename FrameType>
+void fill_detector_specific_data(const FrameType&, std_daq_protocol::ImageMetadata&)
+{
+  spdlog::error("Unsupported type of data - wrong detector configured");
+}
+
+template <>
+inline void fill_detector_specific_data(const gf::GFFrame& data,
+                                        std_daq_protocol::ImageMetadata& meta)
+{
+  meta.mutable_gf()->set_exposure_time(data.exposure_time);
+  meta.mutable_gf()->set_frame_timestamp(data.frame_timestamp);
+  meta.mutable_gf()->set_scan_id(data.scan_id);
+  meta.mutable_gf()->set_scan_time(data.scan_time);
+  meta.mutable_gf()->set_sync_time(data.sync_time);
+  meta.mutable_gf()->set_store_image(!data.do_not_store);
+}
+
+template <>
+inline void fill_detector_specific_data(const jf::JFFrame& data,
+                                        std_daq_protocol::ImageMetadata& meta)
+{
+  meta.mutable_jf()->set_daq_rec(data.daq_rec);
+}
+
+template <>
+inline void fill_detector_specific_data(const eg::EGFrame&, std_daq_protocol::ImageMetadata& meta)
+{
+  // TODO: make data available
+  meta.mutable_eg()->set_exptime(0);
+}
+
+// fields describing the assembled image - identical for every image of the run
+inline std_daq_protocol::ImageMetadata create_image_metadata(const utils::DetectorConfig& config)
+{
+  std_daq_protocol::ImageMetadata image_meta;
+  image_meta.set_dtype(utils::get_metadata_dtype(config));
+  image_meta.set_height(config.image_pixel_height);
+  image_meta.set_width(config.image_pixel_width);
+  image_meta.set_size(utils::converted_image_n_bytes(config));
+  image_meta.set_compression(std_daq_protocol::none);
+  return image_meta;
+}
+
+template <typename FrameType>
+void fill_image_metadata(const FrameType& frame, std_daq_protocol::ImageMetadata& image_meta)
+{
+  image_meta.set_image_id(frame.common.image_id);
+  if (frame.common.n_missing_packets == 0)
+    image_meta.set_status(std_daq_protocol::ImageMetadataStatus::good_image);
+  else
+    image_meta.set_status(std_daq_protocol::ImageMetadataStatus::missing_packets);
+
+  fill_detector_specific_data(frame, image_meta);
+}
+
+// image released by the sync deadline is marked as missing packets with mask of absent modules
+template <std::size_t N>
+void set_missing_modules(const std::bitset<N>& missing_modules,
+                         std_daq_protocol::ImageMetadata& image_meta)
+{
+  image_meta.clear_missing_modules_mask();
+  if (missing_modules.none()) return;
+
+  image_meta.set_status(std_daq_protocol::ImageMetadataStatus::missing_packets);
+  for (auto word = 0u; word < (N + 63) / 64; word++) {
+    uint64_t bits = 0;
+    for (auto i = word * 64; i < std::min<std::size_t>(N, (word + 1) * 64); i++)
+      if (missing_modules.test(i)) bits |= uint64_t{1} << (i % 64);
+    image_meta.add_missing_modules_mask(bits);
+  }
+}
+
+template <typename FrameType, std::size_t N>
+void fill_image_metadata(const FrameType& frame,
+                         const std::bitset<N>& missing_modules,
+                         std_daq_protocol::ImageMetadata& image_meta)
+{
+  fill_image_metadata(frame, image_meta);
+  set_missing_modules(missing_modules, image_meta);
+}
@@ -4,58 +4,236 @@
 
 #pragma once
 
-#include <cstddef>
-#include <string>
-#include <vector>
-#include <map>
+#include <array>
+#include <atomic>
 #include <bitset>
-#include <mutex>
-#include <variant>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "core_buffer/formats.hpp"
 #include "utils/image_id.hpp"
 
+// Pending images live in a fixed ring indexed by image_id % n_images_buffer - a slot holds
+// the first received frame of the image and atomic masks of modules still missing. Modules
+// may be reported concurrently from many threads, full images are popped by one thread at a
+// time in order of image ids. Completion of an image (or drop that may unblock the oldest
+// pending image) bumps an event counter the popping thread can wait on instead of polling.
+//
+// With deadline set, the oldest image is released with its missing modules once the deadline
+// passed since arrival of its first module. Modules arriving afterwards are counted as late
+// and duplicated modules are ignored instead of dropping the whole image.
+//
+// Modules send their images in order. A module going back below the oldest pending image
+// (or any module far below it) starts a restarted acquisition - pending images of the previous
+// one are dropped and the ring restarts at the new id.
 template <typename FrameType> class Synchronizer
 {
   using modules_mask = std::bitset<128>;
+  using clock = std::chrono::steady_clock;
+
+public:
+  struct synchronized_image
+  {
+    FrameType frame;
+    // modules that did not arrive before the deadline - empty for full images
+    modules_mask missing;
+  };
+
+  // arrival of a module relative to the first module of its image
+  struct module_arrival
+  {
+    std::size_t module_id = 0;
+    clock::duration offset{};
+    // module completed the image
+    bool last = false;
+  };
+
+  // modules and images counted since the previous call of take_counters
+  struct counters
+  {
+    std::size_t partial_images = 0;
+    std::size_t late_modules = 0;
+    std::size_t duplicated_modules = 0;
+  };
+
+private:
+  static constexpr uint64_t free_slot = 0;
+  static constexpr uint64_t busy_slot = UINT64_MAX;
+  static constexpr std::size_t modules_per_word = 32;
+  static constexpr std::size_t n_words = 128 / modules_per_word;
+  static constexpr uint64_t word_modules = 0xFFFFFFFF;
+
+  // state holds image_id + 1 of the image occupying the slot, it is busy while the slot is
+  // being (re)initialised or released. Mask words carry the image tag in upper half - module
+  // update is a single compare-exchange that fails once the slot got reused for other image.
+  struct alignas(64) slot
+  {
+    std::atomic<uint64_t> state{free_slot};
+    std::array<std::atomic<uint64_t>, n_words> missing{};
+    // clock ticks - read by the popping thread while the slot may get reinitialised
+    std::atomic<clock::rep> first_arrival{0};
+    FrameType frame{};
+  };
 
   const int n_modules;
-  const size_t n_images_buffer;
+  const std::size_t n_images_buffer;
   const modules_mask new_image_mask;
-  std::map<utils::image_id, std::pair<modules_mask, FrameType>> cache;
-  mutable std::mutex mutex_cache;
+  const std::array<uint64_t, n_words> new_image_words;
+  const clock::duration deadline;
+  std::unique_ptr<slot[]> slots;
+  // tag of the newest image received from each module in the current acquisition
+  std::unique_ptr<std::atomic<uint64_t>[]> newest_ids;
+  // oldest image that may still be popped and one past the newest received image
+  std::atomic<utils::image_id> head{0};
+  std::atomic<utils::image_id> end{0};
+  std::atomic<uint32_t> events{0};
+  std::atomic_flag restarting;
+  mutable std::atomic<uint32_t> n_sleeping{0};
+  std::atomic<std::size_t> partial_images{0};
+  std::atomic<std::size_t> late_modules{0};
+  std::atomic<std::size_t> duplicated_modules{0};
 
 public:
-  Synchronizer(int n_modules, int n_images_buffer, modules_mask mask = 0)
+  Synchronizer(int n_modules,
+               int n_images_buffer,
+               modules_mask mask = 0,
+               std::chrono::milliseconds deadline = {})
       : n_modules(n_modules)
       , n_images_buffer(n_images_buffer)
       , new_image_mask(mask.none() ? set_all(n_modules) : mask)
-      , cache()
+      , new_image_words(to_words(new_image_mask))
+      , deadline(deadline)
+      , slots(new slot[n_images_buffer])
+      , newest_ids(new std::atomic<uint64_t>[n_modules]{})
   {}
 
   // returns corrupted images
-  std::size_t process_image_metadata(FrameType meta)
+  std::size_t process_image_metadata(FrameType meta) { return process(meta, nullptr); }
+
+  // arrival is set when the module got added to pending image
+  std::size_t process_image_metadata(FrameType meta, std::optional<module_arrival>& arrival)
   {
-    std::lock_guard<std::mutex> lock(mutex_cache);
-    if (is_new_image(meta.common.image_id))
-      return push_new_image_to_queue(meta);
-    else
-      return update_module_mask_for_image(meta.common.image_id, meta.common.module_id);
+    arrival.reset();
+    return process(meta, &arrival);
   }
 
   std::optional<FrameType> pop_next_full_image()
   {
-    std::lock_guard<std::mutex> lock(mutex_cache);
-    if (cache.empty()) return std::nullopt;
-    if (auto data = cache.begin()->second; data.first == 0) {
-      cache.erase(cache.begin());
-      return data.second;
-    }
+    if (auto image = pop(false)) return image->frame;
     return std::nullopt;
   }
 
+  // full image or the oldest one with its deadline passed
+  std::optional<synchronized_image> pop_next_image() { return pop(has_deadline()); }
+
+  // time left until the oldest pending image may be released partially
+  [[nodiscard]] std::optional<clock::duration> time_to_deadline() const
+  {
+    if (!has_deadline()) return std::nullopt;
+    const auto h = head.load(std::memory_order_acquire);
+    const auto& s = slots[h % n_images_buffer];
+    if (h >= end.load(std::memory_order_acquire) ||
+        s.state.load(std::memory_order_acquire) != tag(h))
+      return deadline;
+    return std::max(clock::duration::zero(), first_arrival(s) + deadline - clock::now());
+  }
+
+  counters take_counters()
+  {
+    return {partial_images.exchange(0, std::memory_order_relaxed),
+            late_modules.exchange(0, std::memory_order_relaxed),
+            duplicated_modules.exchange(0, std::memory_order_relaxed)};
+  }
+
+  // counter of completed and dropped images - value read before popping is passed to wait
+  [[nodiscard]] uint32_t events_count() const { return events.load(std::memory_order_acquire); }
+
+  void wait_for_events(uint32_t seen) const { futex_wait(seen, nullptr); }
+  void wait_for_events(uint32_t seen, clock::duration timeout) const
+  {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    const timespec ts{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+    futex_wait(seen, &ts);
+  }
+
 private:
+  std::size_t process(const FrameType& meta, std::optional<module_arrival>* arrival)
+  {
+    const auto id = meta.common.image_id;
+    const auto module = meta.common.module_id % n_modules;
+
+    std::size_t n_dropped = 0;
+    if (is_already_released(id, module, n_dropped)) {
+      if (!has_deadline()) return 1;
+      late_modules.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+
+    auto& s = get_slot(id);
+    while (true) {
+      auto state = s.state.load(std::memory_order_acquire);
+      if (state == tag(id)) {
+        if (auto result = update_module_mask_for_image(s, id, module, arrival))
+          return n_dropped + *result;
+        continue;
+      }
+      if (state == busy_slot) {
+        std::this_thread::yield();
+        continue;
+      }
+      // slot already holds newer image - this one is too old to be synchronized
+      if (state != free_slot && state > tag(id)) return n_dropped + 1;
+      if (s.state.compare_exchange_weak(state, busy_slot, std::memory_order_acquire))
+        return n_dropped + push_new_image_to_queue(s, meta, module, state != free_slot, arrival);
+    }
+  }
+
+  std::optional<synchronized_image> pop(bool allow_partial)
+  {
+    while (true) {
+      auto h = head.load(std::memory_order_acquire);
+      const auto e = end.load(std::memory_order_acquire);
+      if (h >= e) return std::nullopt;
+      // nothing older than the ring capacity can be pending - skip the gap at once
+      if (e - h > n_images_buffer) {
+        head.compare_exchange_strong(h, e - n_images_buffer);
+        continue;
+      }
+
+      auto& s = get_slot(h);
+      auto state = s.state.load(std::memory_order_acquire);
+      if (state == busy_slot) return std::nullopt;
+      if (state == tag(h)) {
+        const auto missing = missing_modules(s);
+        if (missing.any() && !(allow_partial && clock::now() - first_arrival(s) >= deadline))
+          return std::nullopt;
+        if (!s.state.compare_exchange_strong(state, busy_slot, std::memory_order_acquire))
+          continue;
+        synchronized_image image{s.frame, missing_modules(s)};
+        release(s);
+        head.compare_exchange_strong(h, h + 1);
+        if (image.missing.any()) partial_images.fetch_add(1, std::memory_order_relaxed);
+        return image;
+      }
+      // image was never received, got dropped or was superseded - reclaim stale leftovers
+      if (state != free_slot && state < tag(h) &&
+          s.state.compare_exchange_strong(state, busy_slot, std::memory_order_acquire))
+        release(s);
+      head.compare_exchange_strong(h, h + 1);
+    }
+  }
+
   static modules_mask set_all(int n_modules)
   {
     modules_mask m;
@@ -64,41 +242,183 @@ private:
     return m;
   }
 
-  std::size_t push_new_image_to_queue(FrameType meta)
+  static std::array<uint64_t, n_words> to_words(const modules_mask& mask)
+  {
+    std::array<uint64_t, n_words> words{};
+    for (auto i = 0u; i < mask.size(); i++)
+      if (mask.test(i)) words[i / modules_per_word] |= uint64_t{1} << (i % modules_per_word);
+    return words;
+  }
+
+  static constexpr uint64_t tag(utils::image_id id) { return id + 1; }
+  static constexpr uint64_t word_tag(utils::image_id id) { return tag(id) << 32; }
+
+  static modules_mask missing_modules(const slot& s)
   {
-    if (is_queue_too_long()) cache.erase(cache.begin());
-    // Initialize the module mask to 1 for n_modules the least significant bits.
-    auto mask = new_image_mask;
-    mask.reset(meta.common.module_id % n_modules);
-    cache.emplace(meta.common.image_id, std::make_pair(mask, meta));
-    return is_queue_too_long();
+    modules_mask missing;
+    for (auto i = n_words; i-- > 0;)
+      missing = (missing << modules_per_word) |
+                modules_mask{s.missing[i].load(std::memory_order_acquire) & word_modules};
+    return missing;
   }
 
-  size_t update_module_mask_for_image(utils::image_id id, size_t module_id)
+  static clock::time_point first_arrival(const slot& s)
   {
-    auto& mask = get_modules_mask_for_image(id);
+    return clock::time_point{clock::duration{s.first_arrival.load(std::memory_order_relaxed)}};
+  }
+
+  [[nodiscard]] bool has_deadline() const { return deadline != clock::duration::zero(); }
+
+  slot& get_slot(utils::image_id id) { return slots[id % n_images_buffer]; }
 
-    // Has this module already arrived for this image_id?
-    if (!mask.test(module_id % n_modules)) {
-      cache.erase(id);
-      return 1;
+  // ids below the oldest pending image were already released - unless the module already sent
+  // a newer one or the id is far below, then they belong to a restarted acquisition
+  [[nodiscard]] bool is_already_released(utils::image_id id,
+                                         std::size_t module,
+                                         std::size_t& n_dropped)
+  {
+    for (auto h = head.load(std::memory_order_acquire); id < h;
+         h = head.load(std::memory_order_acquire)) {
+      if (!is_restart(id, h, module)) return true;
+      if (restarting.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+        continue;
+      }
+      // other thread may have restarted the acquisition meanwhile
+      h = head.load(std::memory_order_acquire);
+      if (id < h && is_restart(id, h, module)) n_dropped += restart(id);
+      restarting.clear(std::memory_order_release);
     }
-    else {
-      // Clear bit in 'part_id' place.
-      mask.reset(module_id % n_modules);
-      return 0;
+    auto& newest = newest_ids[module];
+    for (auto n = newest.load(std::memory_order_relaxed);
+         n < tag(id) && !newest.compare_exchange_weak(n, tag(id), std::memory_order_relaxed);)
+      ;
+    return false;
+  }
+
+  [[nodiscard]] bool is_restart(utils::image_id id, utils::image_id h, std::size_t module) const
+  {
+    return h - id > n_images_buffer ||
+           tag(id) < newest_ids[module].load(std::memory_order_relaxed);
+  }
+
+  // drops all pending images of the previous acquisition - caller holds the restarting flag
+  std::size_t restart(utils::image_id id)
+  {
+    std::size_t n_dropped = 0;
+    for (auto& s : std::span(slots.get(), n_images_buffer)) {
+      auto state = s.state.load(std::memory_order_acquire);
+      while (state != free_slot) {
+        if (state == busy_slot) {
+          std::this_thread::yield();
+          state = s.state.load(std::memory_order_acquire);
+        }
+        else if (s.state.compare_exchange_weak(state, busy_slot, std::memory_order_acquire)) {
+          release(s);
+          n_dropped++;
+          break;
+        }
+      }
     }
+    for (auto& newest : std::span(newest_ids.get(), static_cast<std::size_t>(n_modules)))
+      newest.store(free_slot, std::memory_order_relaxed);
+    // popping thread sees an empty ring until head is moved as well
+    end.store(id, std::memory_order_release);
+    head.store(id, std::memory_order_release);
+    notify();
+    return n_dropped;
   }
 
-  modules_mask& get_modules_mask_for_image(utils::image_id id)
+  // slot is owned exclusively (busy) - previous image, if any, is dropped
+  std::size_t push_new_image_to_queue(slot& s,
+                                      const FrameType& meta,
+                                      std::size_t module,
+                                      bool evicted,
+                                      std::optional<module_arrival>* arrival)
   {
-    return cache.find(id)->second.first;
+    const auto id = meta.common.image_id;
+    s.frame = meta;
+    s.first_arrival.store(clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    auto words = new_image_words;
+    words[module / modules_per_word] &= ~(uint64_t{1} << (module % modules_per_word));
+    for (auto i = 0u; i < n_words; i++)
+      s.missing[i].store(word_tag(id) | words[i], std::memory_order_relaxed);
+    s.state.store(tag(id), std::memory_order_release);
+
+    for (auto e = end.load(); e <= id;)
+      end.compare_exchange_weak(e, id + 1);
+    const bool complete = words == std::array<uint64_t, n_words>{};
+    if (arrival) *arrival = module_arrival{module, {}, complete};
+    if (evicted || complete) notify();
+    return evicted;
   }
 
-  [[nodiscard]] bool is_new_image(utils::image_id id) const
+  // returns nullopt when the slot got reused meanwhile and the frame has to be processed again
+  std::optional<std::size_t> update_module_mask_for_image(slot& s,
+                                                          utils::image_id id,
+                                                          std::size_t module,
+                                                          std::optional<module_arrival>* arrival)
   {
-    return cache.find(id) == cache.end();
+    auto& word = s.missing[module / modules_per_word];
+    const auto module_bit = uint64_t{1} << (module % modules_per_word);
+
+    auto value = word.load(std::memory_order_relaxed);
+    do {
+      if ((value & ~word_modules) != word_tag(id)) return std::nullopt;
+      // Has this module already arrived for this image_id?
+      if (!(value & module_bit)) {
+        if (has_deadline()) {
+          duplicated_modules.fetch_add(1, std::memory_order_relaxed);
+          return 0;
+        }
+        drop_image(s, id);
+        return 1;
+      }
+    } while (!word.compare_exchange_weak(value, value & ~module_bit, std::memory_order_acq_rel,
+                                         std::memory_order_relaxed));
+
+    // last module of the word - the popping thread checks if the whole image is complete
+    const bool word_complete = (value & ~module_bit & word_modules) == 0;
+    if (arrival)
+      *arrival = module_arrival{module, clock::now() - first_arrival(s),
+                                word_complete && missing_modules(s).none()};
+    if (word_complete) notify();
+    return 0;
+  }
+
+  void drop_image(slot& s, utils::image_id id)
+  {
+    auto state = tag(id);
+    if (s.state.compare_exchange_strong(state, busy_slot, std::memory_order_acquire)) {
+      release(s);
+      notify();
+    }
   }
 
-  [[nodiscard]] bool is_queue_too_long() const { return cache.size() > n_images_buffer; }
+  // clearing tags makes pending updates of the released image fail
+  static void release(slot& s)
+  {
+    for (auto& word : s.missing)
+      word.store(0, std::memory_order_relaxed);
+    s.state.store(free_slot, std::memory_order_release);
+  }
+
+  // futex syscall is done only when the popping thread sleeps - flag and counter are checked
+  // in opposite order on both sides so that the wake up cannot be missed
+  void notify()
+  {
+    events.fetch_add(1);
+    if (n_sleeping.load() != 0)
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&events), FUTEX_WAKE_PRIVATE, INT_MAX,
+              nullptr, nullptr, 0);
+  }
+
+  void futex_wait(uint32_t seen, const timespec* timeout) const
+  {
+    n_sleeping.fetch_add(1);
+    if (events.load() == seen)
+      syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&events), FUTEX_WAIT_PRIVATE, seen,
+              timeout, nullptr, 0);
+    n_sleeping.fetch_sub(1, std::memory_order_release);
+  }
 };
@@ -11,64 +11,39 @@
 
 #include "core_buffer/buffer_utils.hpp"
 #include "detectors/common.hpp"
-#include "detectors/gigafrost.hpp"
-#include "detectors/jungfrau.hpp"
-#include "detectors/eiger.hpp"
 #include "utils/utils.hpp"
-#include "std_buffer/image_metadata.pb.h"
 
+#include "image_metadata.hpp"
 #include "synchronizer.hpp"
 
 using namespace std;
 
 namespace {
 
-template<typename FrameType>
-void fill_detector_specific_data(const FrameType&,  std_daq_protocol::ImageMetadata&)
-{
-  spdlog::error("Unsupported type of data - wrong detector configured");
-}
-
-template<>
-void fill_detector_specific_data(const gf::GFFrame& data,  std_daq_protocol::ImageMetadata& meta)
-{
-  meta.mutable_gf()->set_exposure_time(data.exposure_time);
-  meta.mutable_gf()->set_frame_timestamp(data.frame_timestamp);
-  meta.mutable_gf()->set_scan_id(data.scan_id);
-  meta.mutable_gf()->set_scan_time(data.scan_time);
-  meta.mutable_gf()->set_sync_time(data.sync_time);
-  meta.mutable_gf()->set_store_image(!data.do_not_store);
-}
-
-template<>
-void fill_detector_specific_data(const jf::JFFrame& data,  std_daq_protocol::ImageMetadata& meta)
-{
-  meta.mutable_jf()->set_daq_rec(data.daq_rec);
-}
-
-template<>
-void fill_detector_specific_data(const eg::EGFrame&,  std_daq_protocol::ImageMetadata& meta)
-{
-  // TODO: make data available
-  meta.mutable_eg()->set_exptime(0);
-}
-
 template<typename FrameType>
 void process_received_modules(const utils::DetectorConfig& config,
                               void* ctx,
                               std::shared_ptr<Synchronizer<FrameType>> syncer)
 {
-  utils::stats::SyncStatsCollector stats(config.detector_name, config.stats_collection_period);
+  utils::stats::SyncStatsCollector stats(config.detector_name, config.stats_collection_period,
+                                         config.n_modules);
+  std::optional<typename Synchronizer<FrameType>::module_arrival> arrival;
   char meta_buffer_recv[DET_FRAME_STRUCT_BYTES];
   auto* common_frame = (FrameType*)(&meta_buffer_recv);
 
   auto receiver = buffer_utils::bind_socket(ctx, config.detector_name + "-sync", ZMQ_PULL);
 
   while (true) {
-    if (zmq_recv(receiver, meta_buffer_recv, DET_FRAME_STRUCT_BYTES, 0) > 0) {
-      auto n_corrupted_images = syncer->process_image_metadata(*common_frame);
+    // blocking receive waits for the burst, the rest of it is drained without waking up again
+    for (auto flags = 0; zmq_recv(receiver, meta_buffer_recv, DET_FRAME_STRUCT_BYTES, flags) > 0;
+         flags = ZMQ_DONTWAIT) {
+      auto n_corrupted_images = syncer->process_image_metadata(*common_frame, arrival);
       stats.process(n_corrupted_images);
+      if (arrival) stats.process_arrival(arrival->module_id, arrival->offset, arrival->last);
     }
+    const auto counters = syncer->take_counters();
+    stats.process_deadline(counters.partial_images, counters.late_modules,
+                           counters.duplicated_modules);
     stats.print_stats();
   }
 }
@@ -78,32 +53,24 @@ void send_synchronized_images(const utils::DetectorConfig& config,
                               void* ctx,
                               std::shared_ptr<Synchronizer<FrameType>> syncer)
 {
-  using namespace std::chrono_literals;
-  std_daq_protocol::ImageMetadata image_meta;
-  image_meta.set_dtype(utils::get_metadata_dtype(config));
-  image_meta.set_height(config.image_pixel_height);
-  image_meta.set_width(config.image_pixel_width);
-  image_meta.set_size(utils::converted_image_n_bytes(config));
-  image_meta.set_compression(std_daq_protocol::none);
+  auto image_meta = create_image_metadata(config);
+  std::string meta_buffer_send;
 
   auto sender = buffer_utils::bind_socket(ctx, config.detector_name + "-image", ZMQ_PUB);
 
   while (true) {
-    if (auto meta = syncer->pop_next_full_image(); meta) {
-      image_meta.set_image_id(meta->common.image_id);
-      if (meta->common.n_missing_packets == 0)
-        image_meta.set_status(std_daq_protocol::ImageMetadataStatus::good_image);
-      else
-        image_meta.set_status(std_daq_protocol::ImageMetadataStatus::missing_packets);
-
-      fill_detector_specific_data(*meta, image_meta);
-
-      std::string meta_buffer_send;
+    // events are read before popping - completion in between does not get lost
+    const auto seen_events = syncer->events_count();
+    while (auto image = syncer->pop_next_image()) {
+      fill_image_metadata(image->frame, image->missing, image_meta);
       image_meta.SerializeToString(&meta_buffer_send);
       zmq_send(sender, meta_buffer_send.c_str(), meta_buffer_send.size(), 0);
     }
+    // with deadline the oldest pending image has to be released even if nothing else arrives
+    if (const auto timeout = syncer->time_to_deadline())
+      syncer->wait_for_events(seen_events, *timeout);
     else
-      std::this_thread::sleep_for(1ms);
+      syncer->wait_for_events(seen_events);
   }
 }
 
@@ -123,7 +90,8 @@ int main(int argc, char* argv[])
   if(config.detector_type == "gigafrost")
   {
      auto syncer = std::make_shared<Synchronizer<gf::GFFrame>>(config.n_modules, config.module_sync_queue_size,
-                                                               utils::get_modules_mask(config));
+                                                               utils::get_modules_mask(config),
+                                                               config.module_sync_timeout);
 
      std::jthread processing_metadata_thread(process_received_modules<gf::GFFrame>, config, ctx, syncer);
      std::jthread sending_synchronized_images_thread(send_synchronized_images<gf::GFFrame>, config, ctx, syncer);
@@ -131,7 +99,8 @@ int main(int argc, char* argv[])
   else if(config.detector_type == "eiger")
   {
     auto syncer = std::make_shared<Synchronizer<eg::EGFrame>>(config.n_modules, config.module_sync_queue_size,
-                                                              utils::get_modules_mask(config));
+                                                              utils::get_modules_mask(config),
+                                                              config.module_sync_timeout);
 
     std::jthread processing_metadata_thread(process_received_modules<eg::EGFrame>, config, ctx, syncer);
     std::jthread sending_synchronized_images_thread(send_synchronized_images<eg::EGFrame>, config, ctx, syncer);
@@ -139,7 +108,8 @@ int main(int argc, char* argv[])
   else if(config.detector_type.starts_with("jungfrau"))
   {
     auto syncer = std::make_shared<Synchronizer<jf::JFFrame>>(config.n_modules, config.module_sync_queue_size,
-                                                              utils::get_modules_mask(config));
+                                                              utils::get_modules_mask(config),
+                                                              config.module_sync_timeout);
 
     std::jthread processing_metadata_thread(process_received_modules<jf::JFFrame>, config, ctx, syncer);
     std::jthread sending_synchronized_images_thread(send_synchronized_images<jf::JFFrame>, config, ctx, syncer);
@@ -3,73 +3,179 @@
 /////////////////////////////////////////////////////////////////////
 
 #include "synchronizer.hpp"
+#include "latency_counters.hpp"
+#include "detectors/eiger.hpp"
 #include "detectors/gigafrost.hpp"
+#include "detectors/jungfrau.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
 namespace {
 
-const int n_modules = 8;
-const int sync_n_images_buffer = 10000;
+using namespace sync_benchmark;
+
 const int tested_frequency = 2000;
 
-  int correct_stream_sync(Synchronizer<gf::GFFrame>& syncer)
+// modules reported and images popped by one thread - latency is measured from the start of
+// the call reporting the completing module to the image being popped
+template <typename FrameType, arrival_pattern pattern> void Module_sync(benchmark::State& state)
 {
-  gf::GFFrame meta{};
-
-  for (int i = 0; i < tested_frequency; i++) {
-    meta.common.image_id = i;
-    for (int i_module = 0; i_module < n_modules; i_module++) {
-      meta.common.module_id = i_module;
-
-      auto result = syncer.process_image_metadata(meta);
-      (void)result;
+  const auto n_modules = static_cast<int>(state.range(0));
+  const auto arrivals = generate_arrivals(n_modules, tested_frequency, pattern);
+  Synchronizer<FrameType> syncer(n_modules, static_cast<int>(state.range(1)));
+  LatencyCounters latencies;
+
+  FrameType meta{};
+  uint64_t first_image = 0;
+  std::size_t n_emitted = 0;
+  std::size_t n_corrupted = 0;
+  for (auto _ : state) {
+    for (const auto& a : arrivals) {
+      meta.common.image_id = first_image + a.image_offset;
+      meta.common.module_id = a.module_id;
+      const auto start = clock::now();
+      n_corrupted += syncer.process_image_metadata(meta);
+      while (syncer.pop_next_full_image()) {
+        latencies.add(start, clock::now());
+        n_emitted++;
+      }
     }
+    first_image += tested_frequency;
   }
-  return 0;
-}
-
-void GF_sync_normal(benchmark::State& state)
-{
-  Synchronizer<gf::GFFrame> syncer(n_modules, sync_n_images_buffer);
 
-  for (auto _ : state) {
-    benchmark::DoNotOptimize(correct_stream_sync(syncer));
-  }
+  latencies.report(state);
+  state.counters["emitted"] =
+      benchmark::Counter(static_cast<double>(n_emitted), benchmark::Counter::kAvgIterations);
+  state.counters["corrupted"] =
+      benchmark::Counter(static_cast<double>(n_corrupted), benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * tested_frequency);
 }
 
-int missing_stream_sync(Synchronizer<gf::GFFrame>& syncer)
+// modules are reported concurrently by n_producers threads, each owning every n-th module and
+// running at detector rate, while the sender thread pops images as in std_data_sync_module -
+// latency is measured from the last module being reported to the image being popped. Images
+// evicted from the ring are never popped, so the sender stops once the producers are done and
+// nothing is left to pop, and they are reported as dropped.
+template <typename FrameType, arrival_pattern pattern>
+void Module_sync_threads(benchmark::State& state)
 {
-  gf::GFFrame meta{};
-
-  for (int i_frame = 0; i_frame < tested_frequency; i_frame++) {
-    meta.common.image_id = i_frame;
-    for (int i_module = 0; i_module < n_modules - 1; i_module++) {
-      meta.common.module_id = i_module;
-
-      auto result = syncer.process_image_metadata(meta);
-      (void)result;
+  const auto n_modules = static_cast<int>(state.range(0));
+  const auto n_producers = static_cast<int>(state.range(1));
+  const auto n_images = static_cast<std::size_t>(tested_frequency);
+  const auto arrivals = generate_arrivals(n_modules, tested_frequency, pattern);
+  Synchronizer<FrameType> syncer(n_modules, 50);
+  // time of the last module reported by each producer for every image
+  std::vector<clock::time_point> reported(n_images * n_producers);
+  std::vector<clock::time_point> popped(n_images);
+  LatencyCounters latencies;
+
+  uint64_t first_image = 0;
+  std::size_t n_dropped = 0;
+  for (auto _ : state) {
+    std::ranges::fill(popped, clock::time_point{});
+    std::atomic<bool> producers_done = false;
+    std::jthread sender([&] {
+      for (std::size_t n_popped = 0; n_popped < n_images;) {
+        // read before popping - all modules reported by then are visible to the pops below
+        const auto done = producers_done.load(std::memory_order_acquire);
+        const auto seen = syncer.events_count();
+        while (auto meta = syncer.pop_next_full_image()) {
+          popped[meta->common.image_id - first_image] = clock::now();
+          n_popped++;
+        }
+        if (done) break;
+        if (n_popped < n_images) syncer.wait_for_events(seen, std::chrono::milliseconds(1));
+      }
+    });
+
+    {
+      std::vector<std::jthread> producers;
+      for (auto p = 0; p < n_producers; p++)
+        producers.emplace_back([&, p] {
+          FrameType meta{};
+          auto previous_image = arrivals.front().image_offset;
+          for (const auto& a : arrivals) {
+            if (a.module_id % n_producers != p) continue;
+            // detector rate - the sender keeps up and the ring never overflows
+            if (a.image_offset > previous_image) {
+              std::this_thread::sleep_for(std::chrono::microseconds(50));
+              previous_image = a.image_offset;
+            }
+            meta.common.image_id = first_image + a.image_offset;
+            meta.common.module_id = a.module_id;
+            reported[a.image_offset * n_producers + p] = clock::now();
+            benchmark::DoNotOptimize(syncer.process_image_metadata(meta));
+          }
+        });
     }
-    if (i_frame % 2 == 0) {
-      meta.common.module_id = 7;
-      auto result = syncer.process_image_metadata(meta);
-      (void)result;
+    producers_done.store(true, std::memory_order_release);
+    sender.join();
+
+    for (auto i = 0u; i < n_images; i++) {
+      if (popped[i] == clock::time_point{}) {
+        n_dropped++;
+        continue;
+      }
+      const auto first = reported.begin() + static_cast<std::ptrdiff_t>(i * n_producers);
+      latencies.add(*std::max_element(first, first + n_producers), popped[i]);
     }
+    first_image += n_images;
   }
-  return 0;
-}
 
-void GF_sync_missing(benchmark::State& state)
-{
-  Synchronizer<gf::GFFrame> syncer(n_modules, sync_n_images_buffer);
-
-  for (auto _ : state) {
-    benchmark::DoNotOptimize(missing_stream_sync(syncer));
-  }
+  latencies.report(state);
+  state.counters["dropped"] =
+      benchmark::Counter(static_cast<double>(n_dropped), benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * tested_frequency);
 }
+
 } // namespace
 
-BENCHMARK(GF_sync_normal);
-BENCHMARK(GF_sync_missing);
+BENCHMARK_TEMPLATE(Module_sync, gf::GFFrame, arrival_pattern::in_order)
+    ->ArgNames({"modules", "queue"})
+    ->Args({8, 10000});
+BENCHMARK_TEMPLATE(Module_sync, gf::GFFrame, arrival_pattern::missing)
+    ->ArgNames({"modules", "queue"})
+    ->Args({8, 10000});
+BENCHMARK_TEMPLATE(Module_sync, eg::EGFrame, arrival_pattern::in_order)
+    ->ArgNames({"modules", "queue"})
+    ->Args({4, 50});
+BENCHMARK_TEMPLATE(Module_sync, eg::EGFrame, arrival_pattern::reordered)
+    ->ArgNames({"modules", "queue"})
+    ->Args({4, 50});
+BENCHMARK_TEMPLATE(Module_sync, jf::JFFrame, arrival_pattern::in_order)
+    ->ArgNames({"modules", "queue"})
+    ->Args({32, 50});
+BENCHMARK_TEMPLATE(Module_sync, jf::JFFrame, arrival_pattern::reordered)
+    ->ArgNames({"modules", "queue"})
+    ->Args({32, 50});
+BENCHMARK_TEMPLATE(Module_sync, jf::JFFrame, arrival_pattern::missing)
+    ->ArgNames({"modules", "queue"})
+    ->Args({32, 50});
+BENCHMARK_TEMPLATE(Module_sync, jf::JFFrame, arrival_pattern::overflow)
+    ->ArgNames({"modules", "queue"})
+    ->Args({32, 50});
+
+BENCHMARK_TEMPLATE(Module_sync_threads, jf::JFFrame, arrival_pattern::in_order)
+    ->ArgNames({"modules", "producers"})
+    ->Args({32, 1})
+    ->Args({32, 4})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Module_sync_threads, jf::JFFrame, arrival_pattern::reordered)
+    ->ArgNames({"modules", "producers"})
+    ->Args({32, 4})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Module_sync_threads, eg::EGFrame, arrival_pattern::in_order)
+    ->ArgNames({"modules", "producers"})
+    ->Args({4, 2})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
 
 BENCHMARK_MAIN();
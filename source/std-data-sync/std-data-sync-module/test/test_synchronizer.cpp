@@ -95,3 +95,217 @@ TEST_F(SynchronizerWithModuleMapTest, ShouldSyncImageWhenAllModulesAreReceived)
   EXPECT_EQ(frame.common.image_id, sync.pop_next_full_image()->common.image_id);
   EXPECT_FALSE(sync.pop_next_full_image());
 }
+
+TEST_F(SynchronizerWithoutModuleMapTest, ShouldDropStaleModuleOfAlreadyReleasedImage)
+{
+  gf::GFFrame frame{};
+  frame.common.image_id = 5;
+  EXPECT_EQ(0, sync.process_image_metadata(frame));
+  frame.common.module_id = 1;
+  EXPECT_EQ(0, sync.process_image_metadata(frame));
+  EXPECT_EQ(5, sync.pop_next_full_image()->common.image_id);
+
+  EXPECT_EQ(1, sync.process_image_metadata(frame));
+  EXPECT_FALSE(sync.pop_next_full_image());
+}
+
+TEST_F(SynchronizerWithoutModuleMapTest, ShouldAcceptImagesOfRestartedAcquisition)
+{
+  gf::GFFrame frame{};
+  for (auto module_id : {0, 1}) {
+    frame.common.image_id = 1000;
+    frame.common.module_id = module_id;
+    EXPECT_EQ(0, sync.process_image_metadata(frame));
+  }
+  EXPECT_EQ(1000, sync.pop_next_full_image()->common.image_id);
+
+  for (auto module_id : {0, 1}) {
+    frame.common.image_id = 1;
+    frame.common.module_id = module_id;
+    EXPECT_EQ(0, sync.process_image_metadata(frame));
+  }
+  EXPECT_EQ(1, sync.pop_next_full_image()->common.image_id);
+}
+
+TEST(SynchronizerRestart, ShouldReclaimLeftoverIncompleteImage)
+{
+  Synchronizer<gf::GFFrame> sync{2, 5};
+  gf::GFFrame frame{};
+  frame.common.image_id = 11;
+  EXPECT_EQ(0, sync.process_image_metadata(frame));
+  EXPECT_FALSE(sync.pop_next_full_image());
+
+  // the first image of the new acquisition drops the incomplete one of the previous
+  for (auto id : {1u, 6u, 11u}) {
+    frame.common.image_id = id;
+    frame.common.module_id = 0;
+    EXPECT_EQ(id == 1 ? 1 : 0, sync.process_image_metadata(frame));
+    frame.common.module_id = 1;
+    EXPECT_EQ(0, sync.process_image_metadata(frame));
+    EXPECT_EQ(id, sync.pop_next_full_image()->common.image_id);
+  }
+}
+
+TEST(SynchronizerRestart, ShouldAcceptRestartAfterShortPreviousRun)
+{
+  Synchronizer<gf::GFFrame> sync{2, 50};
+  gf::GFFrame frame{};
+  for (auto run = 0; run < 2; run++)
+    for (auto id = 1u; id <= 10; id++) {
+      for (auto module_id : {0, 1}) {
+        frame.common.image_id = id;
+        frame.common.module_id = module_id;
+        EXPECT_EQ(0, sync.process_image_metadata(frame));
+      }
+      const auto image = sync.pop_next_full_image();
+      ASSERT_TRUE(image);
+      EXPECT_EQ(id, image->common.image_id);
+    }
+}
+
+TEST_F(SynchronizerWithoutModuleMapTest, ShouldSignalEventWhenImageIsCompleted)
+{
+  gf::GFFrame frame{};
+  const auto seen = sync.events_count();
+  frame.common.image_id = 7;
+  EXPECT_EQ(0, sync.process_image_metadata(frame));
+  EXPECT_EQ(seen, sync.events_count());
+
+  frame.common.module_id = 1;
+  std::jthread reporter([&] { sync.process_image_metadata(frame); });
+  sync.wait_for_events(seen);
+  EXPECT_NE(seen, sync.events_count());
+}
+
+TEST(SynchronizerConcurrency, ShouldSyncImagesReportedFromManyThreads)
+{
+  constexpr auto n_modules = 32;
+  constexpr auto n_images = 2000u;
+  Synchronizer<gf::GFFrame> sync{n_modules, 64};
+
+  std::atomic<utils::image_id> released{0};
+  std::vector<utils::image_id> popped;
+  std::jthread consumer([&](std::stop_token stop) {
+    while (!stop.stop_requested() && popped.size() < n_images) {
+      const auto seen = sync.events_count();
+      while (auto meta = sync.pop_next_full_image()) {
+        popped.push_back(meta->common.image_id);
+        released = popped.size();
+        released.notify_all();
+      }
+      if (popped.size() < n_images) sync.wait_for_events(seen);
+    }
+  });
+
+  {
+    std::vector<std::jthread> modules;
+    for (auto m = 0; m < n_modules; m++)
+      modules.emplace_back([&, m] {
+        gf::GFFrame frame{};
+        frame.common.module_id = m;
+        for (auto id = 0u; id < n_images; id++) {
+          // keep within the ring - producers are throttled by the consumer
+          for (auto r = released.load(); id >= r + 32; r = released.load())
+            released.wait(r);
+          frame.common.image_id = id;
+          ASSERT_EQ(0, sync.process_image_metadata(frame));
+        }
+      });
+  }
+  consumer.join();
+
+  ASSERT_EQ(n_images, popped.size());
+  for (auto i = 0u; i < n_images; i++)
+    ASSERT_EQ(i, popped[i]);
+}
+
+struct SynchronizerWithDeadlineTest : public ::testing::Test
+{
+  static const auto modules = 4u;
+  static const auto queue_size = 8u;
+  static constexpr std::chrono::milliseconds deadline{20};
+  Synchronizer<gf::GFFrame> sync{modules, queue_size, {}, deadline};
+
+  void report(utils::image_id id, std::initializer_list<uint16_t> module_ids)
+  {
+    gf::GFFrame frame{};
+    frame.common.image_id = id;
+    for (auto module_id : module_ids) {
+      frame.common.module_id = module_id;
+      EXPECT_EQ(0, sync.process_image_metadata(frame));
+    }
+  }
+};
+
+TEST_F(SynchronizerWithDeadlineTest, ShouldReleaseIncompleteImageAfterDeadline)
+{
+  report(1, {0, 2, 3});
+  report(2, {0, 1, 2, 3});
+  EXPECT_FALSE(sync.pop_next_image());
+  ASSERT_TRUE(sync.time_to_deadline());
+  EXPECT_LE(*sync.time_to_deadline(), deadline);
+
+  std::this_thread::sleep_for(deadline);
+  const auto image = sync.pop_next_image();
+  ASSERT_TRUE(image);
+  EXPECT_EQ(1, image->frame.common.image_id);
+  EXPECT_EQ(std::bitset<128>("10"), image->missing);
+
+  const auto next = sync.pop_next_image();
+  ASSERT_TRUE(next);
+  EXPECT_EQ(2, next->frame.common.image_id);
+  EXPECT_TRUE(next->missing.none());
+  EXPECT_EQ(1u, sync.take_counters().partial_images);
+}
+
+TEST_F(SynchronizerWithDeadlineTest, ShouldCountLateAndDuplicatedModules)
+{
+  report(1, {0, 1, 1, 2});
+  std::this_thread::sleep_for(deadline);
+  EXPECT_EQ(1, sync.pop_next_image()->frame.common.image_id);
+
+  report(1, {3});
+  const auto counters = sync.take_counters();
+  EXPECT_EQ(1u, counters.partial_images);
+  EXPECT_EQ(1u, counters.late_modules);
+  EXPECT_EQ(1u, counters.duplicated_modules);
+  EXPECT_EQ(0u, sync.take_counters().late_modules);
+}
+
+TEST_F(SynchronizerWithDeadlineTest, ShouldWakeUpWaitingThreadAfterTimeout)
+{
+  const auto start = std::chrono::steady_clock::now();
+  sync.wait_for_events(sync.events_count(), std::chrono::milliseconds(5));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(5));
+}
+
+TEST_F(SynchronizerWithDeadlineTest, ShouldReportModuleArrivalOffsets)
+{
+  using arrival_t = std::optional<Synchronizer<gf::GFFrame>::module_arrival>;
+  gf::GFFrame frame{};
+  frame.common.image_id = 3;
+  arrival_t first, late, last;
+
+  EXPECT_EQ(0, sync.process_image_metadata(frame, first));
+  ASSERT_TRUE(first);
+  EXPECT_EQ(0u, first->module_id);
+  EXPECT_EQ(0, first->offset.count());
+  EXPECT_FALSE(first->last);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  frame.common.module_id = 2;
+  sync.process_image_metadata(frame, late);
+  ASSERT_TRUE(late);
+  EXPECT_GE(late->offset, std::chrono::milliseconds(2));
+  EXPECT_FALSE(late->last);
+
+  report(3, {1});
+  frame.common.module_id = 3;
+  sync.process_image_metadata(frame, last);
+  ASSERT_TRUE(last);
+  EXPECT_EQ(3u, last->module_id);
+  EXPECT_TRUE(last->last);
+
+  sync.process_image_metadata(frame, last);
+  EXPECT_FALSE(last);
+}
@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "synchronizer.hpp"
+#include "latency_counters.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+using namespace sync_benchmark;
+
+const int sync_n_images_buffer = 1000;
+const int tested_frequency = 2000;
+
+// parts are processed by single thread in std_data_sync_stream - image is emitted by the call
+// receiving its last part, latency is the duration of that call
+template <arrival_pattern pattern> void Stream_sync(benchmark::State& state)
+{
+  const auto n_parts = static_cast<int>(state.range(0));
+  const auto arrivals = generate_arrivals(n_parts, tested_frequency, pattern);
+  Synchronizer syncer(n_parts, sync_n_images_buffer);
+  LatencyCounters latencies;
+
+  uint64_t first_image = 0;
+  std::size_t n_emitted = 0;
+  std::size_t n_corrupted = 0;
+  for (auto _ : state) {
+    for (const auto& a : arrivals) {
+      const auto start = clock::now();
+      const auto [id, n_corrupted_images] =
+          syncer.process_image_metadata(first_image + a.image_offset);
+      if (id != INVALID_IMAGE_ID) {
+        latencies.add(start, clock::now());
+        n_emitted++;
+      }
+      n_corrupted += n_corrupted_images;
+    }
+    first_image += tested_frequency;
+  }
+
+  latencies.report(state);
+  state.counters["emitted"] =
+      benchmark::Counter(static_cast<double>(n_emitted), benchmark::Counter::kAvgIterations);
+  state.counters["corrupted"] =
+      benchmark::Counter(static_cast<double>(n_corrupted), benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * tested_frequency);
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(Stream_sync, arrival_pattern::in_order)->Arg(4)->Arg(8);
+BENCHMARK_TEMPLATE(Stream_sync, arrival_pattern::reordered)->Arg(8);
+BENCHMARK_TEMPLATE(Stream_sync, arrival_pattern::missing)->Arg(8);
+BENCHMARK_TEMPLATE(Stream_sync, arrival_pattern::overflow)->Arg(8);
+
+BENCHMARK_MAIN();
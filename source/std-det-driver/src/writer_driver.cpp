@@ -81,8 +81,9 @@ void writer_driver::start(const run_settings& settings)
     self->send_create_file_requests(settings.path, settings.writer);
     if (self->did_all_writers_acknowledge()) {
       self->manager->change_state(driver_state::waiting_for_first_image);
-      self->record_images(settings.n_images);
-      if (self->did_all_writers_record_data()) self->send_save_file_requests();
+      const auto n_recorded = self->record_images(settings.n_images);
+      if (self->did_all_writers_record_data())
+        self->send_save_file_requests(settings.path, settings.writer, n_recorded);
     }
     else
       self->manager->change_state(driver_state::error);
@@ -187,19 +188,33 @@ bool writer_driver::did_all_writers_acknowledge()
   return files_created == writer_receive_sockets.size();
 }
 
+bool writer_driver::did_writer_acknowledge(const std::size_t index)
+{
+  char buffer[512];
+  std_daq_protocol::WriterResponse response;
+  if (const auto n_bytes = zmq_recv(writer_receive_sockets[index], buffer, sizeof(buffer), 0);
+      n_bytes > 0)
+  {
+    response.ParseFromArray(buffer, n_bytes);
+    return response.code() != std_daq_protocol::ResponseCode::FAILURE;
+  }
+  return false;
+}
+
 std::size_t writer_driver::get_current_writer_index(const unsigned int index) const
 {
   if (with_metadata_writer) return 1 + (index % (writer_send_sockets.size() - 1));
   return index % writer_send_sockets.size();
 }
 
-void writer_driver::record_images(const std::size_t n_images)
+std::size_t writer_driver::record_images(const std::size_t n_images)
 {
   std_daq_protocol::ImageMetadata meta;
   std::string cmd;
 
   subscribe(sync_receive_socket);
-  for (auto i = 0u; i < n_images && manager->is_recording();) {
+  auto i = 0u;
+  while (i < n_images && manager->is_recording()) {
     char buffer[512];
     if (const auto n_bytes = zmq_recv(sync_receive_socket, buffer, sizeof(buffer), 0); n_bytes > 0)
     {
@@ -216,9 +231,12 @@ void writer_driver::record_images(const std::size_t n_images)
     }
   }
   unsubscribe(sync_receive_socket);
+  return i;
 }
 
-void writer_driver::send_save_file_requests()
+void writer_driver::send_save_file_requests(std::string_view base_path,
+                                            const writer_id id,
+                                            const std::size_t n_images)
 {
   manager->change_state(driver_state::saving_file);
 
@@ -226,12 +244,33 @@ void writer_driver::send_save_file_requests()
   action.mutable_close_file();
   send_command_to_all_writers(action);
 
-  if (did_all_writers_acknowledge())
+  if (did_all_writers_acknowledge() && create_master_file(base_path, id, n_images))
     manager->change_state(driver_state::file_saved);
   else
     manager->change_state(driver_state::error);
 }
 
+// images were sent round-robin - the first image writer maps all image writer files into single
+// ordered view once they are closed
+bool writer_driver::create_master_file(std::string_view base_path,
+                                       const writer_id id,
+                                       const std::size_t n_images)
+{
+  std_daq_protocol::WriterAction action;
+  auto* master_file = action.mutable_create_master_file();
+  master_file->set_path(fmt::format("{}Master.h5", base_path));
+  master_file->set_writer_id(id);
+  master_file->set_n_images(n_images);
+  const auto first_image_writer = get_current_writer_index(0);
+  for (auto i = first_image_writer; i < writer_send_sockets.size(); i++)
+    master_file->add_sources(generate_file_path_for_writer(base_path, i));
+
+  std::string cmd;
+  action.SerializeToString(&cmd);
+  zmq_send(writer_send_sockets[first_image_writer], cmd.c_str(), cmd.size(), 0);
+  return did_writer_acknowledge(first_image_writer);
+}
+
 bool writer_driver::did_all_writers_record_data()
 {
   std_daq_protocol::WriterAction action;
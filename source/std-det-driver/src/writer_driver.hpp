@@ -43,11 +43,13 @@ private:
   std::size_t get_current_writer_index(unsigned int index) const;
   void* prepare_sync_receiver_socket(const std::string& source_name) const;
   void send_create_file_requests(std::string_view base_path, writer_id id) const;
-  void record_images(std::size_t n_images);
+  std::size_t record_images(std::size_t n_images);
   void send_command_to_all_writers(const std_daq_protocol::WriterAction& action);
-  void send_save_file_requests();
+  void send_save_file_requests(std::string_view base_path, writer_id id, std::size_t n_images);
+  bool create_master_file(std::string_view base_path, writer_id id, std::size_t n_images);
   bool did_all_writers_record_data();
   bool did_all_writers_acknowledge();
+  bool did_writer_acknowledge(std::size_t index);
 };
 
 } // namespace std_driver
@@ -0,0 +1,110 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "std_buffer/image_metadata.pb.h"
+#include "utils/detector_config.hpp"
+#include "module_chunk_compressor.hpp"
+
+#include <hdf5.h>
+
+struct blosc2_schunk;
+
+class HDF5File
+{
+public:
+  // module_chunks - images of the source are compressed per module by std_data_convert
+  // direct_io - image chunks bypass the page cache, only for uncompressed sources
+  explicit HDF5File(const utils::DetectorConfig& config,
+                    const std::string& filename,
+                    std::string_view suffix,
+                    bool module_chunks = false,
+                    bool direct_io = false);
+  ~HDF5File();
+
+  void write(const std_daq_protocol::ImageMetadata& meta, const char* image);
+
+private:
+  // how images of the source are stored - compressed images are written as chunks as they are
+  enum class storage
+  {
+    raw,
+    h5bitshuffle_lz4,
+    blosc2,
+    delta_h5bitshuffle_lz4
+  };
+
+  struct h5_metadata
+  {
+    uint64_t image_id;
+    uint64_t status;
+  };
+
+  static storage to_storage(std::string_view suffix);
+  static std_daq_protocol::ImageMetadataCompression to_compression(storage s);
+  static hid_t create_datatype(std_daq_protocol::ImageMetadataDtype dtype);
+  void create_file(const std::string& filename);
+  void create_datasets(const std::string& detector_name);
+  void create_metadata_dataset(hid_t data_group_id);
+  void create_image_dataset(hid_t data_group_id);
+  void set_image_filter(hid_t dcpl_id) const;
+  void extend_image_dataset();
+  void write_image(const char* data, std::size_t data_size);
+  void write_images(const char* data, hsize_t n_images);
+  void write_direct(hsize_t first_image);
+  void flush_images();
+  void flush_metadata();
+  void write_chunk(std_daq_protocol::ImageMetadataCompression compression,
+                   hsize_t y,
+                   hsize_t x,
+                   const char* data,
+                   std::size_t n_bytes);
+  const char* assemble_image(const std_daq_protocol::ImageMetadata& meta, const char* image);
+  void write_meta(const std_daq_protocol::ImageMetadata& meta);
+  void write_quantisation(const std_daq_protocol::ImageQuantisation& quantisation);
+
+  const storage image_storage;
+  const size_t image_height;
+  const size_t image_width;
+  const size_t image_size;
+  const size_t element_size;
+  // geometry of module chunks, empty when the source sends whole images
+  const std::vector<convert::chunk_geometry> modules;
+  // module chunks are HDF5 chunks of the dataset - otherwise they are assembled into the image
+  const bool is_module_grid;
+  const size_t gpfs_block_size;
+  const hsize_t images_per_chunk;
+  const hsize_t records_per_chunk;
+  const bool is_direct_io;
+  // chunk buffer rounded up to the direct I/O block - the padding lands in the alignment gap
+  const size_t batch_n_bytes;
+  int index;
+  bool is_quantisation_written = false;
+  std::vector<char> assembled_image;
+  std::vector<char> module_image;
+  // raw images and metadata records are buffered until the chunk they fill is complete
+  std::unique_ptr<char, decltype(&std::free)> image_batch{nullptr, &std::free};
+  hsize_t n_batched_images = 0;
+  std::vector<h5_metadata> metadata_batch;
+  hsize_t image_extent = 0;
+  hsize_t metadata_extent = 0;
+
+  hid_t image_type = -1;
+  hid_t metadata_type = -1;
+  hid_t file_id = -1;
+  hid_t image_ds = -1;
+  hid_t metadata_ds = -1;
+  hid_t image_file_space = -1;
+  hid_t image_chunk_space = -1;
+  hid_t metadata_file_space = -1;
+  hid_t metadata_chunk_space = -1;
+  int direct_fd = -1;
+  // holds the chunk of the last blosc2 frame
+  blosc2_schunk* frame_schunk = nullptr;
+};
@@ -0,0 +1,15 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+
+#include "std_buffer/writer_action.pb.h"
+
+// Creates file with `data` and `metadata` virtual datasets of the detector group - every writer
+// file is mapped with stride of the number of writers, so readers see images in recorded order
+// without merging the files. Types and image shape are taken from the first writer file.
+void create_master_file(const std::string& detector_name,
+                        const std_daq_protocol::CreateMasterFile& command);
@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "std_buffer/writer_action.pb.h"
+
+// Writer actions are executed by single thread in the order of submission - file creation,
+// image writes, closing and confirmations stay ordered while the receiving thread keeps draining
+// its socket. Images are referenced by id only, their data stays in the ram buffer slot, so the
+// depth must stay well below the number of slots of the buffer.
+class WriteQueue
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct job
+  {
+    std_daq_protocol::WriterAction action;
+    // time the submitting thread waited for free place in the queue
+    clock::duration stall{};
+    // actions in the queue when this one was taken, including itself
+    std::size_t depth = 0;
+  };
+
+  // called for every submitted action in order, never concurrently
+  using process_function = std::function<void(job&)>;
+  // called by the writing thread after every action and periodically while the queue is empty
+  using idle_function = std::function<void()>;
+
+  WriteQueue(std::size_t depth, process_function process, idle_function idle);
+  ~WriteQueue();
+
+  // blocks while the queue is full
+  void submit(const std_daq_protocol::WriterAction& action);
+
+private:
+  void run(std::stop_token stop);
+
+  process_function process;
+  idle_function idle;
+  std::vector<job> slots;
+  std::mutex mutex;
+  std::condition_variable_any work_available;
+  std::condition_variable space_available;
+  uint64_t next_submitted = 0;
+  uint64_t next_taken = 0;
+  std::jthread worker;
+};
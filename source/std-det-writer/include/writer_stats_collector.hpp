@@ -31,14 +31,17 @@ public:
 
     auto outcome =
         fmt::format("source={},id={},n_written_images={},avg_buffer_write_us={},max_buffer_"
-                    "write_us={},avg_throughput={:.2f}",
+                    "write_us={},avg_throughput={:.2f},max_queue_depth={},queue_stall_us={}",
                     source, writer_id, image_counter, avg_buffer_write, max_buffer_write.count(),
-                    avg_throughput);
+                    avg_throughput, max_queue_depth,
+                    std::chrono::duration_cast<std::chrono::microseconds>(total_stall).count());
 
     image_counter = 0;
     total_bytes = 0;
     total_buffer_write = 0ns;
     max_buffer_write = 0ns;
+    max_queue_depth = 0;
+    total_stall = 0ns;
 
     return outcome;
   }
@@ -57,6 +60,13 @@ public:
     max_buffer_write = max(max_buffer_write, write_duration);
   }
 
+  // depth of the write queue when the action was taken and how long its submission was blocked
+  void process_queue(std::size_t depth, std::chrono::nanoseconds stall)
+  {
+    max_queue_depth = std::max(max_queue_depth, depth);
+    total_stall += stall;
+  }
+
 private:
   [[nodiscard]] std::tuple<std::size_t, double> calculate_averages() const
   {
@@ -76,6 +86,8 @@ private:
   std::size_t total_bytes{};
   std::chrono::nanoseconds total_buffer_write{};
   std::chrono::nanoseconds max_buffer_write{};
+  std::size_t max_queue_depth{};
+  std::chrono::nanoseconds total_stall{};
   time_point writing_start;
   std::string source;
   std::size_t writer_id;
@@ -4,37 +4,188 @@
 
 #include "hdf5_file.hpp"
 
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <set>
+
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <blosc2.h>
 #include <spdlog/spdlog.h>
 #include <H5version.h>
+#include <bitshuffle/bitshuffle.h>
 #include <bitshuffle/bshuf_h5filter.h>
+#include <hdf5-blosc2/blosc2_filter.h>
 
 #include "core_buffer/buffer_config.hpp"
+#include "utils/get_metadata_dtype.hpp"
 #include "utils/image_size_calc.hpp"
+#include "temporal_delta.hpp"
 
 namespace {
 constexpr size_t max_ik_store = 8192;
-} // namespace
+// header of HDF5 bitshuffle filter chunk - big endian image size and block size
+constexpr size_t h5bitshuffle_header_n_bytes = 12;
+// alignment of offset, size and memory of O_DIRECT writes
+constexpr size_t direct_io_alignment = 4096;
+
+// hdf5-blosc2 filter keeps every chunk as blosc2 frame holding single blosc2 chunk - one
+// super-chunk per file is reused for all of them, only its chunk is replaced
+blosc2_schunk* create_frame_schunk(std::size_t element_size)
+{
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = static_cast<int32_t>(element_size);
+  blosc2_storage storage = BLOSC2_STORAGE_DEFAULTS;
+  storage.cparams = &cparams;
+  auto* schunk = blosc2_schunk_new(&storage);
+  if (schunk == nullptr) throw std::runtime_error("Cannot create blosc2 super-chunk.");
+  return schunk;
+}
+
+class blosc2_frame
+{
+public:
+  blosc2_frame(blosc2_schunk* schunk, const char* chunk)
+  {
+    // chunk is copied - the frame must not take ownership of the slot in the ram buffer
+    auto* data = reinterpret_cast<uint8_t*>(const_cast<char*>(chunk));
+    if ((schunk->nchunks == 0 ? blosc2_schunk_append_chunk(schunk, data, true)
+                              : blosc2_schunk_update_chunk(schunk, 0, data, true)) < 0 ||
+        (frame_n_bytes = blosc2_schunk_to_buffer(schunk, &frame, &needs_free)) < 0)
+      throw std::runtime_error("Cannot create blosc2 frame of compressed image.");
+  }
+  ~blosc2_frame()
+  {
+    if (needs_free) free(frame);
+  }
+  blosc2_frame(const blosc2_frame&) = delete;
+  blosc2_frame& operator=(const blosc2_frame&) = delete;
+
+  [[nodiscard]] const char* data() const { return reinterpret_cast<const char*>(frame); }
+  [[nodiscard]] std::size_t size() const { return static_cast<std::size_t>(frame_n_bytes); }
+
+private:
+  uint8_t* frame = nullptr;
+  int64_t frame_n_bytes = 0;
+  bool needs_free = false;
+};
+
+std::vector<convert::chunk_geometry> module_geometries(const utils::DetectorConfig& config,
+                                                       std::string_view suffix,
+                                                       bool module_chunks)
+{
+  if (!module_chunks) return {};
+  const convert::ModuleChunkCompressor compressor(config,
+                                                  convert::ModuleChunkCompressor::to_codec(suffix));
+  std::vector<convert::chunk_geometry> geometries;
+  for (auto i = 0; i < config.n_modules; i++)
+    geometries.push_back(compressor.geometry(i));
+  return geometries;
+}
+
+// modules of equal size placed at multiples of their size can be stored as chunks directly
+bool is_regular_grid(const std::vector<convert::chunk_geometry>& modules)
+{
+  if (modules.empty()) return false;
+  const auto& first = modules.front();
+  std::set<std::pair<uint32_t, uint32_t>> positions;
+  for (const auto& m : modules)
+    if (m.width != first.width || m.height != first.height || m.x % m.width != 0 ||
+        m.y % m.height != 0 || !positions.emplace(m.x, m.y).second)
+      return false;
+  return true;
+}
+
+// datasets grow at least twice at the time - they are truncated to written images on close
+hsize_t grown_extent(hsize_t current, hsize_t required, hsize_t step)
+{
+  return std::max((required + step - 1) / step * step, 2 * current);
+}
+
+size_t round_up(size_t n_bytes, size_t alignment)
+{
+  return (n_bytes + alignment - 1) / alignment * alignment;
+}
+
+void write_attribute(hid_t object_id, const char* name, hid_t type, const void* value)
+{
+  auto space_id = H5Screate(H5S_SCALAR);
+  auto attribute_id = H5Acreate(object_id, name, type, space_id, H5P_DEFAULT, H5P_DEFAULT);
+  if (attribute_id < 0 || H5Awrite(attribute_id, type, value) < 0)
+    throw std::runtime_error(fmt::format("Cannot write attribute {}.", name));
+  H5Aclose(attribute_id);
+  H5Sclose(space_id);
+}
+
+void write_attribute(hid_t object_id, const char* name, float value)
+{
+  write_attribute(object_id, name, H5T_NATIVE_FLOAT, &value);
+}
 
-typedef struct
+void write_attribute(hid_t object_id, const char* name, const std::string& value)
 {
-  uint64_t image_id;
-  uint64_t status;
-} h5_metadata;
+  auto type = H5Tcopy(H5T_C_S1);
+  H5Tset_size(type, value.size());
+  write_attribute(object_id, name, type, value.c_str());
+  H5Tclose(type);
+}
+} // namespace
 
 HDF5File::HDF5File(const utils::DetectorConfig& config,
                    const std::string& filename,
-                   std::string_view suffix)
-    : is_h5bitshuffle_lz4_compression(suffix == "h5bitshuffle-lz4")
+                   std::string_view suffix,
+                   bool module_chunks,
+                   bool direct_io)
+    : image_storage(to_storage(suffix))
     , image_height(config.image_pixel_height)
     , image_width(config.image_pixel_width)
-    , image_bit_depth(config.bit_depth)
     , image_size(utils::converted_image_n_bytes(config))
+    , element_size(utils::get_bytes_from_metadata_dtype(utils::get_metadata_dtype(config)))
+    , modules(module_geometries(config, suffix, module_chunks))
+    , is_module_grid(is_regular_grid(modules))
     , gpfs_block_size(config.gpfs_block_size)
+    // compressed images are written as they are - one image (or one module of it) per chunk
+    , images_per_chunk(
+          image_storage == storage::raw ? std::max<hsize_t>(1, gpfs_block_size / image_size) : 1)
+    , records_per_chunk(std::max<hsize_t>(1, gpfs_block_size / sizeof(h5_metadata)))
+    , is_direct_io(direct_io)
+    , batch_n_bytes(round_up(images_per_chunk * image_size, direct_io_alignment))
     , index(-1)
+    , image_type(create_datatype(utils::get_metadata_dtype(config)))
 
 {
+  if (module_chunks && image_storage == storage::raw)
+    throw std::invalid_argument("Module chunks are stored only from compressed sources.");
+  if (!modules.empty() && !is_module_grid)
+    spdlog::warn("Modules do not form regular grid - module chunks are decompressed and the image "
+                 "is compressed again by the dataset filter");
+  if (is_direct_io && image_storage != storage::raw)
+    throw std::invalid_argument("Direct I/O is supported only for uncompressed sources.");
+  // padding of the last chunk must not reach the next object HDF5 aligned to the block
+  if (is_direct_io && gpfs_block_size % direct_io_alignment != 0)
+    throw std::invalid_argument(fmt::format("Direct I/O needs gpfs_block_size multiple of {}",
+                                            direct_io_alignment));
+
   create_file(filename);
   create_datasets(config.detector_name);
+  if (image_storage == storage::blosc2) frame_schunk = create_frame_schunk(element_size);
+
+  hsize_t image_chunk[3] = {images_per_chunk, image_height, image_width};
+  image_chunk_space = H5Screate_simple(3, image_chunk, nullptr);
+  metadata_chunk_space = H5Screate_simple(1, &records_per_chunk, nullptr);
+  if (image_chunk_space < 0 || metadata_chunk_space < 0)
+    throw std::runtime_error("Cannot create ram dataspaces.");
+  if (images_per_chunk > 1 || is_direct_io)
+    image_batch.reset(static_cast<char*>(std::aligned_alloc(direct_io_alignment, batch_n_bytes)));
+  if ((images_per_chunk > 1 || is_direct_io) && !image_batch)
+    throw std::runtime_error("Cannot allocate image chunk buffer.");
+
+  // HDF5 keeps writing its metadata through its own descriptor
+  if (is_direct_io && (direct_fd = open(filename.c_str(), O_WRONLY | O_DIRECT)) < 0)
+    throw std::runtime_error(
+        fmt::format("Cannot open {} for direct I/O: {}", filename, std::strerror(errno)));
   spdlog::info("Created file filename={}, with file_id={}", filename, file_id);
 }
 
@@ -42,15 +193,30 @@ HDF5File::~HDF5File()
 {
   spdlog::info("Closing file with file_id={}", file_id);
 
-  if (file_id > 0 && index > 0) {
+  try {
+    flush_metadata();
+    flush_images();
+  }
+  catch (const std::runtime_error& err) {
+    spdlog::error("Failed writing buffered images to file_id={}: {}", file_id, err.what());
+  }
+  if (direct_fd >= 0 && close(direct_fd) < 0) spdlog::info("Failed closing direct I/O file");
+  if (frame_schunk != nullptr) blosc2_schunk_free(frame_schunk);
+
+  if (file_id > 0 && index >= 0) {
     hsize_t metadata_size[1] = {(hsize_t)index + 1};
     H5Dset_extent(metadata_ds, metadata_size);
     hsize_t image_dims[3] = {(hsize_t)index + 1, image_height, image_width};
     H5Dset_extent(image_ds, image_dims);
   }
 
+  for (auto space :
+       {image_file_space, image_chunk_space, metadata_file_space, metadata_chunk_space})
+    if (space >= 0) H5Sclose(space);
+  if (H5Tclose(metadata_type) < 0) spdlog::info("Failed closing metadata datatype");
   if (H5Dclose(metadata_ds) < 0) spdlog::info("Failed closing metadata");
   if (H5Dclose(image_ds) < 0) spdlog::info("Failed closing image");
+  if (H5Tclose(image_type) < 0) spdlog::info("Failed closing image datatype");
   if (H5Fclose(file_id) < 0) spdlog::info("Failed closing file");
 }
 
@@ -61,16 +227,56 @@ void HDF5File::write(const std_daq_protocol::ImageMetadata& meta, const char* im
                 file_id, index, meta.size());
 
   write_meta(meta);
-  write_image(image, meta.size());
+  if (image_storage == storage::raw)
+    write_image(image, meta.size());
+  else if (!modules.empty() && !is_module_grid)
+    write_image(assemble_image(meta, image), image_size);
+  else {
+    extend_image_dataset();
+    if (modules.empty()) write_chunk(meta.compression(), 0, 0, image, meta.size());
+    for (const auto& chunk : meta.chunks())
+      write_chunk(meta.compression(), chunk.y(), chunk.x(), image + chunk.offset(), chunk.size());
+  }
+  if (!is_quantisation_written && meta.has_quantisation()) write_quantisation(meta.quantisation());
 }
 
-hid_t HDF5File::get_datatype(std::size_t bit_depth)
+HDF5File::storage HDF5File::to_storage(std::string_view suffix)
 {
-  static std::map<std::size_t, hid_t> bit_depth_map = {
-      {8, H5T_NATIVE_UINT8}, {16, H5T_NATIVE_UINT16}, {32, H5T_NATIVE_UINT32}};
+  if (suffix == "h5bitshuffle-lz4") return storage::h5bitshuffle_lz4;
+  if (suffix == "blosc2") return storage::blosc2;
+  if (suffix == "delta-h5bitshuffle-lz4") return storage::delta_h5bitshuffle_lz4;
+  return storage::raw;
+}
 
-  if (const auto it = bit_depth_map.find(bit_depth); it != bit_depth_map.end()) return it->second;
-  throw std::runtime_error(fmt::format("Unsupported bits per pixel: {}", bit_depth));
+std_daq_protocol::ImageMetadataCompression HDF5File::to_compression(storage s)
+{
+  switch (s) {
+  case storage::h5bitshuffle_lz4: return std_daq_protocol::h5bitshuffle_lz4;
+  case storage::blosc2: return std_daq_protocol::blosc2;
+  case storage::delta_h5bitshuffle_lz4: return std_daq_protocol::delta_h5bitshuffle_lz4;
+  default: return std_daq_protocol::none;
+  }
+}
+
+hid_t HDF5File::create_datatype(std_daq_protocol::ImageMetadataDtype dtype)
+{
+  using namespace std_daq_protocol;
+  static const std::map<ImageMetadataDtype, hid_t> dtype_map = {
+      {ImageMetadataDtype::uint8, H5T_NATIVE_UINT8},
+      {ImageMetadataDtype::uint16, H5T_NATIVE_UINT16},
+      {ImageMetadataDtype::uint32, H5T_NATIVE_UINT32},
+      {ImageMetadataDtype::float32, H5T_NATIVE_FLOAT}};
+
+  if (const auto it = dtype_map.find(dtype); it != dtype_map.end()) return H5Tcopy(it->second);
+  if (dtype == ImageMetadataDtype::float16) {
+    // IEEE 754 half precision - HDF5 has no predefined type for it
+    auto type = H5Tcopy(H5T_IEEE_F32LE);
+    if (H5Tset_fields(type, 15, 10, 5, 0, 10) < 0 || H5Tset_size(type, 2) < 0 ||
+        H5Tset_ebias(type, 15) < 0)
+      throw std::runtime_error("Cannot create float16 datatype.");
+    return type;
+  }
+  throw std::runtime_error(fmt::format("Unsupported image dtype: {}", static_cast<int>(dtype)));
 }
 
 void HDF5File::create_file(const std::string& filename)
@@ -111,8 +317,10 @@ void HDF5File::create_image_dataset(hid_t data_group_id)
   auto dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
   if (dcpl_id < 0) throw std::runtime_error("Error in creating dataset create property list.");
 
-  hsize_t images_per_chunk = gpfs_block_size / image_size;
-  hsize_t image_dataset_chunking[] = {images_per_chunk, image_height, image_width};
+  const bool is_chunk_per_module = image_storage != storage::raw && is_module_grid;
+  hsize_t image_dataset_chunking[] = {images_per_chunk,
+                                      is_chunk_per_module ? modules.front().height : image_height,
+                                      is_chunk_per_module ? modules.front().width : image_width};
   if (H5Pset_chunk(dcpl_id, 3, image_dataset_chunking) < 0)
     throw std::runtime_error("Cannot set image dataset chunking.");
 
@@ -121,28 +329,59 @@ void HDF5File::create_image_dataset(hid_t data_group_id)
   auto image_space_id = H5Screate_simple(3, dims, max_dims);
   if (image_space_id < 0) throw std::runtime_error("Cannot create image dataset space.");
 
-  if (is_h5bitshuffle_lz4_compression) {
-    bshuf_register_h5filter();
-    uint filter_prop[] = {0, BSHUF_H5_COMPRESS_LZ4};
-    if (H5Pset_filter(dcpl_id, BSHUF_H5FILTER, H5Z_FLAG_MANDATORY, 2, filter_prop) < 0)
-      throw std::runtime_error("Cannot set compression filter on dataset.");
-  }
+  set_image_filter(dcpl_id);
+  // chunks get their place in the file when the dataset grows - direct writes need the address
+  if (is_direct_io && (H5Pset_alloc_time(dcpl_id, H5D_ALLOC_TIME_EARLY) < 0 ||
+                       H5Pset_fill_time(dcpl_id, H5D_FILL_TIME_NEVER) < 0))
+    throw std::runtime_error("Cannot set early allocation of image chunks.");
 
   auto dapl_id = H5Pcreate(H5P_DATASET_ACCESS);
   if (H5Pset_chunk_cache(dapl_id, images_per_chunk, gpfs_block_size, 1.0) < 0)
     throw std::runtime_error("Failed to set chunk cache for dataset access.");
 
-  image_ds = H5Dcreate(data_group_id, "data", get_datatype(image_bit_depth), image_space_id,
-                       H5P_DEFAULT, dcpl_id, dapl_id);
+  image_ds = H5Dcreate(data_group_id, "data", image_type, image_space_id, H5P_DEFAULT, dcpl_id,
+                       dapl_id);
   if (image_ds < 0) throw std::runtime_error("Cannot create image dataset.");
 
   H5Sclose(image_space_id);
+  H5Pclose(dapl_id);
   H5Pclose(dcpl_id);
 }
 
+void HDF5File::set_image_filter(hid_t dcpl_id) const
+{
+  switch (image_storage) {
+  case storage::raw: return;
+  case storage::h5bitshuffle_lz4: {
+    bshuf_register_h5filter();
+    uint filter_prop[] = {0, BSHUF_H5_COMPRESS_LZ4};
+    if (H5Pset_filter(dcpl_id, BSHUF_H5FILTER, H5Z_FLAG_MANDATORY, 2, filter_prop) < 0)
+      throw std::runtime_error("Cannot set compression filter on dataset.");
+    return;
+  }
+  case storage::blosc2: {
+    blosc2_init();
+    if (register_blosc2(nullptr, nullptr) < 0)
+      throw std::runtime_error("Cannot register blosc2 filter.");
+    // first four values are filled by the filter, level, shuffle and codec are informative only
+    uint filter_prop[] = {0, 0, 0, 0, 5, BLOSC_BITSHUFFLE, BLOSC_LZ4};
+    if (H5Pset_filter(dcpl_id, FILTER_BLOSC2, H5Z_FLAG_MANDATORY, 7, filter_prop) < 0)
+      throw std::runtime_error("Cannot set compression filter on dataset.");
+    return;
+  }
+  case storage::delta_h5bitshuffle_lz4: {
+    // no HDF5 filter decodes residuals - optional filter lets the library create the dataset
+    uint filter_prop[] = {static_cast<uint>(element_size)};
+    if (H5Pset_filter(dcpl_id, compress::delta::h5_filter_id, H5Z_FLAG_OPTIONAL, 1, filter_prop) <
+        0)
+      throw std::runtime_error("Cannot set compression filter on dataset.");
+    return;
+  }
+  }
+}
+
 void HDF5File::create_metadata_dataset(hid_t data_group_id)
 {
-  hsize_t records_per_chunk = gpfs_block_size / sizeof(h5_metadata);
   hsize_t initial_dims[1] = {0};
   hsize_t max_dims[1] = {H5S_UNLIMITED};
   hsize_t chunk_dims[1] = {records_per_chunk};
@@ -150,9 +389,9 @@ void HDF5File::create_metadata_dataset(hid_t data_group_id)
   hid_t dataspace_id = H5Screate_simple(1, initial_dims, max_dims);
   if (dataspace_id < 0) throw std::runtime_error("Cannot create meta dataset space.");
 
-  hid_t compound_id = H5Tcreate(H5T_COMPOUND, sizeof(h5_metadata));
-  H5Tinsert(compound_id, "image_id", HOFFSET(h5_metadata, image_id), H5T_NATIVE_UINT64);
-  H5Tinsert(compound_id, "status", HOFFSET(h5_metadata, status), H5T_NATIVE_UINT64);
+  metadata_type = H5Tcreate(H5T_COMPOUND, sizeof(h5_metadata));
+  H5Tinsert(metadata_type, "image_id", HOFFSET(h5_metadata, image_id), H5T_NATIVE_UINT64);
+  H5Tinsert(metadata_type, "status", HOFFSET(h5_metadata, status), H5T_NATIVE_UINT64);
 
   hid_t prop_id = H5Pcreate(H5P_DATASET_CREATE);
   H5Pset_chunk(prop_id, 1, chunk_dims);
@@ -161,90 +400,204 @@ void HDF5File::create_metadata_dataset(hid_t data_group_id)
   hid_t access_plist_id = H5Pcreate(H5P_DATASET_ACCESS);
   H5Pset_chunk_cache(access_plist_id, 0, cache_size, 1.0);
 
-  metadata_ds = H5Dcreate(data_group_id, "metadata", compound_id, dataspace_id, H5P_DEFAULT,
+  metadata_ds = H5Dcreate(data_group_id, "metadata", metadata_type, dataspace_id, H5P_DEFAULT,
                           prop_id, access_plist_id);
 
   if (metadata_ds < 0) throw std::runtime_error("Cannot create metadata dataset.");
 
   H5Pclose(access_plist_id);
-  H5Tclose(compound_id);
   H5Pclose(prop_id);
   H5Sclose(dataspace_id);
 }
 
-void HDF5File::write_image(const char* image, std::size_t)
+void HDF5File::extend_image_dataset()
 {
-  hid_t file_ds = H5Dget_space(image_ds);
-  if (file_ds < 0) throw std::runtime_error("Cannot get image dataset dataspace.");
+  if ((hsize_t)index < image_extent) return;
 
-  hsize_t current_dims[3];
-  if (H5Sget_simple_extent_dims(file_ds, current_dims, nullptr) < 0)
-    throw std::runtime_error("Failed to get dataset dimensions.");
-  H5Sclose(file_ds);
+  // early allocated chunks stay in the file after truncation - they are added one at the time
+  image_extent = grown_extent(is_direct_io ? 0 : image_extent, index + 1, images_per_chunk);
+  hsize_t new_dims[3] = {image_extent, image_height, image_width};
+  if (H5Dset_extent(image_ds, new_dims) < 0) throw std::runtime_error("Failed to extend dataset.");
 
-  if ((hsize_t)index >= current_dims[0]) {
-    hsize_t images_per_chunk = gpfs_block_size / image_size;
-    hsize_t new_dims[3] = {(hsize_t)index + images_per_chunk, image_height, image_width};
-    if (H5Dset_extent(image_ds, new_dims) < 0)
-      throw std::runtime_error("Failed to extend dataset.");
+  if (image_file_space >= 0) H5Sclose(image_file_space);
+  image_file_space = H5Dget_space(image_ds);
+  if (image_file_space < 0) throw std::runtime_error("Cannot get image dataset dataspace.");
+}
+
+void HDF5File::write_image(const char* image, std::size_t)
+{
+  if (images_per_chunk == 1 && !is_direct_io)
+    write_images(image, 1);
+  else {
+    std::memcpy(image_batch.get() + n_batched_images * image_size, image, image_size);
+    if (++n_batched_images == images_per_chunk) flush_images();
   }
+}
 
-  hsize_t offset[3] = {(hsize_t)index, 0, 0};
-  hsize_t count[3] = {1, image_height, image_width};
+void HDF5File::flush_images()
+{
+  if (n_batched_images == 0) return;
+  if (is_direct_io)
+    write_direct(index + 1 - n_batched_images);
+  else
+    write_images(image_batch.get(), n_batched_images);
+  n_batched_images = 0;
+}
 
-  auto ram_ds = H5Screate_simple(3, count, nullptr);
-  if (ram_ds < 0) throw std::runtime_error("Cannot create metadata ram dataspace.");
+// images are the last ones received - whole chunk at once unless the file is being closed
+void HDF5File::write_images(const char* data, hsize_t n_images)
+{
+  extend_image_dataset();
 
-  file_ds = H5Dget_space(image_ds);
-  if (H5Sselect_hyperslab(file_ds, H5S_SELECT_SET, offset, nullptr, count, nullptr) < 0)
-    throw std::runtime_error("Cannot select metadata dataset file hyperslab.");
+  hsize_t offset[3] = {index + 1 - n_images, 0, 0};
+  hsize_t count[3] = {n_images, image_height, image_width};
+  if (H5Sselect_hyperslab(image_file_space, H5S_SELECT_SET, offset, nullptr, count, nullptr) < 0)
+    throw std::runtime_error("Cannot select image dataset file hyperslab.");
+
+  auto ram_ds = n_images == images_per_chunk ? image_chunk_space
+                                             : H5Screate_simple(3, count, nullptr);
+  if (ram_ds < 0) throw std::runtime_error("Cannot create image ram dataspace.");
 
-  if (H5Dwrite(image_ds, get_datatype(image_bit_depth), ram_ds, file_ds, H5P_DEFAULT, image) < 0)
-    throw std::runtime_error("Cannot write data to image dataset.");
+  const auto status = H5Dwrite(image_ds, image_type, ram_ds, image_file_space, H5P_DEFAULT, data);
+  if (ram_ds != image_chunk_space) H5Sclose(ram_ds);
+  if (status < 0) throw std::runtime_error("Cannot write data to image dataset.");
 }
 
-void HDF5File::write_meta(const std_daq_protocol::ImageMetadata& meta) const
+// chunks are allocated by HDF5 when the dataset is extended - the batch is written at the address
+// of the chunk bypassing the page cache, HDF5 never touches raw data of the dataset
+void HDF5File::write_direct(hsize_t first_image)
 {
-  auto file_ds = H5Dget_space(metadata_ds);
-  if (file_ds < 0) throw std::runtime_error("Cannot get metadata dataset file dataspace.");
+  extend_image_dataset();
+
+  hsize_t offset[3] = {first_image, 0, 0};
+  haddr_t address;
+  hsize_t n_bytes;
+  if (H5Dget_chunk_info_by_coord(image_ds, offset, nullptr, &address, &n_bytes) < 0 ||
+      address == HADDR_UNDEF)
+    throw std::runtime_error("Cannot locate image chunk in file.");
+  if (address % direct_io_alignment != 0)
+    throw std::runtime_error(
+        fmt::format("Image chunk at {} is not aligned for direct I/O.", address));
+
+  const auto padded_n_bytes = static_cast<ssize_t>(round_up(n_bytes, direct_io_alignment));
+  if (pwrite(direct_fd, image_batch.get(), padded_n_bytes, static_cast<off_t>(address)) !=
+      padded_n_bytes)
+    throw std::runtime_error(fmt::format("Cannot write image chunk: {}", std::strerror(errno)));
+}
 
-  hsize_t current_dims[1];
-  if (H5Sget_simple_extent_dims(file_ds, current_dims, nullptr) < 0)
-    throw std::runtime_error("Failed to get dataset dimensions.");
+void HDF5File::write_chunk(std_daq_protocol::ImageMetadataCompression compression,
+                           hsize_t y,
+                           hsize_t x,
+                           const char* data,
+                           std::size_t n_bytes)
+{
+  // images left uncompressed by adaptive compression are stored with the filter skipped
+  const uint32_t filter_mask = compression == std_daq_protocol::none ? 1 : 0;
+  const auto expected = to_compression(image_storage);
+  if (filter_mask == 0 && compression != expected)
+    throw std::runtime_error(
+        fmt::format("Image compressed with {} cannot be stored in {} dataset.",
+                    std_daq_protocol::ImageMetadataCompression_Name(compression),
+                    std_daq_protocol::ImageMetadataCompression_Name(expected)));
+
+  hsize_t offset[3] = {(hsize_t)index, y, x};
+  if (image_storage == storage::blosc2 && filter_mask == 0) {
+    const blosc2_frame frame(frame_schunk, data);
+    if (H5Dwrite_chunk(image_ds, H5P_DEFAULT, filter_mask, offset, frame.size(), frame.data()) < 0)
+      throw std::runtime_error("Cannot write chunk to image dataset.");
+  }
+  else if (H5Dwrite_chunk(image_ds, H5P_DEFAULT, filter_mask, offset, n_bytes, data) < 0)
+    throw std::runtime_error("Cannot write chunk to image dataset.");
+}
 
-  const hsize_t required_index = index + 1;
-  if (required_index > current_dims[0]) {
-    const hsize_t records_per_chunk = gpfs_block_size / sizeof(h5_metadata);
-    const hsize_t extend_to = ((required_index / records_per_chunk) + 1) * records_per_chunk;
-    hsize_t new_size[1] = {extend_to};
+const char* HDF5File::assemble_image(const std_daq_protocol::ImageMetadata& meta,
+                                     const char* image)
+{
+  assembled_image.resize(image_size);
+  module_image.resize(image_size);
+  for (const auto& chunk : meta.chunks()) {
+    const auto* data = image + chunk.offset();
+    const auto n_bytes = static_cast<std::size_t>(chunk.width()) * chunk.height() * element_size;
+    if (meta.compression() == std_daq_protocol::h5bitshuffle_lz4) {
+      uint32_t block_size;
+      std::memcpy(&block_size, data + 8, 4);
+      if (bshuf_decompress_lz4(data + h5bitshuffle_header_n_bytes, module_image.data(),
+                               n_bytes / element_size, element_size,
+                               be32toh(block_size) / element_size) < 0)
+        throw std::runtime_error("Cannot decompress module chunk.");
+    }
+    else if (meta.compression() == std_daq_protocol::blosc2) {
+      if (blosc2_decompress(data, static_cast<int32_t>(chunk.size()), module_image.data(),
+                            static_cast<int32_t>(n_bytes)) < 0)
+        throw std::runtime_error("Cannot decompress module chunk.");
+    }
+    else
+      std::memcpy(module_image.data(), data, n_bytes);
+
+    const auto row_n_bytes = chunk.width() * element_size;
+    for (auto row = 0u; row < chunk.height(); row++)
+      std::memcpy(assembled_image.data() +
+                      ((chunk.y() + row) * image_width + chunk.x()) * element_size,
+                  module_image.data() + row * row_n_bytes, row_n_bytes);
+  }
+  return assembled_image.data();
+}
 
-    if (H5Dset_extent(metadata_ds, new_size) < 0)
-      throw std::runtime_error("Failed to extend dataset.");
+void HDF5File::write_meta(const std_daq_protocol::ImageMetadata& meta)
+{
+  metadata_batch.push_back({meta.image_id(), (uint64_t)meta.status()});
+  if (metadata_batch.size() == records_per_chunk) flush_metadata();
+}
 
-    H5Sclose(file_ds);
-    file_ds = H5Dget_space(metadata_ds);
-  }
+void HDF5File::flush_metadata()
+{
+  if (metadata_batch.empty()) return;
 
-  hsize_t offset[1] = {(hsize_t)index};
-  hsize_t count[1] = {1};
-  hsize_t stride[1] = {1};
-  hsize_t block[1] = {1};
+  const hsize_t n_records = metadata_batch.size();
+  if ((hsize_t)index >= metadata_extent) {
+    metadata_extent = grown_extent(metadata_extent, index + 1, records_per_chunk);
+    if (H5Dset_extent(metadata_ds, &metadata_extent) < 0)
+      throw std::runtime_error("Failed to extend dataset.");
 
-  auto ram_ds = H5Screate_simple(1, count, nullptr);
-  if (ram_ds < 0) throw std::runtime_error("Cannot create metadata ram dataspace.");
+    if (metadata_file_space >= 0) H5Sclose(metadata_file_space);
+    metadata_file_space = H5Dget_space(metadata_ds);
+    if (metadata_file_space < 0)
+      throw std::runtime_error("Cannot get metadata dataset file dataspace.");
+  }
 
-  if (H5Sselect_hyperslab(file_ds, H5S_SELECT_SET, offset, stride, count, block) < 0)
+  hsize_t offset[1] = {index + 1 - n_records};
+  if (H5Sselect_hyperslab(metadata_file_space, H5S_SELECT_SET, offset, nullptr, &n_records,
+                          nullptr) < 0)
     throw std::runtime_error("Cannot select metadata dataset file hyperslab.");
 
-  hid_t compound_type = H5Tcreate(H5T_COMPOUND, sizeof(h5_metadata));
-  H5Tinsert(compound_type, "image_id", HOFFSET(h5_metadata, image_id), H5T_NATIVE_UINT64);
-  H5Tinsert(compound_type, "status", HOFFSET(h5_metadata, status), H5T_NATIVE_UINT64);
+  auto ram_ds = n_records == records_per_chunk ? metadata_chunk_space
+                                               : H5Screate_simple(1, &n_records, nullptr);
+  if (ram_ds < 0) throw std::runtime_error("Cannot create metadata ram dataspace.");
 
-  h5_metadata data{meta.image_id(), (uint64_t)meta.status()};
-  if (H5Dwrite(metadata_ds, compound_type, ram_ds, file_ds, H5P_DEFAULT, &data) < 0)
-    throw std::runtime_error("Failed to write metadata.");
+  const auto status = H5Dwrite(metadata_ds, metadata_type, ram_ds, metadata_file_space,
+                               H5P_DEFAULT, metadata_batch.data());
+  if (ram_ds != metadata_chunk_space) H5Sclose(ram_ds);
+  if (status < 0) throw std::runtime_error("Failed to write metadata.");
+  metadata_batch.clear();
+}
 
-  H5Tclose(compound_type);
-  H5Sclose(file_ds);
-  H5Sclose(ram_ds);
+// quantisation is fixed for the run - it is described once on the image dataset together with the
+// largest error it introduces
+void HDF5File::write_quantisation(const std_daq_protocol::ImageQuantisation& quantisation)
+{
+  const auto step = quantisation.step();
+  write_attribute(image_ds, "quantisation_step", step);
+  write_attribute(image_ds, "photon_energy_kev", quantisation.photon_energy_kev());
+  if (quantisation.mode() == std_daq_protocol::ImageQuantisation::rounding) {
+    write_attribute(image_ds, "quantisation", std::string("rounding"));
+    write_attribute(image_ds, "quantisation_max_error_photons", step / 2);
+  }
+  else {
+    // error of n photons is step / 2 * sqrt(n + 3/8) + step^2 / 16 photons - relative to Poisson
+    // standard deviation it is the largest for n = 0
+    write_attribute(image_ds, "quantisation", std::string("anscombe"));
+    write_attribute(image_ds, "quantisation_max_error_sigma",
+                    step / 2 + step * step / (16 * std::sqrt(3.f / 8.f)));
+  }
+  is_quantisation_written = true;
 }
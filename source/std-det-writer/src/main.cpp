@@ -5,16 +5,24 @@
 #include <unistd.h>
 
 #include <string>
+#include <unordered_set>
+#include <vector>
 
+#include <blosc2.h>
 #include <fmt/core.h>
+#include <spdlog/spdlog.h>
 #include <zmq.h>
 
 #include "utils/utils.hpp"
+#include "utils/get_metadata_dtype.hpp"
 #include "core_buffer/communicator.hpp"
 #include "core_buffer/buffer_utils.hpp"
 #include "std_buffer/writer_action.pb.h"
 #include "writer_stats_collector.hpp"
+#include "write_queue.hpp"
 #include "hdf5_file.hpp"
+#include "master_file.hpp"
+#include "temporal_delta.hpp"
 
 using namespace std;
 
@@ -45,6 +53,55 @@ private:
   }
 };
 
+// Slots of the source are sized by the service that fills them - compressors leave room for
+// images that do not compress, module chunked images for the worst case of every module.
+size_t source_slot_n_bytes(const utils::DetectorConfig& config,
+                           const std::string& suffix,
+                           bool module_chunks)
+{
+  const size_t image_n_bytes = utils::converted_image_n_bytes(config);
+  if (module_chunks)
+    return config.n_modules *
+           convert::ModuleChunkCompressor(config, convert::ModuleChunkCompressor::to_codec(suffix))
+               .max_chunk_n_bytes();
+  if (suffix == "h5bitshuffle-lz4" || suffix == "delta-h5bitshuffle-lz4")
+    return compress::delta::max_compressed_n_bytes(
+        image_n_bytes, utils::get_bytes_from_metadata_dtype(utils::get_metadata_dtype(config)));
+  if (suffix == "blosc2") return image_n_bytes + BLOSC2_MAX_OVERHEAD;
+  return image_n_bytes;
+}
+
+// Residuals decode only together with their keyframe - residuals against keyframe not stored in
+// the same file (taken before the recording started or recorded round-robin by another writer) are
+// re-encoded as keyframes with the keyframe still held in ram_buffer. Returns the image to write,
+// meta gets the size of the re-encoded image.
+const char* rebase_to_file(std_daq_protocol::ImageMetadata& meta,
+                           const char* image,
+                           std::unordered_set<uint64_t>& file_keyframes,
+                           cb::Communicator& receiver,
+                           std::vector<char>& keyframe)
+{
+  if (meta.compression() != std_daq_protocol::delta_h5bitshuffle_lz4) return image;
+  const auto header = compress::delta::read_header(image);
+  if (header.is_keyframe()) file_keyframes.insert(header.image_id);
+  if (file_keyframes.contains(header.reference_id)) return image;
+
+  const auto element_size = utils::get_bytes_from_metadata_dtype(meta.dtype());
+  keyframe.resize(compress::delta::max_compressed_n_bytes(header.image_n_bytes, element_size));
+  try {
+    const auto size = compress::delta::rebase_to_keyframe(
+        image, receiver.get_data(header.reference_id), element_size, keyframe.data());
+    if (size < 0) throw std::runtime_error(fmt::format("bitshuffle error {}", size));
+    meta.set_size(static_cast<uint64_t>(size));
+    return keyframe.data();
+  }
+  catch (const std::exception& err) {
+    spdlog::error("Image {} stays residual against keyframe {} outside of the file: {}",
+                  header.image_id, header.reference_id, err.what());
+    return image;
+  }
+}
+
 } // namespace
 
 int main(int argc, char* argv[])
@@ -56,6 +113,16 @@ int main(int argc, char* argv[])
   program->add_argument("-s", "--source_suffix")
       .help("suffix for shared memory source for ram_buffer - default \"image\"")
       .default_value("image"s);
+  program->add_argument("-m", "--module_chunks")
+      .help("source is compressed per module by std_data_convert - modules are stored as chunks")
+      .flag();
+  program->add_argument("-d", "--direct_io")
+      .help("write uncompressed image chunks with O_DIRECT bypassing the page cache")
+      .flag();
+  program->add_argument("-q", "--queue_depth")
+      .help("number of actions buffered while the file system is slow - images stay in ram_buffer")
+      .scan<'u', std::size_t>()
+      .default_value(32ul);
 
   program = utils::parse_arguments(std::move(program), argc, argv);
 
@@ -67,7 +134,20 @@ int main(int argc, char* argv[])
   if (config.number_of_writers <= writer_id) return 0; // shutdown - writer not needed
 
   const auto suffix = program->get("--source_suffix");
+  if (suffix == "delta-h5bitshuffle-lz4" && config.number_of_writers > 1)
+    spdlog::warn("Images are distributed over {} writers - temporal delta residuals whose keyframe "
+                 "is stored by another writer are written as keyframes",
+                 config.number_of_writers);
+  const auto queue_depth = program->get<std::size_t>("--queue_depth");
+  // every writer may hold this many images - slots must not be reused before they are written
+  if (queue_depth * config.number_of_writers >= utils::slots_number(config))
+    throw std::invalid_argument(
+        fmt::format("Queue depth {} of {} writers exceeds {} slots of ram_buffer", queue_depth,
+                    config.number_of_writers, utils::slots_number(config)));
   const size_t image_n_bytes = utils::converted_image_n_bytes(config);
+  const auto module_chunks = program->get<bool>("--module_chunks");
+  const auto direct_io = program->get<bool>("--direct_io");
+  const size_t slot_n_bytes = source_slot_n_bytes(config, suffix, module_chunks);
 
   std::unique_ptr<HDF5File> file;
   WriterStatsCollector stats(config.detector_name, suffix, config.stats_collection_period,
@@ -80,55 +160,88 @@ int main(int argc, char* argv[])
       fmt::format("{}-writer-{}", config.detector_name, program->get<uint16_t>("writer_id"));
 
   auto ctx = zmq_ctx_new();
-  auto receiver = cb::Communicator{{buffer_name, image_n_bytes, utils::slots_number(config)},
+  auto receiver = cb::Communicator{{buffer_name, slot_n_bytes, utils::slots_number(config)},
                                    {source_name, ctx, cb::CONN_TYPE_CONNECT, ZMQ_PULL}};
 
   auto sender = buffer_utils::bind_socket(ctx, sink_name, ZMQ_PUSH);
 
-  char buffer[512];
-  std_daq_protocol::WriterAction action;
   std_daq_protocol::WriterResponse response;
-  response.set_code(std_daq_protocol::ResponseCode::SUCCESS);
   std::string send_msg;
-  response.SerializeToString(&send_msg);
-
-  while (true) {
-    if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
-      action.ParseFromArray(buffer, n_bytes);
-      response.set_code(std_daq_protocol::ResponseCode::SUCCESS);
-      response.clear_reason();
-      response.SerializeToString(&send_msg);
-
-      if (action.has_create_file()) {
-        const auto& create_file = action.create_file();
-        if (manage_user.switch_writer_user(create_file.writer_id())) {
-          try {
-            file = std::make_unique<HDF5File>(config, create_file.path(), suffix);
+  std_daq_protocol::ImageMetadata record_meta;
+  std::vector<char> keyframe;
+  std::unordered_set<uint64_t> file_keyframes;
+
+  // file system latency is absorbed here - only the writing thread touches the file, the sender
+  // socket and the statistics
+  WriteQueue queue(
+      queue_depth,
+      [&](WriteQueue::job& job) {
+        const auto& action = job.action;
+        stats.process_queue(job.depth, job.stall);
+        response.set_code(std_daq_protocol::ResponseCode::SUCCESS);
+        response.clear_reason();
+
+        if (action.has_create_file()) {
+          const auto& create_file = action.create_file();
+          if (manage_user.switch_writer_user(create_file.writer_id())) {
+            try {
+              file = std::make_unique<HDF5File>(config, create_file.path(), suffix,
+                                                module_chunks, direct_io);
+              file_keyframes.clear();
+            }
+            catch (const std::exception& err) {
+              response.set_code(std_daq_protocol::ResponseCode::FAILURE);
+              response.set_reason(err.what());
+            }
+            response.SerializeToString(&send_msg);
+            zmq_send(sender, send_msg.c_str(), send_msg.size(), 0);
           }
-          catch (const std::runtime_error& err) {
-            response.set_code(std_daq_protocol::ResponseCode::FAILURE);
-            response.set_reason(err.what());
+        }
+        else if (action.has_record_image()) {
+          record_meta = action.record_image().image_metadata();
+          const auto* image_data = rebase_to_file(
+              record_meta, receiver.get_data(record_meta.image_id()), file_keyframes, receiver,
+              keyframe);
+          stats.start_image_write();
+          file->write(record_meta, image_data);
+          stats.end_image_write();
+        }
+        else if (action.has_close_file()) {
+          file.reset();
+          (void)manage_user.switch_to_root();
+          response.SerializeToString(&send_msg);
+          zmq_send(sender, send_msg.c_str(), send_msg.size(), 0);
+        }
+        else if (action.has_create_master_file()) {
+          const auto& master_file = action.create_master_file();
+          if (manage_user.switch_writer_user(master_file.writer_id())) {
+            try {
+              create_master_file(config.detector_name, master_file);
+            }
+            catch (const std::exception& err) {
+              response.set_code(std_daq_protocol::ResponseCode::FAILURE);
+              response.set_reason(err.what());
+            }
+            (void)manage_user.switch_to_root();
             response.SerializeToString(&send_msg);
+            zmq_send(sender, send_msg.c_str(), send_msg.size(), 0);
           }
+        }
+        else if (action.has_confirm_last_image()) {
+          response.SerializeToString(&send_msg);
           zmq_send(sender, send_msg.c_str(), send_msg.size(), 0);
         }
-      }
-      else if (action.has_record_image()) {
-        const auto& record_image = action.record_image();
-        auto image_data = receiver.get_data(record_image.image_metadata().image_id());
-        stats.start_image_write();
-        file->write(record_image.image_metadata(), image_data);
-        stats.end_image_write();
-      }
-      else if (action.has_close_file()) {
-        file.reset();
-        (void) manage_user.switch_to_root();
-        zmq_send(sender, send_msg.c_str(), send_msg.size(), 0);
-      }
-      else if (action.has_confirm_last_image())
-        zmq_send(sender, send_msg.c_str(), send_msg.size(), 0);
+      },
+      [&] { stats.print_stats(); });
+
+  char buffer[512];
+  std_daq_protocol::WriterAction action;
+
+  while (true) {
+    if (auto n_bytes = receiver.receive_meta(buffer); n_bytes > 0) {
+      action.ParseFromArray(buffer, n_bytes);
+      queue.submit(action);
     }
-    stats.print_stats();
   }
   return 0;
 }
@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "master_file.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/core.h>
+#include <hdf5.h>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+// closes the identifier with the function of its kind when leaving the scope
+class h5_id
+{
+public:
+  h5_id(hid_t identifier, herr_t (*close_function)(hid_t), std::string_view what)
+      : id(identifier)
+      , close(close_function)
+  {
+    if (id < 0) throw std::runtime_error(fmt::format("Cannot create master file {}.", what));
+  }
+  ~h5_id() { close(id); }
+  h5_id(const h5_id&) = delete;
+  h5_id& operator=(const h5_id&) = delete;
+
+  operator hid_t() const { return id; }
+
+private:
+  hid_t id;
+  herr_t (*close)(hid_t);
+};
+
+// relative names are resolved against the directory of the master file - the files can be moved
+// together
+std::string source_name(const std::filesystem::path& master, const std::filesystem::path& source)
+{
+  return source.parent_path() == master.parent_path() ? source.filename().string()
+                                                      : source.string();
+}
+
+std::vector<hsize_t> dataset_dims(hid_t dataset)
+{
+  h5_id space(H5Dget_space(dataset), H5Sclose, "source dataspace");
+  std::vector<hsize_t> dims(H5Sget_simple_extent_ndims(space));
+  if (H5Sget_simple_extent_dims(space, dims.data(), nullptr) < 0)
+    throw std::runtime_error("Failed to get dataset dimensions.");
+  return dims;
+}
+
+// images k, k + n_sources, k + 2 * n_sources ... are stored consecutively by writer k
+void create_virtual_dataset(hid_t group,
+                            const char* name,
+                            hid_t type,
+                            std::vector<hsize_t> dims,
+                            const std_daq_protocol::CreateMasterFile& command,
+                            const std::string& source_dataset)
+{
+  const hsize_t n_sources = command.sources_size();
+  const auto rank = static_cast<int>(dims.size());
+  h5_id virtual_space(H5Screate_simple(rank, dims.data(), nullptr), H5Sclose, "dataspace");
+  h5_id dcpl(H5Pcreate(H5P_DATASET_CREATE), H5Pclose, "property list");
+
+  for (hsize_t k = 0; k < n_sources && k < dims[0]; k++) {
+    const hsize_t n_images = (dims[0] - k + n_sources - 1) / n_sources;
+    std::vector<hsize_t> start(rank, 0), stride(rank, 1), count(rank, 1), block(dims);
+    start[0] = k;
+    stride[0] = n_sources;
+    count[0] = n_images;
+    block[0] = 1;
+    if (H5Sselect_hyperslab(virtual_space, H5S_SELECT_SET, start.data(), stride.data(),
+                            count.data(), block.data()) < 0)
+      throw std::runtime_error("Cannot select virtual dataset hyperslab.");
+
+    std::vector<hsize_t> source_dims(dims);
+    source_dims[0] = n_images;
+    h5_id source_space(H5Screate_simple(rank, source_dims.data(), nullptr), H5Sclose,
+                       "source dataspace");
+    const auto source = source_name(command.path(), command.sources(static_cast<int>(k)));
+    if (H5Pset_virtual(dcpl, virtual_space, source.c_str(), source_dataset.c_str(),
+                       source_space) < 0)
+      throw std::runtime_error(fmt::format("Cannot map {} to virtual dataset.", source));
+  }
+
+  H5Sselect_all(virtual_space);
+  h5_id dataset(H5Dcreate(group, name, type, virtual_space, H5P_DEFAULT, dcpl, H5P_DEFAULT),
+                H5Dclose, name);
+}
+
+} // namespace
+
+void create_master_file(const std::string& detector_name,
+                        const std_daq_protocol::CreateMasterFile& command)
+{
+  if (command.sources_size() == 0)
+    throw std::invalid_argument("Master file needs at least one writer file.");
+
+  const auto data_name = fmt::format("/{}/data", detector_name);
+  const auto metadata_name = fmt::format("/{}/metadata", detector_name);
+
+  h5_id first_file(H5Fopen(command.sources(0).c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose,
+                   command.sources(0));
+  h5_id first_data(H5Dopen(first_file, data_name.c_str(), H5P_DEFAULT), H5Dclose, data_name);
+  h5_id first_metadata(H5Dopen(first_file, metadata_name.c_str(), H5P_DEFAULT), H5Dclose,
+                       metadata_name);
+  h5_id image_type(H5Dget_type(first_data), H5Tclose, "image datatype");
+  h5_id metadata_type(H5Dget_type(first_metadata), H5Tclose, "metadata datatype");
+
+  auto image_dims = dataset_dims(first_data);
+  image_dims[0] = command.n_images();
+
+  h5_id file(H5Fcreate(command.path().c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT),
+             H5Fclose, command.path());
+  h5_id group(H5Gcreate(file, detector_name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT),
+              H5Gclose, "group");
+  create_virtual_dataset(group, "data", image_type, image_dims, command, data_name);
+  create_virtual_dataset(group, "metadata", metadata_type, {command.n_images()}, command,
+                         metadata_name);
+
+  spdlog::info("Created master file filename={} of {} images from {} files", command.path(),
+               command.n_images(), command.sources_size());
+}
@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "write_queue.hpp"
+
+#include <stdexcept>
+
+namespace {
+// statistics are printed by the writing thread - it wakes up at least this often when idle
+constexpr auto idle_period = std::chrono::milliseconds(100);
+} // namespace
+
+WriteQueue::WriteQueue(std::size_t depth, process_function process_action, idle_function on_idle)
+    : process(std::move(process_action))
+    , idle(std::move(on_idle))
+    , slots(depth)
+{
+  if (depth == 0) throw std::invalid_argument("Write queue needs depth of at least one action");
+  worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+// actions already submitted are executed - closing of the file must not be lost
+WriteQueue::~WriteQueue()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    space_available.wait(lock, [this] { return next_taken == next_submitted; });
+  }
+  worker.request_stop();
+}
+
+void WriteQueue::submit(const std_daq_protocol::WriterAction& action)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  const auto start = clock::now();
+  space_available.wait(lock, [this] { return next_submitted - next_taken < slots.size(); });
+  auto& s = slots[next_submitted % slots.size()];
+  s.stall = clock::now() - start;
+  s.action.CopyFrom(action);
+  next_submitted++;
+  lock.unlock();
+  work_available.notify_one();
+}
+
+void WriteQueue::run(std::stop_token stop)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stop.stop_requested()) {
+    if (!work_available.wait_for(lock, stop, idle_period,
+                                 [this] { return next_taken < next_submitted; })) {
+      lock.unlock();
+      idle();
+      lock.lock();
+      continue;
+    }
+    // slot is released only after the action is done - submit does not overwrite it meanwhile
+    auto& s = slots[next_taken % slots.size()];
+    s.depth = next_submitted - next_taken;
+    lock.unlock();
+
+    process(s);
+    idle();
+
+    lock.lock();
+    next_taken++;
+    space_available.notify_all();
+  }
+}
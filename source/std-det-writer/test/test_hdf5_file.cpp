@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "hdf5_file.hpp"
+
+#include <filesystem>
+#include <optional>
+
+#include <gtest/gtest.h>
+
+#include "writer_test_config.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+// image of 5000 bytes - chunks of 3 images do not end on the direct I/O block
+constexpr auto image_width = 50;
+constexpr auto image_height = 50;
+constexpr std::size_t image_n_pixels = image_width * image_height;
+constexpr auto n_images = 7;
+
+class HDF5FileDirectIo : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto seed = ::testing::UnitTest::GetInstance()->random_seed();
+    directory = fs::temp_directory_path() / ("sdw_hdf5_file_" + std::to_string(seed));
+    fs::create_directories(directory);
+    filename = (directory / "images.h5").string();
+  }
+  void TearDown() override { fs::remove_all(directory); }
+
+  std::vector<uint16_t> read_images() const
+  {
+    std::vector<uint16_t> images(n_images * image_n_pixels);
+    const auto file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    const auto data = H5Dopen(file, "/JF/data", H5P_DEFAULT);
+    EXPECT_GE(H5Dread(data, H5T_NATIVE_UINT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, images.data()), 0);
+    H5Dclose(data);
+    H5Fclose(file);
+    return images;
+  }
+
+  fs::path directory;
+  std::string filename;
+};
+
+} // namespace
+
+TEST_F(HDF5FileDirectIo, ShouldStoreCompleteAndPartialChunksBypassingPageCache)
+{
+  if (!supports_direct_io(directory)) GTEST_SKIP() << "O_DIRECT is not supported in " << directory;
+
+  std::vector<uint16_t> expected(n_images * image_n_pixels);
+  {
+    HDF5File file(create_config(image_height, image_width, 16384), filename, "image", false, true);
+    std_daq_protocol::ImageMetadata meta;
+    meta.set_dtype(std_daq_protocol::uint16);
+    meta.set_status(std_daq_protocol::good_image);
+    meta.set_size(image_n_pixels * sizeof(uint16_t));
+    for (auto i = 0u; i < n_images; i++) {
+      auto* image = expected.data() + i * image_n_pixels;
+      for (auto j = 0u; j < image_n_pixels; j++)
+        image[j] = static_cast<uint16_t>(i * 7 + j);
+      meta.set_image_id(i);
+      file.write(meta, reinterpret_cast<const char*>(image));
+    }
+  }
+  EXPECT_EQ(expected, read_images());
+}
+
+TEST_F(HDF5FileDirectIo, ShouldThrowForDirectIoOfCompressedSource)
+{
+  EXPECT_THROW(HDF5File(create_config(image_height, image_width, 16384), filename,
+                        "h5bitshuffle-lz4", false, true),
+               std::invalid_argument);
+}
+
+TEST_F(HDF5FileDirectIo, ShouldThrowForDirectIoWithBlockSizeNotAlignedToIoBlock)
+{
+  EXPECT_THROW(HDF5File(create_config(image_height, image_width, 10000), filename, "image",
+                        false, true),
+               std::invalid_argument);
+}
@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include "master_file.hpp"
+
+#include <filesystem>
+#include <memory>
+
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include "hdf5_file.hpp"
+#include "writer_test_config.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr auto image_side = 64;
+constexpr auto n_writers = 3;
+constexpr auto n_images = 10;
+constexpr uint64_t first_image_id = 500;
+constexpr std::size_t image_n_pixels = image_side * image_side;
+
+struct h5_metadata
+{
+  uint64_t image_id;
+  uint64_t status;
+};
+
+class MasterFile : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    const auto seed = ::testing::UnitTest::GetInstance()->random_seed();
+    directory = fs::temp_directory_path() / ("sdw_master_" + std::to_string(seed));
+    fs::create_directories(directory);
+  }
+  void TearDown() override { fs::remove_all(directory); }
+
+  // image i is written by writer i % n_writers - the same way the writer driver distributes them
+  std_daq_protocol::CreateMasterFile write_files(bool direct_io) const
+  {
+    // 4 images per chunk - writers store both complete and partially filled chunks
+    const auto config =
+        create_config(image_side, image_side, 4 * image_n_pixels * sizeof(uint16_t), n_writers);
+    std_daq_protocol::CreateMasterFile command;
+    command.set_path((directory / "master.h5").string());
+    command.set_n_images(n_images);
+    {
+      std::vector<std::unique_ptr<HDF5File>> files;
+      for (auto k = 0; k < n_writers; k++) {
+        command.add_sources((directory / fmt::format("writer_{}.h5", k)).string());
+        files.push_back(std::make_unique<HDF5File>(config, command.sources(k), "image", false,
+                                                   direct_io));
+      }
+
+      std::vector<uint16_t> image(image_n_pixels);
+      std_daq_protocol::ImageMetadata meta;
+      meta.set_dtype(std_daq_protocol::uint16);
+      meta.set_status(std_daq_protocol::good_image);
+      meta.set_width(image_side);
+      meta.set_height(image_side);
+      meta.set_size(image_n_pixels * sizeof(uint16_t));
+      for (auto i = 0; i < n_images; i++) {
+        for (auto j = 0u; j < image.size(); j++)
+          image[j] = static_cast<uint16_t>(i * 1000 + j % 1000);
+        meta.set_image_id(first_image_id + i);
+        files[i % n_writers]->write(meta, reinterpret_cast<const char*>(image.data()));
+      }
+    }
+    return command;
+  }
+
+  void expect_images_in_recorded_order(const std::string& master_filename) const
+  {
+    const auto file = H5Fopen(master_filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    ASSERT_GE(file, 0);
+
+    const auto data = H5Dopen(file, "/JF/data", H5P_DEFAULT);
+    ASSERT_GE(data, 0);
+    std::vector<uint16_t> images(n_images * image_n_pixels);
+    ASSERT_GE(H5Dread(data, H5T_NATIVE_UINT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, images.data()), 0);
+    for (auto i = 0u; i < n_images; i++)
+      for (auto j = 0u; j < image_n_pixels; j += 997)
+        ASSERT_EQ(i * 1000 + j % 1000, images[i * image_n_pixels + j]) << "image " << i;
+
+    const auto metadata = H5Dopen(file, "/JF/metadata", H5P_DEFAULT);
+    ASSERT_GE(metadata, 0);
+    const auto type = H5Dget_type(metadata);
+    ASSERT_EQ(sizeof(h5_metadata), H5Tget_size(type));
+    std::vector<h5_metadata> records(n_images);
+    ASSERT_GE(H5Dread(metadata, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, records.data()), 0);
+    for (auto i = 0u; i < n_images; i++) {
+      EXPECT_EQ(first_image_id + i, records[i].image_id);
+      EXPECT_EQ(static_cast<uint64_t>(std_daq_protocol::good_image), records[i].status);
+    }
+
+    H5Tclose(type);
+    H5Dclose(metadata);
+    H5Dclose(data);
+    H5Fclose(file);
+  }
+
+  fs::path directory;
+};
+
+} // namespace
+
+TEST_F(MasterFile, ShouldReadImagesOfAllWriterFilesInRecordedOrder)
+{
+  const auto command = write_files(false);
+  create_master_file("JF", command);
+  expect_images_in_recorded_order(command.path());
+}
+
+TEST_F(MasterFile, ShouldReadImagesOfDirectIoWriterFilesInRecordedOrder)
+{
+  if (!supports_direct_io(directory)) GTEST_SKIP() << "O_DIRECT is not supported in " << directory;
+  const auto command = write_files(true);
+  create_master_file("JF", command);
+  expect_images_in_recorded_order(command.path());
+}
+
+TEST_F(MasterFile, ShouldResolveWriterFilesNextToMovedMasterFile)
+{
+  const auto command = write_files(false);
+  create_master_file("JF", command);
+
+  const auto moved = directory / "moved";
+  fs::create_directories(moved);
+  for (const auto& source : command.sources())
+    fs::rename(source, moved / fs::path(source).filename());
+  fs::rename(command.path(), moved / "master.h5");
+  expect_images_in_recorded_order((moved / "master.h5").string());
+}
+
+TEST_F(MasterFile, ShouldThrowWithoutWriterFiles)
+{
+  std_daq_protocol::CreateMasterFile command;
+  command.set_path((directory / "master.h5").string());
+  EXPECT_THROW(create_master_file("JF", command), std::invalid_argument);
+}
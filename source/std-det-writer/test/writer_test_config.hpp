@@ -0,0 +1,52 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "utils/detector_config.hpp"
+
+// single module covering the whole image - gpfs_block_size sets the images per chunk
+inline utils::DetectorConfig create_config(int image_height,
+                                           int image_width,
+                                           int gpfs_block_size,
+                                           int n_writers = 1)
+{
+  return {.detector_name = "JF",
+          .detector_type = "jungfrau-raw",
+          .n_modules = 1,
+          .bit_depth = 16,
+          .image_pixel_height = image_height,
+          .image_pixel_width = image_width,
+          .start_udp_port = 0,
+          .log_level = "debug",
+          .stats_collection_period = std::chrono::seconds(30),
+          .max_number_of_forwarders_spawned = 8,
+          .use_all_forwarders = false,
+          .gpfs_block_size = gpfs_block_size,
+          .sender_sends_full_images = false,
+          .module_sync_queue_size = 50,
+          .number_of_writers = n_writers,
+          .ram_buffer_gb = 1000,
+          .delay_filter_timeout = std::chrono::seconds(30),
+          .switch_user_active = false,
+          .ls_configs = {},
+          .modules = {{0, {{0, 0}, {image_width - 1, image_height - 1}}}}};
+}
+
+// O_DIRECT is refused by some file systems, e.g. tmpfs
+inline bool supports_direct_io(const std::filesystem::path& directory)
+{
+  const auto probe = (directory / "probe").string();
+  const int fd = open(probe.c_str(), O_WRONLY | O_CREAT | O_DIRECT, 0644);
+  if (fd < 0) return false;
+  close(fd);
+  std::filesystem::remove(probe);
+  return true;
+}
@@ -0,0 +1,157 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zmq.h>
+#include <fmt/core.h>
+
+#include "core_buffer/buffer_utils.hpp"
+#include "core_buffer/ram_buffer.hpp"
+#include "detectors/common.hpp"
+#include "std_buffer/image_metadata.pb.h"
+#include "utils/utils.hpp"
+
+#include "image_metadata.hpp"
+#include "synchronizer.hpp"
+
+#include "part_receiving.hpp"
+#include "receiver_stats_collector.hpp"
+
+namespace {
+
+constexpr auto max_meta_n_bytes = 512u;
+
+// part of the image as tracked by the synchronizer - metadata is identical for all parts, the
+// one of the first received part is published when the image is complete
+struct image_part
+{
+  CommonFrame common;
+  int meta_n_bytes;
+  char meta[max_meta_n_bytes];
+};
+
+using PartsSynchronizer = Synchronizer<image_part>;
+
+std::tuple<utils::DetectorConfig, std::vector<std::string>> read_arguments(int argc, char* argv[])
+{
+  auto program = utils::create_parser("std_stream_receive_multi");
+  program->add_argument("stream_addresses")
+      .help("addresses of input streams in order of image parts")
+      .nargs(argparse::nargs_pattern::at_least_one);
+  program = utils::parse_arguments(std::move(program), argc, argv);
+  return {utils::read_config_from_json_file(program->get("detector_json_filename")),
+          program->get<std::vector<std::string>>("stream_addresses")};
+}
+
+// image part is received directly into its place in the image slot
+void receive_part(const utils::DetectorConfig& config,
+                  void* ctx,
+                  const std::string& stream_address,
+                  int image_part_id,
+                  RamBuffer& image_buffer,
+                  PartsSynchronizer& syncer,
+                  std::atomic<std::size_t>& n_corrupted_images)
+{
+  const auto start_index = utils::calculate_image_offset(config, image_part_id);
+  const auto data_bytes_sent = utils::calculate_image_bytes_sent(config, image_part_id);
+  gf::rec::ReceiverStatsCollector stats(config.detector_name, config.stats_collection_period,
+                                        image_part_id);
+
+  image_part part{};
+  part.common.module_id = static_cast<uint16_t>(image_part_id);
+  std_daq_protocol::ImageMetadata meta;
+
+  auto socket = zmq_socket_connect(ctx, stream_address);
+  while (true) {
+    unsigned int zmq_fails = 0;
+    meta.set_image_id(0);
+    if (auto n_bytes = zmq_recv(socket, part.meta, sizeof(part.meta), 0);
+        n_bytes > 0 && n_bytes <= static_cast<int>(sizeof(part.meta)))
+    {
+      meta.ParseFromArray(part.meta, n_bytes);
+      char* data = image_buffer.get_data(meta.image_id());
+      if (received_successfully_data(socket, data + start_index, data_bytes_sent)) {
+        part.common.image_id = meta.image_id();
+        part.meta_n_bytes = n_bytes;
+        n_corrupted_images += syncer.process_image_metadata(part);
+      }
+      else
+        zmq_fails++;
+      stats.process(zmq_fails, meta.image_id());
+    }
+    stats.print_stats();
+  }
+}
+
+void send_complete_images(const utils::DetectorConfig& config,
+                          void* ctx,
+                          PartsSynchronizer& syncer,
+                          std::atomic<std::size_t>& n_corrupted_images)
+{
+  using namespace std::chrono_literals;
+  utils::stats::SyncStatsCollector stats(config.detector_name, config.stats_collection_period);
+  auto sender = buffer_utils::bind_socket(ctx, config.detector_name + "-image", ZMQ_PUB);
+
+  std_daq_protocol::ImageMetadata image_meta;
+  std::string meta_buffer_send;
+  while (true) {
+    const auto seen_events = syncer.events_count();
+    while (auto image = syncer.pop_next_image()) {
+      const auto& part = image->frame;
+      if (image->missing.none())
+        zmq_send(sender, part.meta, part.meta_n_bytes, 0);
+      else {
+        image_meta.ParseFromArray(part.meta, part.meta_n_bytes);
+        set_missing_modules(image->missing, image_meta);
+        image_meta.SerializeToString(&meta_buffer_send);
+        zmq_send(sender, meta_buffer_send.c_str(), meta_buffer_send.size(), 0);
+      }
+      stats.process(static_cast<unsigned int>(n_corrupted_images.exchange(0)));
+    }
+    const auto counters = syncer.take_counters();
+    stats.process_deadline(counters.partial_images, counters.late_modules,
+                           counters.duplicated_modules);
+    stats.print_stats();
+    // timeout keeps the statistics flowing and releases images after the deadline
+    syncer.wait_for_events(seen_events, syncer.time_to_deadline().value_or(1s));
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  static const std::string prog_name{"std_stream_receive_multi"};
+  const auto [config, stream_addresses] = read_arguments(argc, argv);
+  [[maybe_unused]] utils::log::logger l{prog_name, config.log_level};
+
+  if (config.sender_sends_full_images) return 0;
+
+  const auto n_parts = utils::number_of_senders(config);
+  if (stream_addresses.size() < n_parts)
+    throw std::invalid_argument(fmt::format("Image is sent in {} parts, but only {} addresses given",
+                                            n_parts, stream_addresses.size()));
+
+  auto ctx = zmq_ctx_new();
+  zmq_ctx_set(ctx, ZMQ_IO_THREADS, static_cast<int>(n_parts));
+
+  RamBuffer image_buffer(fmt::format("{}-image", config.detector_name),
+                         utils::converted_image_n_bytes(config), utils::slots_number(config));
+  PartsSynchronizer syncer(static_cast<int>(n_parts), config.module_sync_queue_size, {},
+                           config.module_sync_timeout);
+  std::atomic<std::size_t> n_corrupted_images{0};
+
+  std::vector<std::jthread> receivers;
+  for (auto part = 0u; part < n_parts; part++)
+    receivers.emplace_back(receive_part, std::cref(config), ctx, std::cref(stream_addresses[part]),
+                           static_cast<int>(part), std::ref(image_buffer), std::ref(syncer),
+                           std::ref(n_corrupted_images));
+  send_complete_images(config, ctx, syncer, n_corrupted_images);
+  return 0;
+}
@@ -0,0 +1,28 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include <zmq.h>
+
+#include "core_buffer/buffer_utils.hpp"
+
+inline void* zmq_socket_connect(void* ctx, const std::string& stream_address)
+{
+  void* socket = buffer_utils::create_socket(ctx, ZMQ_SUB);
+  if (zmq_connect(socket, stream_address.c_str())) throw std::runtime_error(zmq_strerror(errno));
+  return socket;
+}
+
+// image part follows the metadata as second frame of the same message
+inline bool received_successfully_data(void* socket, char* buffer, std::size_t size)
+{
+  int receive_more;
+  size_t sz = sizeof(receive_more);
+  return zmq_getsockopt(socket, ZMQ_RCVMORE, &receive_more, &sz) != -1 &&
+         zmq_recv(socket, buffer, size, ZMQ_DONTWAIT) > 0;
+}
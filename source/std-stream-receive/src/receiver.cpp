@@ -11,19 +11,13 @@
 #include "std_buffer/image_metadata.pb.h"
 #include "utils/utils.hpp"
 
+#include "part_receiving.hpp"
 #include "receiver_stats_collector.hpp"
 
 namespace {
 constexpr auto zmq_io_threads = 1;
 } // namespace
 
-void* zmq_socket_connect(void* ctx, const std::string& stream_address)
-{
-  void* socket = buffer_utils::create_socket(ctx, ZMQ_SUB);
-  if (zmq_connect(socket, stream_address.c_str())) throw std::runtime_error(zmq_strerror(errno));
-  return socket;
-}
-
 std::tuple<utils::DetectorConfig, std::string, int> read_arguments(int argc, char* argv[])
 {
   auto program = utils::create_parser("std_stream_receive");
@@ -36,14 +30,6 @@ std::tuple<utils::DetectorConfig, std::string, int> read_arguments(int argc, cha
           program->get("stream_address"), program->get<int>("image_part")};
 }
 
-bool received_successfully_data(void* socket, char* buffer, std::size_t size)
-{
-  int receive_more;
-  size_t sz = sizeof(receive_more);
-  return zmq_getsockopt(socket, ZMQ_RCVMORE, &receive_more, &sz) != -1 &&
-         zmq_recv(socket, buffer, size, ZMQ_DONTWAIT) > 0;
-}
-
 int main(int argc, char* argv[])
 {
   const auto [config, stream_address, image_part] = read_arguments(argc, argv);
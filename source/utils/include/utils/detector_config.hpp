@@ -33,6 +33,26 @@ struct live_stream_config
   std::pair<size_t, size_t> value{0, 0};
 };
 
+struct converted_output_config
+{
+  enum Type
+  {
+    float32,
+    float16,
+    uint16
+  } type = float32;
+  // energy of a single photon - uint16 output is expressed in photon counts
+  float photon_energy_kev = 0.f;
+};
+
+// treatment of pixels in gaps between sensor chips that are not read out by the detector
+enum class gap_pixels_mode
+{
+  keep,
+  zero,
+  interpolate
+};
+
 struct DetectorConfig
 {
   const std::string detector_name;
@@ -55,6 +75,13 @@ struct DetectorConfig
   const bool switch_user_active;
   const std::unordered_map<std::string, live_stream_config> ls_configs;
   const std::unordered_map<module_id, std::pair<Point, Point>> modules;
+  const converted_output_config converted_output{};
+  const gap_pixels_mode gap_pixels = gap_pixels_mode::keep;
+  // number of module pixels summed along each axis into one image pixel - module_positions and
+  // image size describe the binned image
+  const int binning = 1;
+  // incomplete image is released with missing modules after this time - 0 waits for all modules
+  const std::chrono::milliseconds module_sync_timeout{0};
 
   friend std::ostream& operator<<(std::ostream& os, const DetectorConfig& det_config)
   {
@@ -64,7 +91,8 @@ struct DetectorConfig
                "log_level={},stats_collection_period={},max_number_of_forwarders_"
                "spawned={},use_all_forwarders={},gpfs_block_size={},sender_sends_full_images={},"
                "module_sync_queue_size={},number_of_writers={},ram_buffer_gb={},delay_filter_"
-               "timeout={},switch_user_active={}",
+               "timeout={},switch_user_active={},converted_output_type={},photon_energy_kev={},"
+               "gap_pixels={},binning={},module_sync_timeout_ms={}",
                det_config.detector_name, det_config.detector_type, det_config.n_modules,
                det_config.bit_depth, det_config.image_pixel_height, det_config.image_pixel_width,
                det_config.start_udp_port, det_config.log_level,
@@ -73,7 +101,10 @@ struct DetectorConfig
                det_config.gpfs_block_size, det_config.sender_sends_full_images,
                det_config.module_sync_queue_size, det_config.number_of_writers,
                det_config.ram_buffer_gb, det_config.delay_filter_timeout.count(),
-               det_config.switch_user_active);
+               det_config.switch_user_active, static_cast<int>(det_config.converted_output.type),
+               det_config.converted_output.photon_energy_kev,
+               static_cast<int>(det_config.gap_pixels), det_config.binning,
+               det_config.module_sync_timeout.count());
   }
 };
 
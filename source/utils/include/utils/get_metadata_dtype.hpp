@@ -12,9 +12,15 @@ namespace utils {
 
 inline std_daq_protocol::ImageMetadataDtype get_metadata_dtype(const DetectorConfig& config)
 {
-  if (config.detector_type == "jungfrau-converted")
+  if (config.detector_type == "jungfrau-converted") {
+    if (config.converted_output.type == converted_output_config::float16)
+      return std_daq_protocol::ImageMetadataDtype::float16;
+    if (config.converted_output.type == converted_output_config::uint16)
+      return std_daq_protocol::ImageMetadataDtype::uint16;
     return std_daq_protocol::ImageMetadataDtype::float32;
-  if (config.bit_depth == 8) return std_daq_protocol::ImageMetadataDtype::uint8;
+  }
+  if (config.bit_depth == 8 || (config.bit_depth == 4 && config.detector_type == "eiger"))
+    return std_daq_protocol::ImageMetadataDtype::uint8;
   if (config.bit_depth == 16) return std_daq_protocol::ImageMetadataDtype::uint16;
   if (config.bit_depth == 32) return std_daq_protocol::ImageMetadataDtype::uint32;
   throw std::runtime_error("Unsupported bit_depth of the image");
@@ -23,6 +29,7 @@ inline std_daq_protocol::ImageMetadataDtype get_metadata_dtype(const DetectorCon
 inline std::size_t get_bytes_from_metadata_dtype(std_daq_protocol::ImageMetadataDtype type)
 {
   if (type == std_daq_protocol::ImageMetadataDtype::float32) return 4;
+  if (type == std_daq_protocol::ImageMetadataDtype::float16) return 2;
   if (type == std_daq_protocol::ImageMetadataDtype::uint8) return 1;
   if (type == std_daq_protocol::ImageMetadataDtype::uint16) return 2;
   if (type == std_daq_protocol::ImageMetadataDtype::uint32) return 4;
@@ -24,6 +24,35 @@ live_stream_config::Type to_type(std::string_view type_str)
   throw std::invalid_argument("Invalid type string");
 }
 
+converted_output_config::Type to_output_type(std::string_view type_str)
+{
+  if (type_str == "float32") return converted_output_config::float32;
+  if (type_str == "float16") return converted_output_config::float16;
+  if (type_str == "uint16") return converted_output_config::uint16;
+
+  throw std::invalid_argument(fmt::format("Invalid converted output type: {}", type_str));
+}
+
+gap_pixels_mode to_gap_pixels_mode(std::string_view mode_str)
+{
+  if (mode_str == "keep") return gap_pixels_mode::keep;
+  if (mode_str == "zero") return gap_pixels_mode::zero;
+  if (mode_str == "interpolate") return gap_pixels_mode::interpolate;
+
+  throw std::invalid_argument(fmt::format("Invalid gap pixels mode: {}", mode_str));
+}
+
+// only converted energies can be summed - raw values carry gain bits
+int to_binning(int binning, std::string_view detector_type)
+{
+  if (binning != 1 && binning != 2 && binning != 4)
+    throw std::invalid_argument(fmt::format("Invalid binning: {} (supported 1, 2, 4)", binning));
+  if (binning != 1 && detector_type != "jungfrau-converted")
+    throw std::invalid_argument(
+        fmt::format("Binning {} requires jungfrau-converted detector type", binning));
+  return binning;
+}
+
 DetectorConfig read_config(const json doc)
 {
   static const std::string required_parameters[] = {
@@ -56,6 +85,14 @@ DetectorConfig read_config(const json doc)
                                                              value.at("config")[1].get<size_t>())};
     }
 
+  const converted_output_config converted_output{
+      to_output_type(doc.value("converted_output_type", "float32")),
+      doc.value("photon_energy_kev", 0.f)};
+  if (converted_output.type == converted_output_config::uint16 &&
+      converted_output.photon_energy_kev <= 0.f)
+    throw std::runtime_error(
+        "Converted output type uint16 requires positive value of \"photon_energy_kev\"");
+
   return {doc["detector_name"].get<std::string>(),
           doc["detector_type"].get<std::string>(),
           doc["n_modules"].get<int>(),
@@ -75,7 +112,11 @@ DetectorConfig read_config(const json doc)
           std::chrono::seconds(doc.value("delay_filter_timeout", 10)),
           doc.value("switch_user_active", false),
           std::move(ls_configs),
-          std::move(modules)};
+          std::move(modules),
+          converted_output,
+          to_gap_pixels_mode(doc.value("gap_pixels", "keep")),
+          to_binning(doc.value("binning", 1), doc["detector_type"].get<std::string>()),
+          std::chrono::milliseconds(doc.value("module_sync_timeout_ms", 0))};
 }
 } // namespace
 
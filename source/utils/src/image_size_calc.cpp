@@ -6,15 +6,27 @@
 
 namespace utils {
 
+namespace {
+
+std::size_t converted_pixel_n_bytes(const DetectorConfig& config)
+{
+  if (config.converted_output.type == converted_output_config::float32) return sizeof(float);
+  return sizeof(uint16_t);
+}
+
+} // namespace
+
 std::size_t converted_image_n_bytes(const DetectorConfig& config)
 {
   if (config.detector_type == "gigafrost")
     return config.image_pixel_height * config.image_pixel_width * 2;
-  if (config.detector_type == "eiger" || config.detector_type == "pco" ||
-      config.detector_type == "jungfrau-raw")
+  // eiger 4 bit pixels are expanded to a byte each by the converter
+  if (config.detector_type == "eiger")
+    return config.image_pixel_width * config.image_pixel_height * std::max(config.bit_depth, 8) / 8;
+  if (config.detector_type == "pco" || config.detector_type == "jungfrau-raw")
     return config.image_pixel_width * config.image_pixel_height * config.bit_depth / 8;
   if (config.detector_type == "jungfrau-converted")
-    return config.image_pixel_width * config.image_pixel_height * sizeof(float);
+    return config.image_pixel_width * config.image_pixel_height * converted_pixel_n_bytes(config);
   throw std::runtime_error("Unsupported detector_type!\n");
 }
 
@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <fmt/core.h>
+
+namespace utils::stats {
+
+// Per module histogram of arrival offsets relative to the first module of the same image,
+// kept for one stats period. Buckets are powers of two in microseconds - bucket i holds offsets
+// below 2^i us - so p99 is reported as the upper bound of its bucket, max is exact.
+// Arrivals may be added concurrently by many threads; counters are relaxed, so a report taken
+// while arrivals are added may miss the ones being added at that moment.
+class ArrivalSkewHistogram
+{
+  static constexpr std::size_t n_buckets = 32;
+
+  struct module_skew
+  {
+    std::array<std::atomic<uint32_t>, n_buckets> buckets{};
+    std::atomic<uint64_t> n_arrivals{0};
+    std::atomic<uint64_t> n_last{0};
+    std::atomic<int64_t> max_us{0};
+  };
+
+public:
+  explicit ArrivalSkewHistogram(std::size_t n_modules)
+      : n_modules(n_modules)
+      , modules(std::make_unique<module_skew[]>(n_modules))
+  {}
+
+  void add(std::size_t module_id, std::chrono::nanoseconds offset, bool last)
+  {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(offset);
+    auto& m = modules[module_id];
+    m.buckets[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    m.n_arrivals.fetch_add(1, std::memory_order_relaxed);
+    if (last) m.n_last.fetch_add(1, std::memory_order_relaxed);
+    auto max_us = m.max_us.load(std::memory_order_relaxed);
+    while (us.count() > max_us &&
+           !m.max_us.compare_exchange_weak(max_us, us.count(), std::memory_order_relaxed))
+      ;
+  }
+
+  [[nodiscard]] std::chrono::microseconds max(std::size_t module_id) const
+  {
+    return std::chrono::microseconds(modules[module_id].max_us.load(std::memory_order_relaxed));
+  }
+
+  [[nodiscard]] std::chrono::microseconds p99(std::size_t module_id) const
+  {
+    const auto& m = modules[module_id];
+    const auto max_skew = max(module_id);
+    // smallest bucket holding at least 99% of arrivals
+    const auto n_arrivals = m.n_arrivals.load(std::memory_order_relaxed);
+    const auto threshold = n_arrivals - n_arrivals / 100;
+    uint64_t count = 0;
+    for (auto i = 0u; i < n_buckets; i++)
+      if (count += m.buckets[i].load(std::memory_order_relaxed); count > 0 && count >= threshold)
+        return std::min(max_skew, std::chrono::microseconds((int64_t{1} << i) - 1));
+    return max_skew;
+  }
+
+  [[nodiscard]] uint64_t last_arrivals(std::size_t module_id) const
+  {
+    return modules[module_id].n_last.load(std::memory_order_relaxed);
+  }
+
+  // module most often completing images - the first one for ties, -1 without arrivals
+  [[nodiscard]] int latest_module() const
+  {
+    int latest = -1;
+    uint64_t most = 0;
+    for (auto i = 0u; i < n_modules; i++)
+      if (const auto n_last = last_arrivals(i); n_last > most) {
+        most = n_last;
+        latest = static_cast<int>(i);
+      }
+    return latest;
+  }
+
+  // modules without arrivals in the period are left out
+  [[nodiscard]] std::string message() const
+  {
+    auto outcome = fmt::format("latest_module={}", latest_module());
+    for (auto i = 0u; i < n_modules; i++)
+      if (modules[i].n_arrivals.load(std::memory_order_relaxed) > 0)
+        outcome += fmt::format(
+            ",module_{0}_max_skew_us={1},module_{0}_p99_skew_us={2},module_{0}_last={3}", i,
+            max(i).count(), p99(i).count(), last_arrivals(i));
+    return outcome;
+  }
+
+  void reset()
+  {
+    for (auto i = 0u; i < n_modules; i++) {
+      auto& m = modules[i];
+      for (auto& b : m.buckets)
+        b.store(0, std::memory_order_relaxed);
+      m.n_arrivals.store(0, std::memory_order_relaxed);
+      m.n_last.store(0, std::memory_order_relaxed);
+      m.max_us.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static std::size_t bucket(std::chrono::microseconds us)
+  {
+    const auto width = static_cast<std::size_t>(std::bit_width(static_cast<uint64_t>(us.count())));
+    return std::min(width, n_buckets - 1);
+  }
+
+  std::size_t n_modules;
+  std::unique_ptr<module_skew[]> modules;
+};
+
+} // namespace utils::stats
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <string_view>
 
@@ -30,6 +32,12 @@ public:
                                TimedStatsCollector::additional_message(), compressed_images, ratio);
     compressed_images = 0;
     compressed_size = 0;
+    if (timed_images > 0) outcome += "," + timing_message();
+    queue_wait = {};
+    compress_time = {};
+    max_queue_wait = {};
+    max_compress_time = {};
+    timed_images = 0;
     return outcome;
   }
 
@@ -49,10 +57,37 @@ public:
     static_cast<TimedStatsCollector*>(this)->process();
   }
 
+  // time image waited for a free worker and time its compression took - pipeline mode only
+  void process_timing(std::chrono::nanoseconds wait, std::chrono::nanoseconds compress)
+  {
+    queue_wait += wait;
+    compress_time += compress;
+    max_queue_wait = std::max(max_queue_wait, wait);
+    max_compress_time = std::max(max_compress_time, compress);
+    timed_images++;
+  }
+
 private:
+  [[nodiscard]] std::string timing_message() const
+  {
+    using namespace std::chrono;
+    const auto n = static_cast<long>(timed_images);
+    return fmt::format(
+        "queue_wait_avg_us={},queue_wait_max_us={},compress_avg_us={},compress_max_us={}",
+        duration_cast<microseconds>(queue_wait / n).count(),
+        duration_cast<microseconds>(max_queue_wait).count(),
+        duration_cast<microseconds>(compress_time / n).count(),
+        duration_cast<microseconds>(max_compress_time).count());
+  }
+
   std::size_t image_size;
   std::size_t compressed_images = 0;
   std::size_t compressed_size = 0;
+  std::size_t timed_images = 0;
+  std::chrono::nanoseconds queue_wait{0};
+  std::chrono::nanoseconds compress_time{0};
+  std::chrono::nanoseconds max_queue_wait{0};
+  std::chrono::nanoseconds max_compress_time{0};
 };
 
 } // namespace utils::stats
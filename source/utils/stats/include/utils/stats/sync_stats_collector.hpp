@@ -4,11 +4,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <string_view>
 
 #include <fmt/core.h>
 
+#include "arrival_skew_histogram.hpp"
 #include "timed_stats_collector.hpp"
 
 namespace utils::stats {
@@ -16,15 +18,26 @@ namespace utils::stats {
 class SyncStatsCollector : public TimedStatsCollector
 {
 public:
-  explicit SyncStatsCollector(std::string_view detector_name, std::chrono::seconds period)
+  // with n_modules set arrival skew of every module is reported
+  explicit SyncStatsCollector(std::string_view detector_name,
+                              std::chrono::seconds period,
+                              std::size_t n_modules = 0)
       : TimedStatsCollector(detector_name, period)
+      , skew(n_modules)
   {}
 
   [[nodiscard]] std::string additional_message() override
   {
-    auto outcome = fmt::format("{},n_corrupted_images={}",
-                               TimedStatsCollector::additional_message(), n_corrupted_images);
+    auto outcome = fmt::format(
+        "{},n_corrupted_images={},n_partial_images={},n_late_modules={},n_duplicated_modules={}",
+        TimedStatsCollector::additional_message(), n_corrupted_images, n_partial_images,
+        n_late_modules, n_duplicated_modules);
     n_corrupted_images = 0;
+    n_partial_images = 0;
+    n_late_modules = 0;
+    n_duplicated_modules = 0;
+    if (skew_recorded.exchange(false, std::memory_order_relaxed)) outcome += "," + skew.message();
+    skew.reset();
     return outcome;
   }
 
@@ -34,8 +47,36 @@ public:
     static_cast<TimedStatsCollector*>(this)->process();
   }
 
+  // counters accumulated elsewhere since the last call, for callers batching them
+  void process(std::size_t n_processed, std::size_t n_corrupted)
+  {
+    n_corrupted_images += n_corrupted;
+    TimedStatsCollector::process(n_processed);
+  }
+
+  // counters of images released by the sync deadline and modules ignored because of it
+  void process_deadline(std::size_t n_partial, std::size_t n_late, std::size_t n_duplicated)
+  {
+    n_partial_images += n_partial;
+    n_late_modules += n_late;
+    n_duplicated_modules += n_duplicated;
+  }
+
+  // offset of module arrival from the first module of the same image - unlike the other
+  // counters it may be called concurrently from many threads
+  void process_arrival(std::size_t module_id, std::chrono::nanoseconds offset, bool last)
+  {
+    skew.add(module_id, offset, last);
+    skew_recorded.store(true, std::memory_order_relaxed);
+  }
+
 private:
+  ArrivalSkewHistogram skew;
+  std::atomic<bool> skew_recorded{false};
   unsigned long n_corrupted_images = 0;
+  unsigned long n_partial_images = 0;
+  unsigned long n_late_modules = 0;
+  unsigned long n_duplicated_modules = 0;
 };
 
 } // namespace utils::stats
@@ -31,6 +31,7 @@ public:
     return outcome;
   }
   void process() { processed_times++; }
+  void process(std::size_t n_times) { processed_times += n_times; }
 
 private:
   void reset_stats() { processed_times = 0; }
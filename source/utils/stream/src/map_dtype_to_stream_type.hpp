@@ -13,6 +13,7 @@ namespace utils::stream {
 inline std::string map_dtype_to_stream_type(std_daq_protocol::ImageMetadataDtype type)
 {
   if (type == std_daq_protocol::ImageMetadataDtype::float32) return "float32";
+  if (type == std_daq_protocol::ImageMetadataDtype::float16) return "float16";
   if (type == std_daq_protocol::ImageMetadataDtype::uint8) return "uint8";
   if (type == std_daq_protocol::ImageMetadataDtype::uint16) return "uint16";
   if (type == std_daq_protocol::ImageMetadataDtype::uint32) return "uint32";
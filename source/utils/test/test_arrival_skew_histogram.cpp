@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////
+// Copyright (c) 2024 Paul Scherrer Institute. All rights reserved.
+/////////////////////////////////////////////////////////////////////
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utils/stats/arrival_skew_histogram.hpp"
+
+using namespace std::chrono_literals;
+using utils::stats::ArrivalSkewHistogram;
+
+TEST(ArrivalSkewHistogram, ShouldReportMaxAndP99PerModule)
+{
+  ArrivalSkewHistogram histogram(2);
+  for (int i = 0; i < 99; i++)
+    histogram.add(1, 3us, false);
+  histogram.add(1, 900us, true);
+
+  EXPECT_EQ(900us, histogram.max(1));
+  EXPECT_EQ(3us, histogram.p99(1));
+  EXPECT_EQ(0us, histogram.max(0));
+  EXPECT_EQ(0us, histogram.p99(0));
+}
+
+TEST(ArrivalSkewHistogram, ShouldRoundP99UpToBucketBound)
+{
+  ArrivalSkewHistogram histogram(1);
+  for (int i = 0; i < 99; i++)
+    histogram.add(0, 40us, false);
+  histogram.add(0, 50us, false);
+
+  EXPECT_EQ(50us, histogram.max(0));
+  EXPECT_EQ(50us, histogram.p99(0));
+  histogram.add(0, 200us, false);
+  EXPECT_EQ(63us, histogram.p99(0));
+}
+
+TEST(ArrivalSkewHistogram, ShouldFindModuleMostOftenLast)
+{
+  ArrivalSkewHistogram histogram(3);
+  EXPECT_EQ(-1, histogram.latest_module());
+  histogram.add(0, 1us, true);
+  histogram.add(2, 5us, true);
+  histogram.add(2, 7us, true);
+
+  EXPECT_EQ(2, histogram.latest_module());
+  EXPECT_EQ(2u, histogram.last_arrivals(2));
+  EXPECT_EQ("latest_module=2,module_0_max_skew_us=1,module_0_p99_skew_us=1,module_0_last=1,"
+            "module_2_max_skew_us=7,module_2_p99_skew_us=7,module_2_last=2",
+            histogram.message());
+
+  histogram.reset();
+  EXPECT_EQ(-1, histogram.latest_module());
+  EXPECT_EQ("latest_module=-1", histogram.message());
+}
+
+TEST(ArrivalSkewHistogram, ShouldCountArrivalsAddedConcurrently)
+{
+  ArrivalSkewHistogram histogram(2);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back([&histogram, t] {
+      for (int i = 0; i < 1000; i++)
+        histogram.add(t % 2, std::chrono::microseconds(t * 1000 + i), t == 3);
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(3999us, histogram.max(1));
+  EXPECT_EQ(2999us, histogram.max(0));
+  EXPECT_EQ(1000u, histogram.last_arrivals(1));
+  EXPECT_EQ(0u, histogram.last_arrivals(0));
+  EXPECT_EQ(1, histogram.latest_module());
+}
@@ -36,6 +36,124 @@ TEST(DetectorConfig, ShouldReadModuleSettingsCorrectly)
   EXPECT_EQ(10, config.stats_collection_period.count());
   EXPECT_EQ("info", config.log_level);
   EXPECT_EQ(modules_mask{133}, get_modules_mask(config));
+  EXPECT_EQ(converted_output_config::float32, config.converted_output.type);
+  EXPECT_EQ(gap_pixels_mode::keep, config.gap_pixels);
+  EXPECT_EQ(1, config.binning);
+  EXPECT_EQ(0, config.module_sync_timeout.count());
+}
+
+TEST(DetectorConfig, ShouldReadConvertedOutputType)
+{
+  const std::string data = R""""({
+"detector_name": "JF",
+"detector_type": "jungfrau-converted",
+"n_modules": 2,
+"bit_depth": 16,
+"image_pixel_height": 1024,
+"image_pixel_width": 1024,
+"start_udp_port": 50020,
+"converted_output_type": "uint16",
+"photon_energy_kev": 12.4,
+"module_positions": {}
+}
+)"""";
+
+  const auto config = read_config_from_json_string(data);
+
+  EXPECT_EQ(converted_output_config::uint16, config.converted_output.type);
+  EXPECT_FLOAT_EQ(12.4f, config.converted_output.photon_energy_kev);
+}
+
+TEST(DetectorConfig, ShouldThrowForPhotonCountOutputWithoutPhotonEnergy)
+{
+  const std::string data = R""""({
+"detector_name": "JF",
+"detector_type": "jungfrau-converted",
+"n_modules": 2,
+"bit_depth": 16,
+"image_pixel_height": 1024,
+"image_pixel_width": 1024,
+"start_udp_port": 50020,
+"converted_output_type": "uint16",
+"module_positions": {}
+}
+)"""";
+
+  EXPECT_THROW(read_config_from_json_string(data), std::runtime_error);
+}
+
+TEST(DetectorConfig, ShouldReadGapPixelsMode)
+{
+  const std::string data = R""""({
+"detector_name": "EG",
+"detector_type": "eiger",
+"n_modules": 2,
+"bit_depth": 4,
+"image_pixel_height": 512,
+"image_pixel_width": 1028,
+"start_udp_port": 50020,
+"gap_pixels": "interpolate",
+"module_positions": {}
+}
+)"""";
+
+  const auto config = read_config_from_json_string(data);
+
+  EXPECT_EQ(gap_pixels_mode::interpolate, config.gap_pixels);
+}
+
+TEST(DetectorConfig, ShouldReadModuleSyncTimeout)
+{
+  const std::string data = R""""({
+"detector_name": "JF",
+"detector_type": "jungfrau",
+"n_modules": 32,
+"bit_depth": 16,
+"image_pixel_height": 1024,
+"image_pixel_width": 1024,
+"start_udp_port": 50020,
+"module_sync_timeout_ms": 20,
+"module_positions": {}
+}
+)"""";
+
+  EXPECT_EQ(std::chrono::milliseconds(20), read_config_from_json_string(data).module_sync_timeout);
+}
+
+TEST(DetectorConfig, ShouldThrowForUnsupportedBinning)
+{
+  const std::string data = R""""({
+"detector_name": "JF",
+"detector_type": "jungfrau-converted",
+"n_modules": 2,
+"bit_depth": 16,
+"image_pixel_height": 512,
+"image_pixel_width": 512,
+"start_udp_port": 50020,
+"binning": 3,
+"module_positions": {}
+}
+)"""";
+
+  EXPECT_THROW(read_config_from_json_string(data), std::invalid_argument);
+}
+
+TEST(DetectorConfig, ShouldThrowForBinningOfNotConvertedDetector)
+{
+  const std::string data = R""""({
+"detector_name": "JF",
+"detector_type": "jungfrau",
+"n_modules": 2,
+"bit_depth": 16,
+"image_pixel_height": 512,
+"image_pixel_width": 512,
+"start_udp_port": 50020,
+"binning": 2,
+"module_positions": {}
+}
+)"""";
+
+  EXPECT_THROW(read_config_from_json_string(data), std::invalid_argument);
 }
 
 } // namespace utils
@@ -1,6 +1,8 @@
 import asyncio
+import contextlib
 import shlex
 import subprocess
+import time
 from ctypes import Structure, c_uint64, c_uint16
 from pathlib import Path
 
@@ -12,7 +14,8 @@ import zmq.asyncio
 import std_buffer.image_metadata_pb2
 from std_buffer.gigafrost.data import GigafrostConfigConverter, GigafrostConfigUdp
 from testing.fixtures import test_path
-from testing.communication import start_publisher_communication, start_pull_communication
+from testing.communication import start_publisher_communication, start_pull_communication, \
+    start_subscriber_communication
 from testing.execution_helpers import build_command, run_command_in_parallel, send_receive, send_receive_proto, \
     get_array
 
@@ -98,3 +101,38 @@ async def test_send_receive_stream(test_path):
                 start_index = int(GigafrostConfigUdp().image_pixel_height * GigafrostConfigUdp().image_pixel_width / 8)
                 assert data[start_index] == 501
                 assert data[start_index + 1] == 601
+
+
+@pytest.mark.asyncio
+async def test_send_receive_stream_multi(test_path):
+    addresses = [f'tcp://127.0.0.1:{50011 + i}' for i in range(8)]
+    senders = [build_command('std_stream_send', test_path / 'gigafrost_detector.json', address, i)
+               for i, address in enumerate(addresses)]
+    receive = build_command('std_stream_receive_multi', test_path / 'gigafrost_detector_2.json', *addresses)
+
+    slot = 4
+    ctx = zmq.asyncio.Context()
+
+    gf_config = GigafrostConfigConverter()
+    gf_config.socket_name = 'GF2-image'
+    gf_config.name = 'GF2-image'
+
+    with start_publisher_communication(ctx, gf_config) as (input_buffer, pub_socket):
+        with contextlib.ExitStack() as stack:
+            for command in senders + [receive]:
+                stack.enter_context(run_command_in_parallel(command, sleep=0.2))
+            time.sleep(1)
+
+            gf_config.name = 'GF22-image'
+            with start_subscriber_communication(ctx, gf_config) as (output_buffer, sub_socket):
+                sent_data = get_array(input_buffer, slot, 'u2', GigafrostConfigConverter())
+                for i in range(8):
+                    index_start = int(i * len(sent_data) / 8)
+                    sent_data[index_start] = 700 + i
+
+                msg = await send_receive_proto(pub_socket=pub_socket, sub_socket=sub_socket, slot=slot)
+                assert msg.image_id == slot
+
+                data = get_array(output_buffer, slot, 'u2', GigafrostConfigConverter())
+                for i in range(8):
+                    assert data[int(i * len(data) / 8)] == 700 + i